@@ -1,4 +1,13 @@
 import { Position, Pathfinding } from "./pathfinding";
+import {
+  createPathfinding,
+  nativePathfindingModule,
+  NativePathfinding,
+} from "./nativePathfinding";
+import {
+  createConnectorRenderer,
+  ConnectorRenderer,
+} from "./connectorRenderer";
 import { seedEntities, seedConnectors } from "./helpers/seed";
 import * as m3 from "./helpers/matrix";
 import { Entity, Anchor, Group } from "./entities";
@@ -38,6 +47,8 @@ export class Engine {
   ctx: Context;
   ui: UI;
   pathfinding: Pathfinding;
+  // Draws the connectors on the GPU once the native pathfinding module has loaded
+  connectorRenderer?: ConnectorRenderer;
   root: Group;
   entities: ById<Entity>;
   connectors: Connectors[];
@@ -63,7 +74,23 @@ export class Engine {
       throw new Error();
     }
 
-    this.pathfinding = new Pathfinding(this.ctx);
+    this.pathfinding = createPathfinding(this.ctx);
+    this.connectorRenderer = createConnectorRenderer(nativePathfindingModule());
+    // The WASM pathfinding module loads asynchronously unless it was already
+    // there, e.g. on a remount. Switch over once it is.
+    if (!nativePathfindingModule()) {
+      window.addEventListener(
+        "wasmLoaded",
+        () => {
+          this.pathfinding = createPathfinding(this.ctx);
+          this.connectorRenderer = createConnectorRenderer(
+            nativePathfindingModule()
+          );
+          this.drawScene(0, true);
+        },
+        { once: true }
+      );
+    }
     this.root = new Group({
       id: "root",
       localMatrix: m3.translation(0, 0),
@@ -166,23 +193,27 @@ export class Engine {
     this.clear();
     this.root.draw(this.ctx, this.pathfinding, this.ui.selectedId);
 
-    this.connectors.forEach((connector) => {
-      const { source, target } = connector;
-      this.pathfinding.updateEntityCollisionRect(source, 0);
-      this.pathfinding.updateEntityCollisionRect(target, 0);
+    const pathfinding = this.pathfinding;
+    if (this.connectorRenderer && pathfinding instanceof NativePathfinding) {
+      pathfinding.routeConnectorsInPlace(this.connectors);
+      this.drawConnectors(pathfinding, this.connectorRenderer);
+    } else {
+      pathfinding
+        .routeConnectors(this.connectors)
+        .forEach((path) => this.drawPath(path));
+    }
 
-      const path = this.pathfinding.getPath(
-        this.pathfinding.toWorldPosition(source.getCenter()),
-        this.pathfinding.toWorldPosition(target.getCenter())
-      );
-      this.drawPath(path);
+    // requestAnimationFrame((time) => this.drawScene(time));
+  }
 
-      this.pathfinding.updateConnectorCollisionPath(path, 2);
-      this.pathfinding.updateEntityCollisionRect(source, 5);
-      this.pathfinding.updateEntityCollisionRect(target, 5);
-    });
+  // Every connector in one WebGL draw, composited under the scene like drawPath's strokes
+  drawConnectors(pathfinding: NativePathfinding, renderer: ConnectorRenderer) {
+    renderer.resize(this.ctx.width, this.ctx.height);
+    renderer.draw(pathfinding, this.ctx.width, this.ctx.height);
 
-    // requestAnimationFrame((time) => this.drawScene(time));
+    this.ctx.drawing.globalCompositeOperation = "destination-over";
+    this.ctx.drawing.resetTransform();
+    this.ctx.drawing.drawImage(renderer.canvas, 0, 0);
   }
 
   drawPath(path: Position[]) {
@@ -0,0 +1,207 @@
+import { NativePathfinding } from "./nativePathfinding";
+
+// POLYLINE_JOIN_* and POLYLINE_CAP_*, see pathfinding/cpp/Polyline.h
+export const JOIN_MITER = 0;
+export const JOIN_ROUND = 1;
+export const JOIN_BEVEL = 2;
+export const CAP_BUTT = 0;
+export const CAP_ROUND = 1;
+export const CAP_SQUARE = 2;
+
+// Mesh points are in tiles, scale maps them to clip space
+const VERTEX_SHADER = `
+attribute vec2 position;
+uniform vec2 scale;
+
+void main() {
+  gl_Position = vec4(position * scale + vec2(-1.0, 1.0), 0.0, 1.0);
+}
+`;
+
+// Engine.drawPath's strokeStyle
+const FRAGMENT_SHADER = `
+precision mediump float;
+
+void main() {
+  gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
+`;
+
+function compileShader(
+  gl: WebGLRenderingContext,
+  type: number,
+  source: string
+) {
+  const shader = gl.createShader(type);
+  if (!shader) {
+    throw new Error("Could not create shader");
+  }
+  gl.shaderSource(shader, source);
+  gl.compileShader(shader);
+  if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+    throw new Error(
+      gl.getShaderInfoLog(shader) || "Could not compile shader"
+    );
+  }
+  return shader;
+}
+
+// Undefined without the pathfinding module or WebGL, the Engine strokes the
+// paths on the canvas then.
+export function createConnectorRenderer(module: any) {
+  if (!module) {
+    return undefined;
+  }
+  const canvas = document.createElement("canvas");
+  const gl = canvas.getContext("webgl");
+  if (!gl) {
+    return undefined;
+  }
+  return new ConnectorRenderer(module, canvas, gl);
+}
+
+// Draws every connector of a NativePathfinding as triangles with a single drawArrays. The native
+// connector mesh tessellates only the routes that changed since the last draw, and only the vertex
+// ranges it rewrote are uploaded. Draws into its own offscreen canvas, which the Engine composites
+// under the scene.
+export class ConnectorRenderer {
+  module: any;
+  canvas: HTMLCanvasElement;
+  gl: WebGLRenderingContext;
+  program: WebGLProgram;
+  scale: WebGLUniformLocation | null;
+  buffer: WebGLBuffer | null;
+  mesh: number;
+  // Vertices the GL buffer was allocated for, the mesh's capacity at the time
+  bufferCapacity: number;
+  // Stroke width in canvas pixels, the other fields like PolylineStyle in pathfinding/cpp/Polyline.h.
+  // The defaults are Engine.drawPath's.
+  lineWidth: number;
+  join: number;
+  cap: number;
+  miterLimit: number;
+  // In tiles, 0 keeps every turn of the routes
+  tolerance: number;
+  // Connectors tessellated by the last draw()
+  tessellated: number;
+
+  constructor(
+    module: any,
+    canvas: HTMLCanvasElement,
+    gl: WebGLRenderingContext
+  ) {
+    this.module = module;
+    this.canvas = canvas;
+    this.gl = gl;
+    this.lineWidth = 2;
+    this.join = JOIN_MITER;
+    this.cap = CAP_BUTT;
+    this.miterLimit = 10;
+    this.tolerance = 0;
+    this.tessellated = 0;
+
+    const program = gl.createProgram();
+    if (!program) {
+      throw new Error("Could not create program");
+    }
+    gl.attachShader(
+      program,
+      compileShader(gl, gl.VERTEX_SHADER, VERTEX_SHADER)
+    );
+    gl.attachShader(
+      program,
+      compileShader(gl, gl.FRAGMENT_SHADER, FRAGMENT_SHADER)
+    );
+    gl.bindAttribLocation(program, 0, "position");
+    gl.linkProgram(program);
+    if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+      throw new Error(
+        gl.getProgramInfoLog(program) || "Could not link program"
+      );
+    }
+    this.program = program;
+    this.scale = gl.getUniformLocation(program, "scale");
+    this.buffer = gl.createBuffer();
+    this.bufferCapacity = 0;
+    this.mesh = module._createConnectorMesh();
+  }
+
+  destroy() {
+    this.module._destroyConnectorMesh(this.mesh);
+    this.gl.deleteBuffer(this.buffer);
+    this.gl.deleteProgram(this.program);
+    this.mesh = 0;
+  }
+
+  resize(width: number, height: number) {
+    if (this.canvas.width !== width || this.canvas.height !== height) {
+      this.canvas.width = width;
+      this.canvas.height = height;
+    }
+  }
+
+  // Tessellates the routes of the last routeConnectors() or routeConnectorsInPlace() and draws
+  // them, scaled so a width x height scene fills the canvas
+  draw(pathfinding: NativePathfinding, width: number, height: number) {
+    const { gl, module } = this;
+    this.tessellated = module._updateConnectorMesh(
+      this.mesh,
+      pathfinding.router,
+      this.lineWidth / pathfinding.tileSize,
+      this.join,
+      this.cap,
+      this.miterLimit,
+      this.tolerance
+    );
+
+    gl.bindBuffer(gl.ARRAY_BUFFER, this.buffer);
+    this.upload();
+
+    gl.viewport(0, 0, this.canvas.width, this.canvas.height);
+    gl.clearColor(0, 0, 0, 0);
+    gl.clear(gl.COLOR_BUFFER_BIT);
+    const count = module._connectorMeshVertexCount(this.mesh);
+    if (count === 0) {
+      return;
+    }
+    gl.useProgram(this.program);
+    gl.uniform2f(
+      this.scale,
+      (2 * pathfinding.tileSize) / width,
+      (-2 * pathfinding.tileSize) / height
+    );
+    gl.enableVertexAttribArray(0);
+    gl.vertexAttribPointer(0, 2, gl.FLOAT, false, 0, 0);
+    gl.drawArrays(gl.TRIANGLES, 0, count);
+  }
+
+  // Copies the vertex ranges the mesh rewrote, everything when it grew
+  upload() {
+    const { gl, module } = this;
+    const vertices = module._connectorMeshVertices(this.mesh) >> 2;
+    const capacity = module._connectorMeshCapacity(this.mesh);
+    const heap: Float32Array = module.HEAPF32;
+    if (capacity !== this.bufferCapacity) {
+      gl.bufferData(
+        gl.ARRAY_BUFFER,
+        heap.subarray(vertices, vertices + capacity * 2),
+        gl.DYNAMIC_DRAW
+      );
+      this.bufferCapacity = capacity;
+      return;
+    }
+
+    const ranges = module._connectorMeshDirtyRanges(this.mesh) >> 2;
+    const rangeCount = module._connectorMeshDirtyRangeCount(this.mesh);
+    const heap32: Int32Array = module.HEAP32;
+    for (let i = 0; i < rangeCount; i++) {
+      const first = heap32[ranges + i * 2];
+      const count = heap32[ranges + i * 2 + 1];
+      gl.bufferSubData(
+        gl.ARRAY_BUFFER,
+        first * 8,
+        heap.subarray(vertices + first * 2, vertices + (first + count) * 2)
+      );
+    }
+  }
+}
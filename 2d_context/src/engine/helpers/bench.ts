@@ -0,0 +1,470 @@
+import { Entity, Anchor } from "../entities";
+import { Context, Connectors } from "../Engine";
+import { Pathfinding, Position } from "../pathfinding";
+import {
+  NativePathfinding,
+  nativePathfindingModule,
+} from "../nativePathfinding";
+import { createConnectorRenderer } from "../connectorRenderer";
+
+// Deterministic so every engine sees the same world and routes
+function createRandom(seed: number) {
+  let state = seed;
+  return () => {
+    state = (state * 1664525 + 1013904223) % 4294967296;
+    return state / 4294967296;
+  };
+}
+
+function rectEntity(x: number, y: number, w: number, h: number) {
+  return { getCollisionRect: () => ({ x, y, w, h }) } as Entity;
+}
+
+function timeRoutes(
+  pathfinding: Pathfinding,
+  routes: { start: Position; end: Position }[]
+) {
+  const start = performance.now();
+  const paths = routes.map((route) =>
+    pathfinding.getPath(route.start, route.end)
+  );
+  return { time: performance.now() - start, paths };
+}
+
+// Routes the same connectors through the TypeScript and the WASM engines.
+// Call from the console: benchPathfinding()
+export function benchPathfinding(
+  width = 1920,
+  height = 1080,
+  obstacles = 300,
+  routeCount = 200
+) {
+  const module = nativePathfindingModule();
+  if (!module) {
+    console.log("[BENCH] pathfinding module is not loaded");
+    return;
+  }
+
+  const ctx = { width, height } as Context;
+  const engines = {
+    typescript: new Pathfinding(ctx),
+    native: new NativePathfinding(ctx, module),
+    jumpPoints: new NativePathfinding(ctx, module, true),
+  };
+
+  const random = createRandom(1);
+  for (let i = 0; i < obstacles; i++) {
+    const entity = rectEntity(
+      random() * width,
+      random() * height,
+      20 + random() * 150,
+      20 + random() * 100
+    );
+    const weight = random() < 0.2 ? 2 : 5;
+    Object.values(engines).forEach((engine) =>
+      engine.updateEntityCollisionRect(entity, weight)
+    );
+  }
+
+  const routes = [];
+  for (let i = 0; i < routeCount; i++) {
+    const pathfinding = engines.typescript;
+    routes.push({
+      start: pathfinding.toWorldPosition({
+        x: random() * width,
+        y: random() * height,
+      }),
+      end: pathfinding.toWorldPosition({
+        x: random() * width,
+        y: random() * height,
+      }),
+    });
+  }
+
+  const typescript = timeRoutes(engines.typescript, routes);
+  const native = timeRoutes(engines.native, routes);
+  const jumpPoints = timeRoutes(engines.jumpPoints, routes);
+
+  const mismatches = typescript.paths.filter(
+    (path, i) => JSON.stringify(path) !== JSON.stringify(native.paths[i])
+  ).length;
+
+  engines.native.destroy();
+  engines.jumpPoints.destroy();
+
+  const result = {
+    routes: routeCount,
+    typescriptMs: typescript.time,
+    nativeMs: native.time,
+    jumpPointsMs: jumpPoints.time,
+    mismatches,
+  };
+  console.log("[BENCH] pathfinding", result);
+  return result;
+}
+
+function pathLength(paths: Position[][]) {
+  return paths.reduce((total, path) => total + path.length, 0);
+}
+
+// Long routes across a very large canvas, plain A* against the hierarchical mode.
+// Also times rebuilding the clusters after moving a few entities.
+// Call from the console: benchHierarchicalPathfinding()
+export function benchHierarchicalPathfinding(
+  width = 20000,
+  height = 20000,
+  obstacles = 6000,
+  routeCount = 50
+) {
+  const module = nativePathfindingModule();
+  if (!module) {
+    console.log("[BENCH] pathfinding module is not loaded");
+    return;
+  }
+
+  const ctx = { width, height } as Context;
+  const astar = new NativePathfinding(ctx, module);
+  const hierarchical = new NativePathfinding(ctx, module);
+  hierarchical.hierarchical = true;
+  const engines = [astar, hierarchical];
+
+  const random = createRandom(3);
+  const placed: { entity: Entity; weight: number }[] = [];
+  const addObstacles = (count: number) => {
+    for (let i = 0; i < count; i++) {
+      const entity = rectEntity(
+        random() * width,
+        random() * height,
+        20 + random() * 150,
+        20 + random() * 90
+      );
+      const weight = random() < 0.2 ? 2 : 5;
+      placed.push({ entity, weight });
+      engines.forEach((engine) =>
+        engine.updateEntityCollisionRect(entity, weight)
+      );
+    }
+  };
+  addObstacles(obstacles);
+
+  let start = performance.now();
+  hierarchical.updateHierarchy();
+  const buildMs = performance.now() - start;
+
+  // Endpoints in opposite halves so every route is long
+  const routes = [];
+  for (let i = 0; i < routeCount; i++) {
+    routes.push({
+      start: astar.toWorldPosition({
+        x: random() * width * 0.5,
+        y: random() * height,
+      }),
+      end: astar.toWorldPosition({
+        x: (0.5 + random() * 0.5) * width,
+        y: random() * height,
+      }),
+    });
+  }
+
+  const plain = timeRoutes(astar, routes);
+  const planned = timeRoutes(hierarchical, routes);
+
+  addObstacles(20);
+  start = performance.now();
+  const rebuilt = hierarchical.updateHierarchy();
+  const updateMs = performance.now() - start;
+
+  // The updated clusters have to route exactly like ones built from scratch
+  const fresh = new NativePathfinding(ctx, module);
+  fresh.hierarchical = true;
+  engines.push(fresh);
+  placed.forEach(({ entity, weight }) =>
+    fresh.updateEntityCollisionRect(entity, weight)
+  );
+  const updated = timeRoutes(hierarchical, routes).paths;
+  const rebuiltPaths = timeRoutes(fresh, routes).paths;
+  const updateMismatches = updated.filter(
+    (path, i) => JSON.stringify(path) !== JSON.stringify(rebuiltPaths[i])
+  ).length;
+
+  const result = {
+    routes: routeCount,
+    astarMs: plain.time,
+    hierarchicalMs: planned.time,
+    lengthRatio: pathLength(planned.paths) / pathLength(plain.paths),
+    buildMs,
+    updateMs,
+    clustersRebuilt: rebuilt,
+    updateMismatches,
+    memoryBytes: module._hierarchyMemory(hierarchical.hierarchy),
+  };
+  engines.forEach((engine) => engine.destroy());
+  console.log("[BENCH] hierarchical pathfinding", result);
+  return result;
+}
+
+// Anchors follow their node, so dragging a node drags its connectors
+function anchorEntity(node: Position, dx: number, dy: number) {
+  return {
+    getCenter: () => ({ x: node.x + dx + 10, y: node.y + dy + 5 }),
+    getCollisionRect: () => ({
+      x: node.x + dx,
+      y: node.y + dy - 15,
+      w: 20,
+      h: 35,
+    }),
+  } as Anchor;
+}
+
+// Lays the nodes out on a jittered grid and connects each one to the next,
+// so connectors stay local like in a real diagram
+function createDiagram(connectorCount: number, width: number, height: number) {
+  const random = createRandom(2);
+  const columns = Math.ceil(Math.sqrt((connectorCount * width) / height));
+  const rows = Math.ceil(connectorCount / columns);
+  const nodes: Position[] = [];
+  for (let i = 0; i < connectorCount; i++) {
+    nodes.push({
+      x: ((i % columns) + 0.2 + random() * 0.3) * (width / columns),
+      y: (Math.floor(i / columns) + 0.2 + random() * 0.3) * (height / rows),
+    });
+  }
+  const connectors: Connectors[] = nodes.map((node, i) => ({
+    source: anchorEntity(node, 15, 65),
+    target: anchorEntity(nodes[(i + 1) % connectorCount], 15, 0),
+  }));
+  return { nodes, connectors };
+}
+
+// Same world setup as Engine.drawScene, then routes every connector
+function routeDiagram(
+  pathfinding: NativePathfinding,
+  nodes: Position[],
+  connectors: Connectors[]
+) {
+  pathfinding.initWorld();
+  nodes.forEach(({ x, y }) =>
+    pathfinding.updateEntityCollisionRect(rectEntity(x, y, 50, 85), 5)
+  );
+  connectors.forEach(({ source, target }) => {
+    pathfinding.updateEntityCollisionRect(source, 5);
+    pathfinding.updateEntityCollisionRect(target, 5);
+  });
+  return pathfinding.routeConnectors(connectors);
+}
+
+// Drags one node across a diagram of connectorCount connectors, once repairing the
+// cached routes and once routing everything from scratch every frame. Both have to
+// match a new router's routes on every frame.
+// Call from the console: benchIncrementalRouting(1000)
+export function benchIncrementalRouting(
+  connectorCount = 1000,
+  frames = 30,
+  width = 8000,
+  height = 6000,
+  hierarchical = false
+) {
+  const module = nativePathfindingModule();
+  if (!module) {
+    console.log("[BENCH] pathfinding module is not loaded");
+    return;
+  }
+
+  const { nodes, connectors } = createDiagram(connectorCount, width, height);
+  const ctx = { width, height } as Context;
+  const dragTo = (frame: number) => {
+    nodes[0].x = 100 + frame * 10;
+    nodes[0].y = 100 + frame * 5;
+  };
+  const fresh: string[] = [];
+  for (let frame = 0; frame < frames; frame++) {
+    dragTo(frame);
+    const pathfinding = new NativePathfinding(ctx, module);
+    pathfinding.hierarchical = hierarchical;
+    fresh.push(JSON.stringify(routeDiagram(pathfinding, nodes, connectors)));
+    pathfinding.destroy();
+  }
+
+  const run = (fullReroute: boolean) => {
+    const pathfinding = new NativePathfinding(ctx, module);
+    pathfinding.hierarchical = hierarchical;
+    pathfinding.fullReroute = fullReroute;
+    let searched = 0;
+    let time = 0;
+    let mismatchedFrames = 0;
+    for (let frame = 0; frame < frames; frame++) {
+      // The dragged node
+      dragTo(frame);
+      const start = performance.now();
+      const paths = routeDiagram(pathfinding, nodes, connectors);
+      time += performance.now() - start;
+      searched += pathfinding.searched;
+      if (JSON.stringify(paths) !== fresh[frame]) {
+        mismatchedFrames++;
+      }
+    }
+    pathfinding.destroy();
+    return {
+      msPerFrame: time / frames,
+      searchedPerFrame: searched / frames,
+      mismatchedFrames,
+    };
+  };
+
+  const result = {
+    connectors: connectorCount,
+    hierarchical,
+    incremental: run(false),
+    full: run(true),
+  };
+  console.log("[BENCH] incremental routing", result);
+  return result;
+}
+
+// Routes a whole diagram from scratch with each thread count and checks the routes
+// match the single threaded ones. Needs the -s USE_PTHREADS=1 pathfinding build to scale.
+// Call from the console: benchParallelRouting(5000)
+export function benchParallelRouting(
+  connectorCount = 5000,
+  frames = 5,
+  width = 16000,
+  height = 12000,
+  threadCounts = [1, 2, 4, navigator.hardwareConcurrency || 4]
+) {
+  const module = nativePathfindingModule();
+  if (!module) {
+    console.log("[BENCH] pathfinding module is not loaded");
+    return;
+  }
+
+  const { nodes, connectors } = createDiagram(connectorCount, width, height);
+  const ctx = { width, height } as Context;
+  let reference = "";
+  const runs = threadCounts.map((threads) => {
+    const pathfinding = new NativePathfinding(ctx, module);
+    pathfinding.fullReroute = true;
+    pathfinding.setThreads(threads);
+    let time = 0;
+    let paths: Position[][] = [];
+    for (let frame = 0; frame < frames; frame++) {
+      const start = performance.now();
+      paths = routeDiagram(pathfinding, nodes, connectors);
+      time += performance.now() - start;
+    }
+    const conflicts = pathfinding.conflicts;
+    pathfinding.destroy();
+
+    const routes = JSON.stringify(paths);
+    if (!reference) {
+      reference = routes;
+    }
+    return {
+      threads,
+      msPerFrame: time / frames,
+      conflicts,
+      identical: routes === reference,
+    };
+  });
+
+  const result = { connectors: connectorCount, runs };
+  console.log("[BENCH] parallel routing", result);
+  return result;
+}
+
+// Engine.drawPath for every path, scaled by scale
+function strokePaths(
+  drawing: CanvasRenderingContext2D,
+  pathfinding: Pathfinding,
+  paths: Position[][],
+  scale: number
+) {
+  const half = pathfinding.tileSize / 2;
+  drawing.setTransform(scale, 0, 0, scale, 0, 0);
+  drawing.lineWidth = 2;
+  drawing.strokeStyle = "black";
+  paths.forEach((path) => {
+    if (path.length === 0) {
+      return;
+    }
+    drawing.beginPath();
+    const source = pathfinding.toCanvasPosition(path[0]);
+    drawing.moveTo(source.x + half, source.y + half);
+    for (let i = 1; i < path.length; i++) {
+      const next = pathfinding.toCanvasPosition(path[i]);
+      drawing.lineTo(next.x + half, next.y + half);
+    }
+    drawing.stroke();
+  });
+}
+
+// Drags one node across a diagram and draws all its connectors every frame, once through the
+// ConnectorRenderer and once as Canvas2D strokes like Engine.drawPath. Both scale the whole
+// diagram into a canvasWidth x canvasHeight canvas and wait for the pixels.
+// Call from the console: benchConnectorMesh(10000)
+export function benchConnectorMesh(
+  connectorCount = 10000,
+  frames = 10,
+  width = 16000,
+  height = 12000,
+  canvasWidth = 1600,
+  canvasHeight = 1200
+) {
+  const module = nativePathfindingModule();
+  const renderer = createConnectorRenderer(module);
+  const drawing = document.createElement("canvas").getContext("2d");
+  if (!renderer || !drawing) {
+    console.log("[BENCH] pathfinding module or WebGL is not available");
+    return;
+  }
+  renderer.resize(canvasWidth, canvasHeight);
+  drawing.canvas.width = canvasWidth;
+  drawing.canvas.height = canvasHeight;
+
+  const { gl } = renderer;
+  const pixel = new Uint8Array(4);
+  const { nodes, connectors } = createDiagram(connectorCount, width, height);
+  const ctx = { width, height } as Context;
+  const pathfinding = new NativePathfinding(ctx, module);
+
+  let paths = routeDiagram(pathfinding, nodes, connectors);
+  let start = performance.now();
+  renderer.draw(pathfinding, width, height);
+  gl.readPixels(0, 0, 1, 1, gl.RGBA, gl.UNSIGNED_BYTE, pixel);
+  const firstDrawMs = performance.now() - start;
+
+  let meshTime = 0;
+  let strokeTime = 0;
+  let tessellated = 0;
+  for (let frame = 0; frame < frames; frame++) {
+    // The dragged node
+    nodes[0].x = 100 + frame * 10;
+    nodes[0].y = 100 + frame * 5;
+    paths = routeDiagram(pathfinding, nodes, connectors);
+
+    start = performance.now();
+    renderer.draw(pathfinding, width, height);
+    gl.readPixels(0, 0, 1, 1, gl.RGBA, gl.UNSIGNED_BYTE, pixel);
+    meshTime += performance.now() - start;
+    tessellated += renderer.tessellated;
+
+    start = performance.now();
+    drawing.resetTransform();
+    drawing.clearRect(0, 0, canvasWidth, canvasHeight);
+    strokePaths(drawing, pathfinding, paths, canvasWidth / width);
+    drawing.getImageData(0, 0, 1, 1);
+    strokeTime += performance.now() - start;
+  }
+
+  const result = {
+    connectors: connectorCount,
+    vertices: module._connectorMeshVertexCount(renderer.mesh),
+    firstDrawMs,
+    meshMsPerFrame: meshTime / frames,
+    tessellatedPerFrame: tessellated / frames,
+    strokeMsPerFrame: strokeTime / frames,
+  };
+  renderer.destroy();
+  pathfinding.destroy();
+  console.log("[BENCH] connector mesh", result);
+  return result;
+}
@@ -0,0 +1,271 @@
+import { Entity } from "./entities";
+import { Context, Connectors } from "./Engine";
+import { Pathfinding, Position } from "./pathfinding";
+
+// Int32 fields per connector descriptor, see pathfinding/cpp/Router.h
+const CONNECTOR_FIELDS = 12;
+
+// PATHFINDING_* search modes, see pathfinding/cpp/Pathfinding.h
+const ASTAR = 0;
+const JUMP_POINTS = 1;
+const HIERARCHICAL = 2;
+
+declare global {
+  interface Window {
+    Module: any;
+  }
+}
+
+export function nativePathfindingModule() {
+  const module = typeof window !== "undefined" ? window.Module : undefined;
+  if (module && module.calledRun && module._findPath) {
+    return module;
+  }
+  return undefined;
+}
+
+// MEMORY_PATHFINDING, see common/cpp/memory_accounting.h
+const MEMORY_PATHFINDING = 4;
+
+// Heap bytes of the pathfinding module, which are all charged to the pathfinding subsystem. See
+// memoryStats in common/cpp/memory_accounting.h for the layout.
+export function nativeMemoryStatistics() {
+  const module = nativePathfindingModule();
+  if (!module) {
+    return undefined;
+  }
+  const size = module._memoryStatisticsSize();
+  const out = module._malloc(size);
+  module._memoryStatistics(out);
+  const values: Float64Array = module.HEAPF64.slice(out >> 3, (out + size) >> 3);
+  module._free(out);
+
+  const offset = 2 + MEMORY_PATHFINDING * 12;
+  return {
+    heapSize: values[0],
+    heapInUse: values[1],
+    current: values[offset],
+    peak: values[offset + 1],
+    allocations: values[offset + 2],
+    frees: values[offset + 3],
+    churn: values[offset + 4],
+    budget: values[offset + 10],
+    evictions: values[offset + 11],
+  };
+}
+
+// Soft heap budget in bytes, 0 for none. Over it the routers free their search scratch after
+// routing, the cached routes stay.
+export function setNativeMemoryBudget(bytes: number) {
+  const module = nativePathfindingModule();
+  if (module) {
+    module._setMemoryBudget(MEMORY_PATHFINDING, bytes);
+  }
+}
+
+// Uses the WASM module from pathfinding/cpp when it has loaded, the TypeScript engine otherwise.
+export function createPathfinding(ctx: Context, jumpPoints = false): Pathfinding {
+  const module = nativePathfindingModule();
+  if (module) {
+    return new NativePathfinding(ctx, module, jumpPoints);
+  }
+  return new Pathfinding(ctx);
+}
+
+// Same interface as Pathfinding, the grid lives in the WASM heap and is written
+// through a typed-array view so only getPath and routeConnectors cross into WASM.
+export class NativePathfinding extends Pathfinding {
+  module: any;
+  handle: number;
+  router: number;
+  stride: number;
+  jumpPoints: boolean;
+  // Plan over clusters of the grid first, for very large canvases
+  hierarchical: boolean;
+  hierarchy: number;
+  cells: Uint8Array;
+  // Search every connector again instead of repairing the cached routes
+  fullReroute: boolean;
+  // Connectors searched by the last routeConnectors()
+  searched: number;
+  // Speculative searches thrown away because an earlier connector changed what
+  // they read, each cost a second search
+  conflicts: number;
+
+  constructor(ctx: Context, module: any, jumpPoints = false) {
+    super(ctx);
+    this.module = module;
+    this.jumpPoints = jumpPoints;
+    this.hierarchical = false;
+    this.hierarchy = 0;
+    this.fullReroute = false;
+    this.searched = 0;
+    this.conflicts = 0;
+    this.handle = module._createPathfinding(this.worldWidth, this.worldHeight);
+    this.router = module._createRouter(this.handle);
+    this.stride = module._pathfindingStride(this.handle);
+    this.cells = new Uint8Array(0);
+    // The number[][] world of the base class is not used
+    this.world = [];
+    this.initWorld();
+  }
+
+  destroy() {
+    if (this.hierarchy) {
+      this.module._destroyHierarchy(this.hierarchy);
+      this.hierarchy = 0;
+    }
+    this.module._destroyRouter(this.router);
+    this.module._destroyPathfinding(this.handle);
+    this.router = 0;
+    this.handle = 0;
+  }
+
+  // Spreads routeConnectors() over threads workers. Needs a pathfinding module built
+  // with -s USE_PTHREADS=1, routes stay the same for any thread count.
+  setThreads(threads: number) {
+    this.module._setRouterThreads(this.router, threads);
+  }
+
+  mode() {
+    if (this.hierarchical) {
+      return HIERARCHICAL;
+    }
+    return this.jumpPoints ? JUMP_POINTS : ASTAR;
+  }
+
+  bindViews() {
+    // Growing the WASM memory detaches the previous ArrayBuffer
+    if (this.cells.buffer !== this.module.HEAPU8.buffer) {
+      this.cells = new Uint8Array(
+        this.module.HEAPU8.buffer,
+        this.module._pathfindingCells(this.handle),
+        this.stride * (this.worldHeight + 2)
+      );
+    }
+  }
+
+  index(x: number, y: number) {
+    return (y + 1) * this.stride + (x + 1);
+  }
+
+  initWorld() {
+    // Called by the base constructor before the module is attached
+    if (!this.module) {
+      return;
+    }
+    this.bindViews();
+    this.cells.fill(0);
+  }
+
+  updateEntityCollisionRect(entity: Entity, weight: number) {
+    const { x1, y1, x2, y2 } = this.toWorldRect(entity);
+    if (x2 <= x1) {
+      return;
+    }
+
+    this.bindViews();
+    for (let j = y1; j < y2; j++) {
+      const row = this.index(x1, j);
+      this.cells.fill(weight, row, row + x2 - x1);
+    }
+  }
+
+  updateConnectorCollisionPath(path: Position[], weight: number) {
+    this.bindViews();
+    path.forEach(({ x, y }) => {
+      this.cells[this.index(x, y)] = weight;
+    });
+  }
+
+  // Routes all connectors in one call. The native router keeps every route and only searches a
+  // connector again when the cells its last search read have changed.
+  routeConnectors(connectors: Connectors[]) {
+    this.routeConnectorsInPlace(connectors);
+
+    const count = connectors.length;
+    const output = this.module._routerOutput(this.router) >> 2;
+    const pairs = output + count * 2;
+    const heap: Int32Array = this.module.HEAP32;
+    const paths: Position[][] = new Array(count);
+    for (let i = 0; i < count; i++) {
+      const offset = pairs + heap[output + i * 2] * 2;
+      const length = heap[output + i * 2 + 1];
+      const path: Position[] = new Array(length);
+      for (let j = 0; j < length; j++) {
+        path[j] = { x: heap[offset + j * 2], y: heap[offset + j * 2 + 1] };
+      }
+      paths[i] = path;
+    }
+    return paths;
+  }
+
+  // Same as routeConnectors but the routes stay in the WASM heap, for the ConnectorRenderer
+  routeConnectorsInPlace(connectors: Connectors[]) {
+    const count = connectors.length;
+    const descriptors =
+      this.module._routerDescriptors(this.router, count) >> 2;
+    const heap: Int32Array = this.module.HEAP32;
+    connectors.forEach(({ source, target }, i) => {
+      const start = this.toWorldPosition(source.getCenter());
+      const end = this.toWorldPosition(target.getCenter());
+      const s = this.toWorldRect(source);
+      const t = this.toWorldRect(target);
+      // prettier-ignore
+      heap.set(
+        [
+          start.x, start.y, end.x, end.y,
+          s.x1, s.y1, s.x2, s.y2,
+          t.x1, t.y1, t.x2, t.y2,
+        ],
+        descriptors + i * CONNECTOR_FIELDS
+      );
+    });
+
+    this.searched = this.module._routeConnectors(
+      this.router,
+      count,
+      this.mode(),
+      this.fullReroute ? 1 : 0
+    );
+    this.conflicts = this.module._routerConflicts(this.router);
+  }
+
+  // Brings the clusters up to date with the cells, only the changed ones are rebuilt
+  updateHierarchy() {
+    if (!this.hierarchy) {
+      this.hierarchy = this.module._createHierarchy(this.handle);
+    }
+    return this.module._updateHierarchy(this.hierarchy);
+  }
+
+  getPath(start: Position, end: Position) {
+    let length: number;
+    if (this.hierarchical) {
+      this.updateHierarchy();
+      length = this.module._findHierarchicalPath(
+        this.hierarchy,
+        start.x,
+        start.y,
+        end.x,
+        end.y
+      );
+    } else {
+      length = this.module._findPath(
+        this.handle,
+        start.x,
+        start.y,
+        end.x,
+        end.y,
+        this.jumpPoints ? 1 : 0
+      );
+    }
+    const output = this.module._pathfindingOutput() >> 2;
+    const heap: Int32Array = this.module.HEAP32;
+    const result: Position[] = new Array(length);
+    for (let i = 0; i < length; i++) {
+      result[i] = { x: heap[output + i * 2], y: heap[output + i * 2 + 1] };
+    }
+    return result;
+  }
+}
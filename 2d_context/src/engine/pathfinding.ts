@@ -1,6 +1,6 @@
 import { Entity } from "./entities";
 import { clamp } from "./helpers/math";
-import { Context } from "./Engine";
+import { Context, Connectors } from "./Engine";
 
 export const PATHFINDING_TILE_SIZE = 10;
 
@@ -40,7 +40,7 @@ export class Pathfinding {
     }
   }
 
-  updateEntityCollisionRect(entity: Entity, weight: number) {
+  toWorldRect(entity: Entity) {
     const { x, y, w, h } = entity.getCollisionRect();
 
     const hitbox = [
@@ -55,6 +55,11 @@ export class Pathfinding {
     ];
     const { x: x1, y: y1 } = this.toWorldPosition(hitbox[0]);
     const { x: x2, y: y2 } = this.toWorldPosition(hitbox[1]);
+    return { x1, y1, x2, y2 };
+  }
+
+  updateEntityCollisionRect(entity: Entity, weight: number) {
+    const { x1, y1, x2, y2 } = this.toWorldRect(entity);
 
     for (let i = x1; i < x2; i++) {
       for (let j = y1; j < y2; j++) {
@@ -69,6 +74,24 @@ export class Pathfinding {
     });
   }
 
+  // Routes the connectors in order, each one avoiding the paths of the ones before it
+  routeConnectors(connectors: Connectors[]): Position[][] {
+    return connectors.map(({ source, target }) => {
+      this.updateEntityCollisionRect(source, 0);
+      this.updateEntityCollisionRect(target, 0);
+
+      const path = this.getPath(
+        this.toWorldPosition(source.getCenter()),
+        this.toWorldPosition(target.getCenter())
+      );
+
+      this.updateConnectorCollisionPath(path, 2);
+      this.updateEntityCollisionRect(source, 5);
+      this.updateEntityCollisionRect(target, 5);
+      return path;
+    });
+  }
+
   toWorldPosition(p: Position): Position {
     return {
       x: clamp(Math.floor(p.x / this.tileSize - 1), -1, this.worldWidth),
@@ -3,6 +3,17 @@ import ReactDOM from "react-dom";
 
 import App from "./App";
 import * as serviceWorker from "./serviceWorker";
+import {
+  benchPathfinding,
+  benchIncrementalRouting,
+  benchParallelRouting,
+  benchHierarchicalPathfinding,
+  benchConnectorMesh,
+} from "./engine/helpers/bench";
+import {
+  nativeMemoryStatistics,
+  setNativeMemoryBudget,
+} from "./engine/nativePathfinding";
 
 ReactDOM.render(
   <React.StrictMode>
@@ -15,3 +26,13 @@ ReactDOM.render(
 // unregister() to register() below. Note this comes with some pitfalls.
 // Learn more about service workers: https://bit.ly/CRA-PWA
 serviceWorker.unregister();
+
+if (process.env.NODE_ENV !== "production") {
+  (window as any).benchPathfinding = benchPathfinding;
+  (window as any).benchIncrementalRouting = benchIncrementalRouting;
+  (window as any).benchParallelRouting = benchParallelRouting;
+  (window as any).benchHierarchicalPathfinding = benchHierarchicalPathfinding;
+  (window as any).benchConnectorMesh = benchConnectorMesh;
+  (window as any).memoryStatistics = nativeMemoryStatistics;
+  (window as any).setMemoryBudget = setNativeMemoryBudget;
+}
@@ -0,0 +1,177 @@
+#include <string.h>
+#include <atomic>
+#include <vector>
+#ifdef __EMSCRIPTEN__
+#include <malloc.h>
+#include <emscripten/heap.h>
+#endif
+#include "memory_accounting.h"
+
+struct memoryCounter
+{
+  std::atomic<int64_t> current{0};
+  std::atomic<int64_t> peak{0};
+  std::atomic<int64_t> allocations{0};
+  std::atomic<int64_t> frees{0};
+  std::atomic<int64_t> churn{0};
+};
+
+struct memoryEvictorEntry
+{
+  int subsystem;
+  memoryEvictor evict;
+  void *owner;
+};
+
+static memoryCounter heapCounters[MEMORY_SUBSYSTEMS];
+static memoryCounter gpuCounters[MEMORY_SUBSYSTEMS];
+static int64_t budgets[MEMORY_SUBSYSTEMS];
+static int64_t evictions[MEMORY_SUBSYSTEMS];
+static std::vector<memoryEvictorEntry> evictors;
+
+static std::atomic<int> defaultSubsystem{MEMORY_UNTAGGED};
+// -1 outside any memoryScope
+static thread_local int scopeSubsystem = -1;
+
+static inline int valid_subsystem(int subsystem)
+{
+  return subsystem > 0 && subsystem < MEMORY_SUBSYSTEMS ? subsystem : MEMORY_UNTAGGED;
+}
+
+static inline void counter_allocate(memoryCounter &counter, int64_t bytes)
+{
+  int64_t current = counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  int64_t peak = counter.peak.load(std::memory_order_relaxed);
+  while (current > peak && !counter.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+    ;
+  counter.allocations.fetch_add(1, std::memory_order_relaxed);
+  counter.churn.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+static inline void counter_free(memoryCounter &counter, int64_t bytes)
+{
+  counter.current.fetch_sub(bytes, std::memory_order_relaxed);
+  counter.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void counter_read(const memoryCounter &counter, memoryCounters &out)
+{
+  out.current = counter.current.load(std::memory_order_relaxed);
+  out.peak = counter.peak.load(std::memory_order_relaxed);
+  out.allocations = counter.allocations.load(std::memory_order_relaxed);
+  out.frees = counter.frees.load(std::memory_order_relaxed);
+  out.churn = counter.churn.load(std::memory_order_relaxed);
+}
+
+static int64_t subsystem_bytes(int subsystem)
+{
+  return heapCounters[subsystem].current.load(std::memory_order_relaxed) + gpuCounters[subsystem].current.load(std::memory_order_relaxed);
+}
+
+void memory_set_default_subsystem(int subsystem)
+{
+  defaultSubsystem.store(valid_subsystem(subsystem), std::memory_order_relaxed);
+}
+
+memoryScope::memoryScope(int subsystem)
+{
+  previous = scopeSubsystem;
+  scopeSubsystem = valid_subsystem(subsystem);
+}
+
+memoryScope::~memoryScope(void)
+{
+  scopeSubsystem = previous;
+}
+
+int memory_current_subsystem(void)
+{
+  return scopeSubsystem >= 0 ? scopeSubsystem : defaultSubsystem.load(std::memory_order_relaxed);
+}
+
+void memory_heap_allocate(int subsystem, int64_t bytes)
+{
+  counter_allocate(heapCounters[valid_subsystem(subsystem)], bytes);
+}
+
+void memory_heap_free(int subsystem, int64_t bytes)
+{
+  counter_free(heapCounters[valid_subsystem(subsystem)], bytes);
+}
+
+void memory_gpu_allocate(int subsystem, int64_t bytes)
+{
+  counter_allocate(gpuCounters[valid_subsystem(subsystem)], bytes);
+}
+
+void memory_gpu_free(int subsystem, int64_t bytes)
+{
+  counter_free(gpuCounters[valid_subsystem(subsystem)], bytes);
+}
+
+void memory_gpu_resize(int subsystem, int64_t &tracked, int64_t bytes)
+{
+  if (tracked)
+    memory_gpu_free(subsystem, tracked);
+  if (bytes)
+    memory_gpu_allocate(subsystem, bytes);
+  tracked = bytes;
+}
+
+void memory_set_budget(int subsystem, int64_t bytes)
+{
+  budgets[valid_subsystem(subsystem)] = bytes > 0 ? bytes : 0;
+}
+
+void memory_add_evictor(int subsystem, memoryEvictor evict, void *owner)
+{
+  evictors.push_back({valid_subsystem(subsystem), evict, owner});
+}
+
+void memory_remove_evictor(int subsystem, memoryEvictor evict, void *owner)
+{
+  subsystem = valid_subsystem(subsystem);
+  for (size_t n = 0; n < evictors.size(); n++)
+    if (evictors[n].subsystem == subsystem && evictors[n].evict == evict && evictors[n].owner == owner)
+    {
+      evictors.erase(evictors.begin() + n);
+      return;
+    }
+}
+
+int memory_enforce_budgets(void)
+{
+  int run = 0;
+  for (int subsystem = 0; subsystem < MEMORY_SUBSYSTEMS; subsystem++)
+  {
+    if (!budgets[subsystem])
+      continue;
+    // By index, an evictor may add or remove evictors
+    for (size_t n = 0; n < evictors.size() && subsystem_bytes(subsystem) > budgets[subsystem]; n++)
+    {
+      if (evictors[n].subsystem != subsystem)
+        continue;
+      evictors[n].evict(evictors[n].owner, subsystem_bytes(subsystem) - budgets[subsystem]);
+      evictions[subsystem]++;
+      run++;
+    }
+  }
+  return run;
+}
+
+void memory_stats(memoryStats &out)
+{
+  memset(&out, 0, sizeof(out));
+#ifdef __EMSCRIPTEN__
+  out.heapSize = emscripten_get_heap_size();
+  out.heapInUse = mallinfo().uordblks;
+#endif
+  for (int subsystem = 0; subsystem < MEMORY_SUBSYSTEMS; subsystem++)
+  {
+    memorySubsystemStats &stats = out.subsystems[subsystem];
+    counter_read(heapCounters[subsystem], stats.heap);
+    counter_read(gpuCounters[subsystem], stats.gpu);
+    stats.budget = budgets[subsystem];
+    stats.evictions = evictions[subsystem];
+  }
+}
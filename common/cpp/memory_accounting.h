@@ -0,0 +1,94 @@
+#pragma once
+#include <stdint.h>
+
+// Heap and GPU memory by subsystem, shared by the WASM modules. Each module only sees its own heap,
+// so a module reports the subsystems it runs and zeros for the others.
+//
+// Heap bytes are counted by tracking_allocator.cpp, which a module's main.cpp includes to replace the
+// global operator new. An allocation is charged to the subsystem of the innermost memoryScope on its
+// thread, or to the module's default, and credited back to that same subsystem when it is freed. GPU
+// bytes are recorded by whoever creates the texture or buffer, from the size they asked for.
+enum memorySubsystem
+{
+  MEMORY_UNTAGGED = 0,
+  MEMORY_SCENE = 1,
+  MEMORY_TEXTURES = 2,
+  MEMORY_FILTER = 3,
+  MEMORY_PATHFINDING = 4,
+  MEMORY_SUBSYSTEMS = 5,
+};
+
+// Byte counts of one kind of memory, doubles so JS reads them straight off HEAPF64. churn is every
+// byte ever allocated, churn growing much faster than peak means the same memory is reallocated.
+struct memoryCounters
+{
+  double current;
+  double peak;
+  double allocations;
+  double frees;
+  double churn;
+};
+
+struct memorySubsystemStats
+{
+  memoryCounters heap;
+  memoryCounters gpu;
+  // Soft budget for heap and GPU bytes together, 0 for none, and how often evictors ran for it
+  double budget;
+  double evictions;
+};
+
+// Layout of memoryStats(), 8-byte aligned doubles throughout
+struct memoryStats
+{
+  // Size of the WASM memory and the bytes malloc has handed out of it, tracked or not. Zero natively.
+  double heapSize;
+  double heapInUse;
+  memorySubsystemStats subsystems[MEMORY_SUBSYSTEMS];
+};
+
+// Frees what it can of owner's caches to bring its subsystem back under budget. excess is how many
+// bytes the subsystem is over.
+typedef void (*memoryEvictor)(void *owner, int64_t excess);
+
+// Subsystem for allocations outside any memoryScope, on every thread
+void memory_set_default_subsystem(int subsystem);
+
+// Charges heap allocations on this thread to subsystem while it is alive
+class memoryScope
+{
+public:
+  memoryScope(int subsystem);
+  ~memoryScope(void);
+
+private:
+  int previous;
+};
+
+// Subsystem new allocations on this thread go to
+int memory_current_subsystem(void);
+
+// Recorded by the tracking allocator, safe from any thread
+void memory_heap_allocate(int subsystem, int64_t bytes);
+void memory_heap_free(int subsystem, int64_t bytes);
+
+// Recorded by the code that creates and deletes GPU resources, safe from any thread
+void memory_gpu_allocate(int subsystem, int64_t bytes);
+void memory_gpu_free(int subsystem, int64_t bytes);
+
+// For a resource whose storage is replaced, even by storage of the same size: records freeing tracked
+// bytes and allocating bytes, then remembers bytes in tracked. 0 for a deleted resource.
+void memory_gpu_resize(int subsystem, int64_t &tracked, int64_t bytes);
+
+// Budgets and evictors belong to the main thread. An evictor stays registered until removed, remove
+// it before owner goes away.
+void memory_set_budget(int subsystem, int64_t bytes);
+void memory_add_evictor(int subsystem, memoryEvictor evict, void *owner);
+void memory_remove_evictor(int subsystem, memoryEvictor evict, void *owner);
+
+// Runs the evictors of every subsystem over its budget, in the order they were added, until it is
+// back under. Budgets are soft: nothing is checked on allocation, the modules call this where freeing
+// caches is safe. Returns the number of evictors run.
+int memory_enforce_budgets(void);
+
+void memory_stats(memoryStats &out);
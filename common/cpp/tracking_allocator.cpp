@@ -0,0 +1,56 @@
+// Global operator new and delete that charge every C++ allocation to a memory subsystem, see
+// memory_accounting.h. Include it from a module's main.cpp only, the native checks and the replay
+// driver bring their own.
+#include <stdlib.h>
+#include <new>
+#include "memory_accounting.h"
+
+// Allocations are prefixed with their size and subsystem, padded to keep malloc's alignment
+struct allocationHeader
+{
+  size_t size;
+  int32_t subsystem;
+};
+
+#define ALLOCATION_HEADER 16
+static_assert(sizeof(allocationHeader) <= ALLOCATION_HEADER, "allocation header doesn't fit its padding");
+
+void *operator new(size_t size)
+{
+  allocationHeader *header = (allocationHeader *)malloc(ALLOCATION_HEADER + size);
+  if (!header)
+    throw std::bad_alloc();
+  header->size = size;
+  header->subsystem = memory_current_subsystem();
+  memory_heap_allocate(header->subsystem, size);
+  return (uint8_t *)header + ALLOCATION_HEADER;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+  if (!pointer)
+    return;
+  allocationHeader *header = (allocationHeader *)((uint8_t *)pointer - ALLOCATION_HEADER);
+  memory_heap_free(header->subsystem, header->size);
+  free(header);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+  operator delete(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+  operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+  operator delete(pointer);
+}
@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "ConnectorMesh.h"
+
+int ConnectorMesh::update(const Router &router, const PolylineStyle &newStyle)
+{
+  const std::vector<ConnectorRoute> &routes = router.connectorRoutes();
+  dirty.clear();
+  moved = false;
+  if (newStyle != style)
+  {
+    style = newStyle;
+    entries.clear();
+    used = 0;
+    unused = 0;
+    moved = true;
+  }
+
+  for (size_t i = routes.size(); i < entries.size(); i++)
+    release(entries[i]);
+  entries.resize(routes.size());
+
+  int tessellated = 0;
+  for (size_t i = 0; i < routes.size(); i++)
+  {
+    ConnectorMeshEntry &entry = entries[i];
+    if (entry.revision == routes[i].revision)
+      continue;
+    place(entry, tessellate(router.grid(), routes[i].path));
+    entry.revision = routes[i].revision;
+    tessellated++;
+  }
+
+  if (unused > used / 2)
+    compact();
+
+  if (moved)
+    dirty.assign({0, used});
+  else if ((int)dirty.size() > CONNECTOR_MESH_MAX_DIRTY_RANGES * 2)
+  {
+    int first = used, last = 0;
+    for (size_t i = 0; i < dirty.size(); i += 2)
+    {
+      first = std::min(first, dirty[i]);
+      last = std::max(last, dirty[i] + dirty[i + 1]);
+    }
+    dirty.assign({first, last - first});
+  }
+  return tessellated;
+}
+
+// Tessellates one route into triangles, returns its vertex count
+int ConnectorMesh::tessellate(const Pathfinding &grid, const std::vector<int32_t> &path)
+{
+  // Engine.toCanvasPosition: one tile right and down of the cell, clamped to the canvas
+  points.clear();
+  for (int32_t cell : path)
+  {
+    int x = std::min(std::max(grid.cellX(cell) + 1, 0), grid.worldWidth - 1);
+    int y = std::min(std::max(grid.cellY(cell) + 1, 0), grid.worldHeight - 1);
+    points.push_back(x + 0.5f);
+    points.push_back(y + 0.5f);
+  }
+  simplify_polyline(points, style.tolerance, scratch);
+
+  triangles.clear();
+  return tessellate_polyline(points.data(), points.size() / 2, style, triangles);
+}
+
+// Writes triangles into the entry's range, moving it to the end when they do not fit
+void ConnectorMesh::place(ConnectorMeshEntry &entry, int count)
+{
+  if (count > entry.capacity)
+  {
+    // A route that was tessellated before is being edited, it gets a quarter more room
+    int capacity = entry.revision ? (count + count / 4 + 2) / 3 * 3 : count;
+    release(entry);
+    reserve(used + capacity);
+    entry.first = used;
+    entry.capacity = capacity;
+    entry.count = 0;
+    used += capacity;
+    clearVertices(entry.first, capacity);
+    markDirty(entry.first, capacity);
+  }
+  else
+  {
+    markDirty(entry.first, std::max(count, entry.count));
+    if (count < entry.count)
+      clearVertices(entry.first + count, entry.count - count);
+  }
+  memcpy(buffer.data() + entry.first * 2, triangles.data(), count * 2 * sizeof(float));
+  entry.count = count;
+}
+
+void ConnectorMesh::release(ConnectorMeshEntry &entry)
+{
+  if (entry.first + entry.capacity == used)
+    used = entry.first;
+  else if (entry.capacity > 0)
+  {
+    clearVertices(entry.first, entry.count);
+    markDirty(entry.first, entry.count);
+    unused += entry.capacity;
+  }
+  entry.first = 0;
+  entry.capacity = 0;
+  entry.count = 0;
+}
+
+void ConnectorMesh::reserve(int vertices)
+{
+  if (vertices <= capacity())
+    return;
+  buffer.resize(std::max(std::max(vertices, capacity() * 2), CONNECTOR_MESH_MIN_CAPACITY) * 2);
+  moved = true;
+}
+
+// Packs the ranges in connector order without their spare room
+void ConnectorMesh::compact(void)
+{
+  std::vector<float> packed(buffer.size());
+  int next = 0;
+  for (ConnectorMeshEntry &entry : entries)
+  {
+    memcpy(packed.data() + next * 2, buffer.data() + entry.first * 2, entry.count * 2 * sizeof(float));
+    entry.first = next;
+    entry.capacity = entry.count;
+    next += entry.count;
+  }
+  buffer.swap(packed);
+  used = next;
+  unused = 0;
+  moved = true;
+}
+
+void ConnectorMesh::markDirty(int first, int count)
+{
+  if (count <= 0 || moved)
+    return;
+  // Ranges placed one after another, like the ones moved to the end, merge
+  if (!dirty.empty() && first >= dirty[dirty.size() - 2] && first <= dirty[dirty.size() - 2] + dirty.back())
+  {
+    dirty.back() = std::max(dirty.back(), first + count - dirty[dirty.size() - 2]);
+    return;
+  }
+  dirty.push_back(first);
+  dirty.push_back(count);
+}
+
+// Degenerate triangles, all their vertices at the origin
+void ConnectorMesh::clearVertices(int first, int count)
+{
+  memset(buffer.data() + first * 2, 0, count * 2 * sizeof(float));
+}
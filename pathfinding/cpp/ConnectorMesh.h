@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "Polyline.h"
+#include "Router.h"
+
+// More dirty ranges than this are uploaded as the one range spanning them
+#define CONNECTOR_MESH_MAX_DIRTY_RANGES 64
+
+// Vertices the buffer starts with
+#define CONNECTOR_MESH_MIN_CAPACITY 3072
+
+// Where one connector's triangles are in the mesh, in vertices
+struct ConnectorMeshEntry
+{
+  // Route revision they were tessellated from, 0 for none
+  uint32_t revision = 0;
+  int32_t first = 0;
+  int32_t capacity = 0;
+  int32_t count = 0;
+};
+
+// The strokes of every routed connector as one triangle list of x,y floats, drawn with a single call.
+// Points are in tiles of the canvas, a cell's stroke goes through the tile centre Engine.drawPath
+// strokes it through.
+//
+// Every connector has its own range of the vertices. update() tessellates only the connectors whose
+// route changed and rewrites their range in place, or moves it to the end with some room to grow when
+// it no longer fits. The ranges left behind are filled with degenerate triangles until they add up to
+// half the mesh, which is then compacted.
+class ConnectorMesh
+{
+public:
+  // Tessellates the routes of the router's last route() that changed since the last call, all of them
+  // when the style changed. Returns how many connectors were tessellated.
+  int update(const Router &router, const PolylineStyle &style);
+
+  const float *vertices(void) const { return buffer.data(); }
+
+  // Vertices to draw, the degenerate ones included
+  int vertexCount(void) const { return used; }
+
+  // Vertices vertices() has room for, a GL buffer mirroring it has to be this large
+  int capacity(void) const { return buffer.size() / 2; }
+
+  // Vertex ranges the last update() wrote as first, count pairs. One range of all the vertices when
+  // the mesh was rebuilt, compacted or had to grow.
+  const int32_t *dirtyRanges(void) const { return dirty.data(); }
+  int dirtyRangeCount(void) const { return dirty.size() / 2; }
+
+private:
+  int tessellate(const Pathfinding &grid, const std::vector<int32_t> &path);
+  void place(ConnectorMeshEntry &entry, int count);
+  void release(ConnectorMeshEntry &entry);
+  void reserve(int vertices);
+  void compact(void);
+  void markDirty(int first, int count);
+  void clearVertices(int first, int count);
+
+  PolylineStyle style;
+  std::vector<ConnectorMeshEntry> entries;
+  std::vector<float> buffer;
+  int used = 0;
+  // Vertices in ranges no connector owns any more
+  int unused = 0;
+  // Everything has to be uploaded again
+  bool moved = false;
+  std::vector<int32_t> dirty;
+
+  std::vector<float> points;
+  std::vector<float> triangles;
+  PolylineScratch scratch;
+};
@@ -0,0 +1,516 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "Hierarchy.h"
+
+#define HIERARCHY_CLUSTER_SIZE (1 << HIERARCHY_CLUSTER_SHIFT)
+
+static const int clusterDirections[4][2] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+
+Hierarchy::Hierarchy(const Pathfinding *p)
+{
+  pathfinding = p;
+  columns = (p->worldWidth + HIERARCHY_CLUSTER_SIZE - 1) >> HIERARCHY_CLUSTER_SHIFT;
+  rows = (p->worldHeight + HIERARCHY_CLUSTER_SIZE - 1) >> HIERARCHY_CLUSTER_SHIFT;
+  clusters.resize(columns * rows);
+  verticalBorders.resize(columns * rows);
+  horizontalBorders.resize(columns * rows);
+  dirty.resize(columns * rows);
+  capped.resize(columns * rows * 2);
+}
+
+// Cells x1 <= x < x2, y1 <= y < y2 of the cluster, clusters on the right and bottom edges are smaller
+void Hierarchy::clusterBounds(int cluster, int &x1, int &y1, int &x2, int &y2) const
+{
+  x1 = (cluster % columns) << HIERARCHY_CLUSTER_SHIFT;
+  y1 = (cluster / columns) << HIERARCHY_CLUSTER_SHIFT;
+  x2 = std::min(x1 + HIERARCHY_CLUSTER_SIZE, pathfinding->worldWidth);
+  y2 = std::min(y1 + HIERARCHY_CLUSTER_SIZE, pathfinding->worldHeight);
+}
+
+// Dijkstra from cell to every cell of the cluster without leaving it, into scratch.distance indexed by
+// the cell's position in the cluster. With reverse the costs are of the paths from each cell to cell.
+void Hierarchy::clusterCosts(const Pathfinding &grid, int cluster, int cell, bool reverse, HierarchySearch &scratch, bool record) const
+{
+  int x1, y1, x2, y2;
+  clusterBounds(cluster, x1, y1, x2, y2);
+  const uint8_t *cells = grid.cells();
+  std::vector<int32_t> &distance = scratch.distance;
+  std::vector<uint64_t> &queue = scratch.queue;
+  distance.assign(HIERARCHY_CLUSTER_SIZE * HIERARCHY_CLUSTER_SIZE, -1);
+  queue.clear();
+
+  int origin = (grid.cellY(cell) - y1) * HIERARCHY_CLUSTER_SIZE + grid.cellX(cell) - x1;
+  distance[origin] = 0;
+  queue.push_back(origin);
+  while (!queue.empty())
+  {
+    std::pop_heap(queue.begin(), queue.end(), std::greater<uint64_t>());
+    uint64_t entry = queue.back();
+    queue.pop_back();
+    int32_t cost = entry >> 32;
+    int local = entry & 0xffffffff;
+    if (cost > distance[local])
+      continue;
+
+    int x = x1 + local % HIERARCHY_CLUSTER_SIZE;
+    int y = y1 + local / HIERARCHY_CLUSTER_SIZE;
+    int current = grid.index(x, y);
+    if (record)
+      scratch.reads.push_back(current);
+    // Walking backwards every step ends on the current cell
+    if (reverse && cells[current] >= PATHFINDING_BLOCKED_WEIGHT)
+      continue;
+
+    for (int d = 0; d < 4; d++)
+    {
+      int dx = clusterDirections[d][0];
+      int dy = clusterDirections[d][1];
+      if (x + dx < x1 || x + dx >= x2 || y + dy < y1 || y + dy >= y2)
+        continue;
+      int next = current + dy * grid.stride + dx;
+      if (cells[next] >= PATHFINDING_BLOCKED_WEIGHT)
+        continue;
+
+      int neighbour = local + dy * HIERARCHY_CLUSTER_SIZE + dx;
+      int32_t nextCost = cost + 1 + (reverse ? cells[current] : cells[next]);
+      if (distance[neighbour] < 0 || nextCost < distance[neighbour])
+      {
+        distance[neighbour] = nextCost;
+        queue.push_back((uint64_t)nextCost << 32 | neighbour);
+        std::push_heap(queue.begin(), queue.end(), std::greater<uint64_t>());
+      }
+    }
+  }
+}
+
+int32_t Hierarchy::allocateNode(void)
+{
+  if (!freeNodes.empty())
+  {
+    int32_t node = freeNodes.back();
+    freeNodes.pop_back();
+    return node;
+  }
+  nodes.push_back({});
+  return nodes.size() - 1;
+}
+
+// Finds the openings along one side of a cluster and puts an entrance in the middle of each
+void Hierarchy::scanBorder(bool vertical, int border)
+{
+  std::vector<int32_t> &pairs = vertical ? verticalBorders[border] : horizontalBorders[border];
+  for (int32_t node : pairs)
+  {
+    nodes[node].cluster = -1;
+    freeNodes.push_back(node);
+  }
+  pairs.clear();
+
+  int first = border;
+  int second = vertical ? border + 1 : border + columns;
+  int x1, y1, x2, y2;
+  clusterBounds(first, x1, y1, x2, y2);
+  const uint8_t *cells = pathfinding->cells();
+  int line = vertical ? pathfinding->index(x2 - 1, y1) : pathfinding->index(x1, y2 - 1);
+  int along = vertical ? pathfinding->stride : 1;
+  int across = vertical ? 1 : pathfinding->stride;
+  int length = vertical ? y2 - y1 : x2 - x1;
+
+  int runStart[HIERARCHY_CLUSTER_SIZE / 2 + 1];
+  int runLength[HIERARCHY_CLUSTER_SIZE / 2 + 1];
+  int runs = 0;
+  for (int i = 0; i < length;)
+  {
+    int cell = line + i * along;
+    if (cells[cell] >= PATHFINDING_BLOCKED_WEIGHT || cells[cell + across] >= PATHFINDING_BLOCKED_WEIGHT)
+    {
+      i++;
+      continue;
+    }
+    int start = i;
+    while (i < length && cells[line + i * along] < PATHFINDING_BLOCKED_WEIGHT &&
+           cells[line + i * along + across] < PATHFINDING_BLOCKED_WEIGHT)
+      i++;
+    runStart[runs] = start;
+    runLength[runs] = i - start;
+    runs++;
+  }
+
+  // Too many openings, keep the widest ones in their order along the side
+  int order[HIERARCHY_CLUSTER_SIZE / 2 + 1];
+  for (int i = 0; i < runs; i++)
+    order[i] = i;
+  int flag = border * 2 + (vertical ? 1 : 0);
+  cappedCount -= capped[flag];
+  capped[flag] = runs > HIERARCHY_MAX_ENTRANCES;
+  cappedCount += capped[flag];
+  if (runs > HIERARCHY_MAX_ENTRANCES)
+  {
+    std::stable_sort(order, order + runs, [&](int a, int b) { return runLength[a] > runLength[b]; });
+    runs = HIERARCHY_MAX_ENTRANCES;
+    std::sort(order, order + runs);
+  }
+
+  for (int i = 0; i < runs; i++)
+  {
+    int run = order[i];
+    int a = allocateNode();
+    int b = allocateNode();
+    int cellA = line + (runStart[run] + (runLength[run] - 1) / 2) * along;
+    int cellB = cellA + across;
+    nodes[a] = {cellA, first, -1, b, 1 + cells[cellB]};
+    nodes[b] = {cellB, second, -1, a, 1 + cells[cellA]};
+    pairs.push_back(a);
+    pairs.push_back(b);
+  }
+}
+
+void Hierarchy::collectNodes(int cluster)
+{
+  std::vector<int32_t> &list = clusters[cluster].nodes;
+  list.clear();
+  int cx = cluster % columns;
+  int cy = cluster / columns;
+  const std::vector<int32_t> *sides[4] = {
+      cy > 0 ? &horizontalBorders[cluster - columns] : nullptr,
+      cx < columns - 1 ? &verticalBorders[cluster] : nullptr,
+      cy < rows - 1 ? &horizontalBorders[cluster] : nullptr,
+      cx > 0 ? &verticalBorders[cluster - 1] : nullptr,
+  };
+  for (const std::vector<int32_t> *side : sides)
+  {
+    if (!side)
+      continue;
+    for (int32_t node : *side)
+      if (nodes[node].cluster == cluster)
+      {
+        nodes[node].slot = list.size();
+        list.push_back(node);
+      }
+  }
+}
+
+void Hierarchy::computeCosts(int cluster)
+{
+  Cluster &target = clusters[cluster];
+  int count = target.nodes.size();
+  int x1, y1, x2, y2;
+  clusterBounds(cluster, x1, y1, x2, y2);
+  target.costs.assign(count * count, -1);
+  for (int i = 0; i < count; i++)
+  {
+    clusterCosts(*pathfinding, cluster, nodes[target.nodes[i]].cell, false, build, false);
+    for (int j = 0; j < count; j++)
+    {
+      int cell = nodes[target.nodes[j]].cell;
+      int local = (pathfinding->cellY(cell) - y1) * HIERARCHY_CLUSTER_SIZE + pathfinding->cellX(cell) - x1;
+      target.costs[i * count + j] = build.distance[local];
+    }
+  }
+}
+
+int Hierarchy::update(void)
+{
+  const uint8_t *cells = pathfinding->cells();
+  int count = pathfinding->cellCount();
+  int width = pathfinding->worldWidth;
+  bool first = (int)snapshot.size() != count;
+  std::fill(dirty.begin(), dirty.end(), first ? 1 : 0);
+
+  if (!first)
+  {
+    for (int y = 0; y < pathfinding->worldHeight; y++)
+    {
+      const uint8_t *current = cells + pathfinding->index(0, y);
+      const uint8_t *previous = snapshot.data() + pathfinding->index(0, y);
+      if (memcmp(current, previous, width) == 0)
+        continue;
+      int x1 = 0;
+      while (current[x1] == previous[x1])
+        x1++;
+      int x2 = width - 1;
+      while (current[x2] == previous[x2])
+        x2--;
+      for (int cluster = clusterOf(x1, y); cluster <= clusterOf(x2, y); cluster++)
+        dirty[cluster] = 1;
+    }
+  }
+  snapshot.assign(cells, cells + count);
+
+  // The entrances of a side depend on the cells of both clusters, scan each side once
+  for (int cluster = 0; cluster < (int)clusters.size(); cluster++)
+  {
+    if (dirty[cluster] != 1)
+      continue;
+    int cx = cluster % columns;
+    int cy = cluster / columns;
+    if (cx > 0 && dirty[cluster - 1] != 1)
+      scanBorder(true, cluster - 1);
+    if (cx < columns - 1)
+      scanBorder(true, cluster);
+    if (cy > 0 && dirty[cluster - columns] != 1)
+      scanBorder(false, cluster - columns);
+    if (cy < rows - 1)
+      scanBorder(false, cluster);
+  }
+
+  // Neighbours got new entrances on the shared side
+  for (int cluster = 0; cluster < (int)clusters.size(); cluster++)
+  {
+    if (dirty[cluster] != 1)
+      continue;
+    int cx = cluster % columns;
+    int cy = cluster / columns;
+    if (cx > 0 && dirty[cluster - 1] == 0)
+      dirty[cluster - 1] = 2;
+    if (cx < columns - 1 && dirty[cluster + 1] == 0)
+      dirty[cluster + 1] = 2;
+    if (cy > 0 && dirty[cluster - columns] == 0)
+      dirty[cluster - columns] = 2;
+    if (cy < rows - 1 && dirty[cluster + columns] == 0)
+      dirty[cluster + columns] = 2;
+  }
+
+  int rebuilt = 0;
+  for (int cluster = 0; cluster < (int)clusters.size(); cluster++)
+  {
+    if (dirty[cluster] == 0)
+      continue;
+    collectNodes(cluster);
+    computeCosts(cluster);
+    rebuilt++;
+  }
+  if (!first && rebuilt > 0)
+    renumberNodes();
+  return rebuilt;
+}
+
+// findPath breaks ties between entrances on their node IDs, which scanBorder recycles. Numbering the
+// nodes side by side the way the first update allocates them keeps the routes independent of the
+// edit history.
+void Hierarchy::renumberNodes(void)
+{
+  std::vector<int32_t> renumbered(nodes.size(), -1);
+  std::vector<HierarchyNode> ordered;
+  ordered.reserve(nodes.size() - freeNodes.size());
+  for (size_t border = 0; border < clusters.size(); border++)
+  {
+    std::vector<int32_t> *sides[2] = {&verticalBorders[border], &horizontalBorders[border]};
+    for (std::vector<int32_t> *pairs : sides)
+    {
+      for (int32_t &node : *pairs)
+      {
+        renumbered[node] = ordered.size();
+        ordered.push_back(nodes[node]);
+        node = renumbered[node];
+      }
+    }
+  }
+  for (HierarchyNode &node : ordered)
+    node.peer = renumbered[node.peer];
+  for (Cluster &cluster : clusters)
+  {
+    for (int32_t &node : cluster.nodes)
+      node = renumbered[node];
+  }
+  nodes.swap(ordered);
+  freeNodes.clear();
+}
+
+// A change in the cluster or one cell around it can change the entrance graph there
+void Hierarchy::exploreCluster(HierarchySearch &scratch, int cluster) const
+{
+  int x1, y1, x2, y2;
+  clusterBounds(cluster, x1, y1, x2, y2);
+  scratch.exploredX1 = std::min(scratch.exploredX1, x1 - 1);
+  scratch.exploredY1 = std::min(scratch.exploredY1, y1 - 1);
+  scratch.exploredX2 = std::max(scratch.exploredX2, x2);
+  scratch.exploredY2 = std::max(scratch.exploredY2, y2);
+}
+
+void Hierarchy::accumulate(HierarchySearch &scratch, const PathSearch &search) const
+{
+  scratch.exploredX1 = std::min(scratch.exploredX1, search.exploredX1);
+  scratch.exploredY1 = std::min(scratch.exploredY1, search.exploredY1);
+  scratch.exploredX2 = std::max(scratch.exploredX2, search.exploredX2);
+  scratch.exploredY2 = std::max(scratch.exploredY2, search.exploredY2);
+  if (search.recordReads)
+    scratch.reads.insert(scratch.reads.end(), search.reads.begin(), search.reads.end());
+}
+
+int Hierarchy::findPath(const Pathfinding &grid, int startX, int startY, int endX, int endY, PathSearch &search, HierarchySearch &scratch) const
+{
+  int width = grid.worldWidth;
+  int height = grid.worldHeight;
+  bool inside = startX >= 0 && startY >= 0 && startX < width && startY < height &&
+                endX >= 0 && endY >= 0 && endX < width && endY < height;
+  if (!inside || snapshot.empty() || abs(endX - startX) + abs(endY - startY) < HIERARCHY_MIN_DISTANCE ||
+      clusterOf(startX, startY) == clusterOf(endX, endY))
+    return grid.findPath(startX, startY, endX, endY, false, search);
+
+  // No grid search runs when the plan finds no way through
+  search.path.clear();
+  search.truncated = false;
+  scratch.reads.clear();
+  scratch.exploredX1 = width;
+  scratch.exploredY1 = height;
+  scratch.exploredX2 = -1;
+  scratch.exploredY2 = -1;
+  bool record = search.recordReads;
+
+  // Link the start and end cells to the entrances of their clusters
+  int startCluster = clusterOf(startX, startY);
+  int endCluster = clusterOf(endX, endY);
+  const Cluster &startNodes = clusters[startCluster];
+  const Cluster &endNodes = clusters[endCluster];
+  auto costs = [&](const Cluster &cluster, int index, std::vector<int32_t> &result) {
+    int x1, y1, x2, y2;
+    clusterBounds(index, x1, y1, x2, y2);
+    result.resize(cluster.nodes.size());
+    for (size_t i = 0; i < cluster.nodes.size(); i++)
+    {
+      int cell = nodes[cluster.nodes[i]].cell;
+      result[i] = scratch.distance[(grid.cellY(cell) - y1) * HIERARCHY_CLUSTER_SIZE + grid.cellX(cell) - x1];
+    }
+  };
+  clusterCosts(grid, startCluster, grid.index(startX, startY), false, scratch, record);
+  costs(startNodes, startCluster, scratch.startCosts);
+  clusterCosts(grid, endCluster, grid.index(endX, endY), true, scratch, record);
+  costs(endNodes, endCluster, scratch.endCosts);
+  exploreCluster(scratch, startCluster);
+  exploreCluster(scratch, endCluster);
+
+  // A* over the entrances, with the start and end as two extra nodes
+  int startNode = nodes.size();
+  int endNode = startNode + 1;
+  if ((int)scratch.stamps.size() < endNode + 1)
+  {
+    scratch.g.resize(endNode + 1);
+    scratch.parent.resize(endNode + 1);
+    scratch.stamps.assign(endNode + 1, 0);
+    scratch.stamp = 0;
+  }
+  if (++scratch.stamp == 0)
+  {
+    std::fill(scratch.stamps.begin(), scratch.stamps.end(), 0);
+    scratch.stamp = 1;
+  }
+
+  auto heuristic = [&](int node) {
+    if (node == endNode)
+      return 0;
+    if (node == startNode)
+      return abs(endX - startX) + abs(endY - startY);
+    int cell = nodes[node].cell;
+    return abs(endX - grid.cellX(cell)) + abs(endY - grid.cellY(cell));
+  };
+  auto relax = [&](int node, int32_t g, int from) {
+    if (scratch.stamps[node] == scratch.stamp && scratch.g[node] <= g)
+      return;
+    scratch.stamps[node] = scratch.stamp;
+    scratch.g[node] = g;
+    scratch.parent[node] = from;
+    scratch.open.push_back((uint64_t)(g + heuristic(node)) << 32 | node);
+    std::push_heap(scratch.open.begin(), scratch.open.end(), std::greater<uint64_t>());
+  };
+
+  scratch.open.clear();
+  relax(startNode, 0, -1);
+  bool found = false;
+  while (!scratch.open.empty())
+  {
+    std::pop_heap(scratch.open.begin(), scratch.open.end(), std::greater<uint64_t>());
+    uint64_t entry = scratch.open.back();
+    scratch.open.pop_back();
+    int node = entry & 0xffffffff;
+    int32_t g = scratch.g[node];
+    // Reached again with a lower cost since
+    if ((int32_t)(entry >> 32) != g + heuristic(node))
+      continue;
+    if (node == endNode)
+    {
+      found = true;
+      break;
+    }
+
+    if (node == startNode)
+    {
+      for (size_t i = 0; i < startNodes.nodes.size(); i++)
+        if (scratch.startCosts[i] >= 0)
+          relax(startNodes.nodes[i], scratch.startCosts[i], node);
+      continue;
+    }
+
+    const HierarchyNode &current = nodes[node];
+    const Cluster &cluster = clusters[current.cluster];
+    exploreCluster(scratch, current.cluster);
+    int count = cluster.nodes.size();
+    for (int i = 0; i < count; i++)
+    {
+      int32_t cost = cluster.costs[current.slot * count + i];
+      if (i != current.slot && cost >= 0)
+        relax(cluster.nodes[i], g + cost, node);
+    }
+    relax(current.peer, g + current.peerCost, node);
+    if (current.cluster == endCluster && scratch.endCosts[current.slot] >= 0)
+      relax(endNode, g + scratch.endCosts[current.slot], node);
+  }
+
+  int length = 0;
+  if (found)
+  {
+    // Refine on the grid inside the clusters the plan passes through
+    if (scratch.corridorStamps.size() != clusters.size())
+    {
+      scratch.corridorStamps.assign(clusters.size(), 0);
+      scratch.corridor.stamp = 0;
+    }
+    if (++scratch.corridor.stamp == 0)
+    {
+      std::fill(scratch.corridorStamps.begin(), scratch.corridorStamps.end(), 0);
+      scratch.corridor.stamp = 1;
+    }
+    uint32_t stamp = scratch.corridor.stamp;
+    scratch.corridor = {HIERARCHY_CLUSTER_SHIFT, columns, width - 1, height - 1, scratch.corridorStamps.data(), stamp};
+    scratch.corridorStamps[startCluster] = stamp;
+    scratch.corridorStamps[endCluster] = stamp;
+    for (int node = scratch.parent[endNode]; node != startNode; node = scratch.parent[node])
+      scratch.corridorStamps[nodes[node].cluster] = stamp;
+
+    search.corridor = &scratch.corridor;
+    length = grid.findPath(startX, startY, endX, endY, false, search);
+    search.corridor = nullptr;
+    accumulate(scratch, search);
+  }
+
+  // The grid changed since the last update in a way that cuts the plan off, or the way through is
+  // an entrance that was dropped
+  if (length == 0 && (found || cappedCount > 0))
+  {
+    length = grid.findPath(startX, startY, endX, endY, false, search);
+    accumulate(scratch, search);
+  }
+
+  search.exploredX1 = scratch.exploredX1;
+  search.exploredY1 = scratch.exploredY1;
+  search.exploredX2 = scratch.exploredX2;
+  search.exploredY2 = scratch.exploredY2;
+  if (record)
+    search.reads = scratch.reads;
+  return length;
+}
+
+size_t Hierarchy::memoryUsage(void) const
+{
+  size_t bytes = nodes.capacity() * sizeof(HierarchyNode) + freeNodes.capacity() * sizeof(int32_t) +
+                 snapshot.capacity() + dirty.capacity() + capped.capacity();
+  for (const Cluster &cluster : clusters)
+    bytes += sizeof(Cluster) + (cluster.nodes.capacity() + cluster.costs.capacity()) * sizeof(int32_t);
+  for (size_t i = 0; i < verticalBorders.size(); i++)
+    bytes += (verticalBorders[i].capacity() + horizontalBorders[i].capacity()) * sizeof(int32_t);
+  return bytes;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "Pathfinding.h"
+
+// Clusters are 1 << HIERARCHY_CLUSTER_SHIFT cells wide and high
+#define HIERARCHY_CLUSTER_SHIFT 5
+
+// Entrances kept per cluster side, the widest openings win. Bounds every cluster's cost matrix
+// to (4 * HIERARCHY_MAX_ENTRANCES)^2 entries.
+#define HIERARCHY_MAX_ENTRANCES 8
+
+// Routes shorter than this many cells are searched on the grid directly
+#define HIERARCHY_MIN_DISTANCE 64
+
+// One side of an entrance between two neighbouring clusters
+struct HierarchyNode
+{
+  int32_t cell;
+  int32_t cluster;
+  int32_t slot;     // index in the cluster's nodes
+  int32_t peer;     // node on the other side of the entrance
+  int32_t peerCost; // cost of stepping onto the peer's cell
+};
+
+struct Cluster
+{
+  std::vector<int32_t> nodes;
+  // Cost of the cheapest path inside the cluster from node i to node j at i * nodes + j, -1 if none
+  std::vector<int32_t> costs;
+};
+
+// Scratch state of one Hierarchy::findPath, one per thread
+struct HierarchySearch
+{
+  // Dijkstra inside a cluster
+  std::vector<int32_t> distance;
+  std::vector<uint64_t> queue;
+  std::vector<int32_t> startCosts;
+  std::vector<int32_t> endCosts;
+
+  // A* over the entrance graph
+  std::vector<int32_t> g;
+  std::vector<int32_t> parent;
+  std::vector<uint32_t> stamps;
+  uint32_t stamp = 0;
+  std::vector<uint64_t> open;
+
+  std::vector<uint32_t> corridorStamps;
+  Corridor corridor;
+
+  // What every step of the query read, handed to the PathSearch at the end
+  std::vector<int32_t> reads;
+  int exploredX1, exploredY1, exploredX2, exploredY2;
+};
+
+// HPA*: the grid is cut into square clusters linked by entrances on their shared sides. A route is
+// planned over the entrance graph first, then A* refines it on the grid but only inside the
+// clusters the plan passes through. Cluster data is rebuilt only where the grid changed.
+//
+// The refined route is a real grid path of the current weights. It can be longer than the one
+// A* would find, by how much depends on the cluster size.
+class Hierarchy
+{
+public:
+  Hierarchy(const Pathfinding *pathfinding);
+
+  // Rebuilds the clusters whose cells changed since the last call, all of them on the first one.
+  // Returns the number of clusters rebuilt.
+  int update(void);
+
+  // Like Pathfinding::findPath with grid holding the weights the hierarchy was last updated from,
+  // apart from changes that do not block cells. search reports everything the query read, entrance
+  // graph included. When the entrance graph has no route there is no path, unless an entrance was
+  // dropped for HIERARCHY_MAX_ENTRANCES, then the whole grid is searched to be sure.
+  int findPath(const Pathfinding &grid, int startX, int startY, int endX, int endY, PathSearch &search, HierarchySearch &scratch) const;
+
+  // Bytes held by the clusters, entrances and grid snapshot
+  size_t memoryUsage(void) const;
+
+  const Pathfinding *pathfinding;
+
+private:
+  int clusterOf(int x, int y) const { return (y >> HIERARCHY_CLUSTER_SHIFT) * columns + (x >> HIERARCHY_CLUSTER_SHIFT); }
+  void clusterBounds(int cluster, int &x1, int &y1, int &x2, int &y2) const;
+  void clusterCosts(const Pathfinding &grid, int cluster, int cell, bool reverse, HierarchySearch &scratch, bool record) const;
+  void scanBorder(bool vertical, int border);
+  void collectNodes(int cluster);
+  void computeCosts(int cluster);
+  int32_t allocateNode(void);
+  void renumberNodes(void);
+  void exploreCluster(HierarchySearch &scratch, int cluster) const;
+  void accumulate(HierarchySearch &scratch, const PathSearch &search) const;
+
+  int columns;
+  int rows;
+  std::vector<Cluster> clusters;
+  std::vector<HierarchyNode> nodes;
+  std::vector<int32_t> freeNodes;
+
+  // Node pairs on each cluster side, first cluster's node first. Vertical borders separate a
+  // cluster from the one to its right, horizontal ones from the one below.
+  std::vector<std::vector<int32_t>> verticalBorders;
+  std::vector<std::vector<int32_t>> horizontalBorders;
+
+  // Sides that had more openings than HIERARCHY_MAX_ENTRANCES, two flags per cluster
+  std::vector<uint8_t> capped;
+  int cappedCount = 0;
+
+  std::vector<uint8_t> snapshot;
+  std::vector<uint8_t> dirty;
+  HierarchySearch build;
+};
@@ -0,0 +1,344 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "Pathfinding.h"
+
+// Neighbour order matters, ties in the open set resolve to the first pushed node: N, E, S, W
+static const int directions[4][2] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+
+static inline int sign(int value)
+{
+  return (value > 0) - (value < 0);
+}
+
+Pathfinding::Pathfinding(int w, int h)
+{
+  worldWidth = w;
+  worldHeight = h;
+  stride = w + 2;
+  grid.assign((size_t)stride * (h + 2), 0);
+}
+
+void Pathfinding::clear(void)
+{
+  memset(grid.data(), 0, grid.size());
+}
+
+void Pathfinding::fillRect(int x1, int y1, int x2, int y2, uint8_t weight)
+{
+  if (x1 < -1)
+    x1 = -1;
+  if (y1 < -1)
+    y1 = -1;
+  if (x2 > worldWidth + 1)
+    x2 = worldWidth + 1;
+  if (y2 > worldHeight + 1)
+    y2 = worldHeight + 1;
+  if (x1 >= x2)
+    return;
+
+  for (int y = y1; y < y2; y++)
+    memset(grid.data() + index(x1, y), weight, x2 - x1);
+}
+
+// Same bounds as the TypeScript neighbours(): a step never lands on the border along its own axis,
+// so border cells are only ever entered by starting on them
+bool Pathfinding::canStep(int x, int y, int dx, int dy) const
+{
+  int nx = x + dx;
+  int ny = y + dy;
+  if (dx != 0 && (nx < 0 || nx >= worldWidth))
+    return false;
+  if (dy != 0 && (ny < 0 || ny >= worldHeight))
+    return false;
+  return walkable(index(nx, ny));
+}
+
+void Pathfinding::prepare(PathSearch &search) const
+{
+  size_t count = grid.size();
+  if (search.stamps.size() < count)
+  {
+    search.stamps.assign(count, 0);
+    search.best.assign(count, -1);
+    search.stamp = 0;
+  }
+  search.stamp++;
+  if (search.stamp == 0)
+  {
+    std::fill(search.stamps.begin(), search.stamps.end(), 0);
+    search.stamp = 1;
+  }
+  search.nodes.clear();
+  search.heap.clear();
+  search.path.clear();
+  search.exploredX1 = worldWidth;
+  search.exploredY1 = worldHeight;
+  search.exploredX2 = -1;
+  search.exploredY2 = -1;
+  search.reads.clear();
+  search.truncated = false;
+}
+
+inline bool Pathfinding::overLimit(PathSearch &search) const
+{
+  if (search.nodeLimit == 0 || search.nodes.size() <= search.nodeLimit)
+    return false;
+  search.truncated = true;
+  return true;
+}
+
+// Grows the explored box by a cell and the neighbours it reads
+void Pathfinding::explore(PathSearch &search, int x, int y) const
+{
+  if (x - 1 < search.exploredX1)
+    search.exploredX1 = x - 1;
+  if (y - 1 < search.exploredY1)
+    search.exploredY1 = y - 1;
+  if (x + 1 > search.exploredX2)
+    search.exploredX2 = x + 1;
+  if (y + 1 > search.exploredY2)
+    search.exploredY2 = y + 1;
+  if (search.recordReads)
+    search.reads.push_back(index(x, y));
+}
+
+// The open set is a binary heap of node indices ordered by (f, index). Nodes are numbered in push
+// order, so equal f values pop first-in first-out like the array scan of the TypeScript version.
+static inline bool node_before(const std::vector<PathNode> &nodes, uint32_t a, uint32_t b)
+{
+  return nodes[a].f < nodes[b].f || (nodes[a].f == nodes[b].f && a < b);
+}
+
+uint32_t Pathfinding::pushNode(PathSearch &search, int32_t cell, int32_t parent, int32_t g, int32_t f) const
+{
+  uint32_t node = search.nodes.size();
+  search.nodes.push_back({cell, parent, g, f});
+
+  std::vector<uint32_t> &heap = search.heap;
+  size_t position = heap.size();
+  heap.push_back(node);
+  while (position > 0)
+  {
+    size_t parentPosition = (position - 1) / 2;
+    if (!node_before(search.nodes, node, heap[parentPosition]))
+      break;
+    heap[position] = heap[parentPosition];
+    position = parentPosition;
+  }
+  heap[position] = node;
+  return node;
+}
+
+uint32_t Pathfinding::popNode(PathSearch &search) const
+{
+  std::vector<uint32_t> &heap = search.heap;
+  uint32_t top = heap[0];
+  uint32_t last = heap.back();
+  heap.pop_back();
+
+  size_t count = heap.size();
+  size_t position = 0;
+  while (count > 0)
+  {
+    size_t child = position * 2 + 1;
+    if (child >= count)
+      break;
+    if (child + 1 < count && node_before(search.nodes, heap[child + 1], heap[child]))
+      child++;
+    if (!node_before(search.nodes, heap[child], last))
+      break;
+    heap[position] = heap[child];
+    position = child;
+  }
+  if (count > 0)
+    heap[position] = last;
+  return top;
+}
+
+// Walks parents back from node. Consecutive jump points lie on a straight line and get filled in.
+int Pathfinding::tracePath(PathSearch &search, int32_t node) const
+{
+  std::vector<int32_t> &path = search.path;
+  path.clear();
+  while (node >= 0)
+  {
+    const PathNode &current = search.nodes[node];
+    path.push_back(current.cell);
+    if (current.parent >= 0)
+    {
+      int parentCell = search.nodes[current.parent].cell;
+      int dx = sign(cellX(parentCell) - cellX(current.cell));
+      int dy = sign(cellY(parentCell) - cellY(current.cell));
+      int step = dy * stride + dx;
+      for (int cell = current.cell + step; cell != parentCell; cell += step)
+        path.push_back(cell);
+    }
+    node = current.parent;
+  }
+  for (size_t i = 0, j = path.size() - 1; i < j; i++, j--)
+  {
+    int32_t swap = path[i];
+    path[i] = path[j];
+    path[j] = swap;
+  }
+  return path.size();
+}
+
+int Pathfinding::findPath(int startX, int startY, int endX, int endY, bool jumpPoints, PathSearch &search) const
+{
+  prepare(search);
+  int start = index(startX, startY);
+  int end = index(endX, endY);
+  return jumpPoints ? jumpPointSearch(start, end, search) : aStar(start, end, search);
+}
+
+int Pathfinding::aStar(int start, int end, PathSearch &search) const
+{
+  int endX = cellX(end);
+  int endY = cellY(end);
+
+  // Like the TypeScript version the start is not marked, it can be reached again through a neighbour
+  pushNode(search, start, -1, 0, 0);
+  while (!search.heap.empty())
+  {
+    if (overLimit(search))
+      return 0;
+    uint32_t node = popNode(search);
+    PathNode current = search.nodes[node];
+    if (current.cell == end)
+      return tracePath(search, node);
+
+    int x = cellX(current.cell);
+    int y = cellY(current.cell);
+    explore(search, x, y);
+    for (int d = 0; d < 4; d++)
+    {
+      int dx = directions[d][0];
+      int dy = directions[d][1];
+      if (!canStep(x, y, dx, dy))
+        continue;
+      if (search.corridor && !search.corridor->contains(x + dx, y + dy))
+        continue;
+      int cell = current.cell + dy * stride + dx;
+      if (search.stamps[cell] == search.stamp)
+        continue;
+      search.stamps[cell] = search.stamp;
+
+      int weight = grid[cell];
+      int g = current.g + 1 + weight;
+      int f = g + abs(x + dx - endX) + abs(y + dy - endY) + weight;
+      pushNode(search, cell, node, g, f);
+    }
+  }
+  return 0;
+}
+
+// A perpendicular side forces a stop when it can be entered but the cell next to it, one step
+// back, could not have been crossed for free. Weighted sides stop jumps too so they get expanded.
+bool Pathfinding::forcedSide(int x, int y, int sideX, int sideY, int backX, int backY) const
+{
+  if (!canStep(x, y, sideX, sideY))
+    return false;
+  if (!uniform(index(x + sideX, y + sideY)))
+    return true;
+  int bx = x + backX + sideX;
+  int by = y + backY + sideY;
+  if (bx < 0 || by < 0 || bx >= worldWidth || by >= worldHeight)
+    return true;
+  return !uniform(index(bx, by));
+}
+
+int Pathfinding::jump(int cell, int dx, int dy, int end, PathSearch &search) const
+{
+  while (true)
+  {
+    int x = cellX(cell);
+    int y = cellY(cell);
+    explore(search, x, y);
+    if (cell == end || !uniform(cell))
+      return cell;
+
+    if (dx != 0)
+    {
+      if (forcedSide(x, y, 0, -1, -dx, 0) || forcedSide(x, y, 0, 1, -dx, 0))
+        return cell;
+    }
+    else
+    {
+      if (forcedSide(x, y, -1, 0, 0, -dy) || forcedSide(x, y, 1, 0, 0, -dy))
+        return cell;
+      // Moving vertically, stop wherever a horizontal jump would find something
+      if ((canStep(x, y, 1, 0) && jump(cell + 1, 1, 0, end, search) >= 0) ||
+          (canStep(x, y, -1, 0) && jump(cell - 1, -1, 0, end, search) >= 0))
+        return cell;
+    }
+
+    if (!canStep(x, y, dx, dy))
+      return -1;
+    cell += dy * stride + dx;
+  }
+}
+
+int Pathfinding::jumpPointSearch(int start, int end, PathSearch &search) const
+{
+  int endX = cellX(end);
+  int endY = cellY(end);
+
+  search.stamps[start] = search.stamp;
+  search.best[start] = pushNode(search, start, -1, 0, abs(cellX(start) - endX) + abs(cellY(start) - endY));
+  while (!search.heap.empty())
+  {
+    if (overLimit(search))
+      return 0;
+    uint32_t node = popNode(search);
+    PathNode current = search.nodes[node];
+    // Stale entry, the cell was reached again with a lower cost
+    if (search.best[current.cell] != (int32_t)node)
+      continue;
+    if (current.cell == end)
+      return tracePath(search, node);
+
+    int x = cellX(current.cell);
+    int y = cellY(current.cell);
+    explore(search, x, y);
+    int fromX = 0;
+    int fromY = 0;
+    if (current.parent >= 0 && uniform(current.cell))
+    {
+      int parentCell = search.nodes[current.parent].cell;
+      fromX = sign(x - cellX(parentCell));
+      fromY = sign(y - cellY(parentCell));
+    }
+
+    for (int d = 0; d < 4; d++)
+    {
+      int dx = directions[d][0];
+      int dy = directions[d][1];
+      // Prune the way back, and keep going straight or turning only
+      if (fromX != 0 || fromY != 0)
+      {
+        if (dx == -fromX && dy == -fromY)
+          continue;
+      }
+      if (!canStep(x, y, dx, dy))
+        continue;
+
+      int jumpPoint = jump(current.cell + dy * stride + dx, dx, dy, end, search);
+      if (jumpPoint < 0)
+        continue;
+
+      int jumpX = cellX(jumpPoint);
+      int jumpY = cellY(jumpPoint);
+      // Every cell skipped over has weight 0
+      int g = current.g + abs(jumpX - x) + abs(jumpY - y) + grid[jumpPoint];
+      if (search.stamps[jumpPoint] == search.stamp && search.nodes[search.best[jumpPoint]].g <= g)
+        continue;
+      search.stamps[jumpPoint] = search.stamp;
+      search.best[jumpPoint] = pushNode(search, jumpPoint, node, g, g + abs(jumpX - endX) + abs(jumpY - endY));
+    }
+  }
+  return 0;
+}
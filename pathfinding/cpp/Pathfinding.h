@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Cells with a weight at or above this are not walkable
+#define PATHFINDING_BLOCKED_WEIGHT 5
+
+// Search modes of the findPath and routeConnectors exports
+#define PATHFINDING_ASTAR 0
+#define PATHFINDING_JUMP_POINTS 1
+#define PATHFINDING_HIERARCHICAL 2
+
+struct PathNode
+{
+  int32_t cell;
+  int32_t parent;
+  int32_t g;
+  int32_t f;
+};
+
+// Square clusters of cells an A* search is allowed to enter, see Hierarchy
+struct Corridor
+{
+  int shift;
+  int columns;
+  int maxX, maxY;
+  const uint32_t *stamps;
+  uint32_t stamp;
+
+  // Border cells belong to the nearest cluster
+  inline bool contains(int x, int y) const
+  {
+    x = x < 0 ? 0 : (x > maxX ? maxX : x);
+    y = y < 0 ? 0 : (y > maxY ? maxY : y);
+    return stamps[(y >> shift) * columns + (x >> shift)] == stamp;
+  }
+};
+
+// Scratch state of one search. Cell sized arrays are stamped instead of cleared so a search
+// only touches the cells it explores.
+struct PathSearch
+{
+  std::vector<PathNode> nodes;
+  std::vector<uint32_t> heap;
+  std::vector<uint32_t> stamps;
+  std::vector<int32_t> best;
+  uint32_t stamp = 0;
+
+  // Cells of the last path, start first
+  std::vector<int32_t> path;
+
+  // Bounding box of every cell the last search read, inclusive. A change outside of it cannot
+  // change the result.
+  int exploredX1, exploredY1, exploredX2, exploredY2;
+
+  // With recordReads, every cell whose 3x3 neighbourhood the last search read
+  bool recordReads = false;
+  std::vector<int32_t> reads;
+
+  // Gives up once this many nodes were pushed, 0 for no limit. truncated tells a search that gave
+  // up from one that found no path.
+  uint32_t nodeLimit = 0;
+  bool truncated = false;
+
+  // When set A* only enters cells of the corridor, jump point search ignores it
+  const Corridor *corridor = nullptr;
+};
+
+class Pathfinding
+{
+public:
+  Pathfinding(int worldWidth, int worldHeight);
+
+  // Resets every cell, sentinels included, to weight 0
+  void clear(void);
+
+  // Sets the weight of cells x1 <= x < x2, y1 <= y < y2, in world coordinates
+  void fillRect(int x1, int y1, int x2, int y2, uint8_t weight);
+
+  // A* over the 4-connected grid, same expansion order as the TypeScript implementation.
+  // With jumpPoints the search skips over runs of weight 0 cells instead. Returns the path length.
+  int findPath(int startX, int startY, int endX, int endY, bool jumpPoints, PathSearch &search) const;
+
+  // Cells are stored row by row with a one cell border, so -1 and worldWidth/worldHeight are valid
+  inline int index(int x, int y) const { return (y + 1) * stride + (x + 1); }
+  inline int cellX(int cell) const { return cell % stride - 1; }
+  inline int cellY(int cell) const { return cell / stride - 1; }
+
+  uint8_t *cells(void) { return grid.data(); }
+  const uint8_t *cells(void) const { return grid.data(); }
+  int cellCount(void) const { return (int)grid.size(); }
+
+  int worldWidth;
+  int worldHeight;
+  int stride;
+
+private:
+  void prepare(PathSearch &search) const;
+  uint32_t pushNode(PathSearch &search, int32_t cell, int32_t parent, int32_t g, int32_t f) const;
+  uint32_t popNode(PathSearch &search) const;
+  int tracePath(PathSearch &search, int32_t node) const;
+  void explore(PathSearch &search, int x, int y) const;
+  bool overLimit(PathSearch &search) const;
+
+  int aStar(int start, int end, PathSearch &search) const;
+  int jumpPointSearch(int start, int end, PathSearch &search) const;
+  int jump(int cell, int dx, int dy, int end, PathSearch &search) const;
+  bool canStep(int x, int y, int dx, int dy) const;
+  bool forcedSide(int x, int y, int sideX, int sideY, int backX, int backY) const;
+
+  inline bool walkable(int cell) const { return grid[cell] < PATHFINDING_BLOCKED_WEIGHT; }
+  inline bool uniform(int cell) const { return grid[cell] == 0; }
+
+  std::vector<uint8_t> grid;
+};
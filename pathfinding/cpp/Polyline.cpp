@@ -0,0 +1,223 @@
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "Polyline.h"
+
+static const float polylinePi = 3.14159265f;
+
+static inline void push_triangle(std::vector<float> &out, float ax, float ay, float bx, float by, float cx, float cy)
+{
+  out.push_back(ax);
+  out.push_back(ay);
+  out.push_back(bx);
+  out.push_back(by);
+  out.push_back(cx);
+  out.push_back(cy);
+}
+
+// Squared distance from (x, y) to the segment a-b
+static inline float segment_distance2(float x, float y, float ax, float ay, float bx, float by)
+{
+  float dx = bx - ax, dy = by - ay;
+  float length2 = dx * dx + dy * dy;
+  float t = length2 > 0 ? ((x - ax) * dx + (y - ay) * dy) / length2 : 0;
+  t = t < 0 ? 0 : (t > 1 ? 1 : t);
+  float ex = ax + t * dx - x, ey = ay + t * dy - y;
+  return ex * ex + ey * ey;
+}
+
+void simplify_polyline(std::vector<float> &points, float tolerance, PolylineScratch &scratch)
+{
+  int count = points.size() / 2;
+  if (count < 2)
+    return;
+
+  // A point stays where the direction turns or reverses, repeated points have neither
+  int kept = 1;
+  for (int i = 1; i < count - 1; i++)
+  {
+    float ax = points[i * 2] - points[kept * 2 - 2], ay = points[i * 2 + 1] - points[kept * 2 - 1];
+    float bx = points[i * 2 + 2] - points[i * 2], by = points[i * 2 + 3] - points[i * 2 + 1];
+    if (ax * by - ay * bx != 0 || ax * bx + ay * by < 0)
+    {
+      points[kept * 2] = points[i * 2];
+      points[kept * 2 + 1] = points[i * 2 + 1];
+      kept++;
+    }
+  }
+  points[kept * 2] = points[count * 2 - 2];
+  points[kept * 2 + 1] = points[count * 2 - 1];
+  kept++;
+  points.resize(kept * 2);
+  if (tolerance <= 0 || kept < 3)
+    return;
+
+  // Douglas-Peucker: keep the point farthest from each span's chord while it is beyond the tolerance
+  std::vector<uint8_t> &keep = scratch.keep;
+  std::vector<int32_t> &stack = scratch.stack;
+  keep.assign(kept, 0);
+  keep[0] = keep[kept - 1] = 1;
+  stack.clear();
+  stack.push_back(0);
+  stack.push_back(kept - 1);
+  float tolerance2 = tolerance * tolerance;
+  while (!stack.empty())
+  {
+    int last = stack.back();
+    stack.pop_back();
+    int first = stack.back();
+    stack.pop_back();
+
+    int farthest = -1;
+    float distance2 = tolerance2;
+    for (int i = first + 1; i < last; i++)
+    {
+      float d = segment_distance2(points[i * 2], points[i * 2 + 1], points[first * 2], points[first * 2 + 1],
+                                  points[last * 2], points[last * 2 + 1]);
+      if (d > distance2)
+      {
+        distance2 = d;
+        farthest = i;
+      }
+    }
+    if (farthest < 0)
+      continue;
+    keep[farthest] = 1;
+    stack.push_back(first);
+    stack.push_back(farthest);
+    stack.push_back(farthest);
+    stack.push_back(last);
+  }
+
+  int simplified = 0;
+  for (int i = 0; i < kept; i++)
+    if (keep[i])
+    {
+      points[simplified * 2] = points[i * 2];
+      points[simplified * 2 + 1] = points[i * 2 + 1];
+      simplified++;
+    }
+  points.resize(simplified * 2);
+}
+
+// Triangles fanning around (x, y) from angle start over sweep radians, its chords within
+// POLYLINE_ROUND_TOLERANCE of the arc
+static void push_fan(std::vector<float> &out, float x, float y, float radius, float start, float sweep)
+{
+  float step = radius > POLYLINE_ROUND_TOLERANCE ? 2 * acosf(1 - POLYLINE_ROUND_TOLERANCE / radius) : polylinePi;
+  int segments = (int)ceilf(fabsf(sweep) / step);
+  segments = segments < 1 ? 1 : (segments > POLYLINE_MAX_ROUND_SEGMENTS ? POLYLINE_MAX_ROUND_SEGMENTS : segments);
+
+  float px = x + cosf(start) * radius, py = y + sinf(start) * radius;
+  for (int i = 1; i <= segments; i++)
+  {
+    float angle = start + sweep * i / segments;
+    float nx = x + cosf(angle) * radius, ny = y + sinf(angle) * radius;
+    push_triangle(out, x, y, px, py, nx, ny);
+    px = nx;
+    py = ny;
+  }
+}
+
+// Fills the outside of the corner at (x, y) between the segments with unit directions d0 and d1.
+// The inside is covered by the two segments overlapping.
+static void push_join(std::vector<float> &out, float x, float y, float d0x, float d0y, float d1x, float d1y,
+                      const PolylineStyle &style)
+{
+  float half = style.width / 2;
+  float cross = d0x * d1y - d0y * d1x, dot = d0x * d1x + d0y * d1y;
+  if (fabsf(cross) < 1e-6f && dot > 0)
+    return;
+
+  // Offsets of the two segment edges on the outside of the turn
+  float side = cross > 0 ? -half : half;
+  float n0x = -d0y * side, n0y = d0x * side;
+  float n1x = -d1y * side, n1y = d1x * side;
+
+  if (style.join == POLYLINE_JOIN_ROUND)
+  {
+    push_fan(out, x, y, half, atan2f(n0y, n0x), atan2f(cross, dot));
+    return;
+  }
+  if (style.join == POLYLINE_JOIN_MITER)
+  {
+    // The tip lies along the bisector of the offsets at half / cos(angle between them / 2)
+    float mx = n0x + n1x, my = n0y + n1y;
+    float length = sqrtf(mx * mx + my * my);
+    float cosHalf = length / (2 * half);
+    if (cosHalf > 0 && 1 / cosHalf <= style.miterLimit)
+    {
+      float scale = half / (cosHalf * length);
+      float tipX = x + mx * scale, tipY = y + my * scale;
+      push_triangle(out, x, y, x + n0x, y + n0y, tipX, tipY);
+      push_triangle(out, x, y, tipX, tipY, x + n1x, y + n1y);
+      return;
+    }
+  }
+  push_triangle(out, x, y, x + n0x, y + n0y, x + n1x, y + n1y);
+}
+
+int tessellate_polyline(const float *points, int count, const PolylineStyle &style, std::vector<float> &out)
+{
+  size_t first = out.size();
+  float half = style.width / 2;
+  if (count <= 0 || half <= 0)
+    return 0;
+
+  // Previous segment's end and direction, segments of zero length are skipped
+  bool started = false;
+  float endX = points[0], endY = points[1], dirX = 0, dirY = 0;
+  for (int i = 0; i + 1 < count; i++)
+  {
+    float ax = points[i * 2], ay = points[i * 2 + 1];
+    float bx = points[i * 2 + 2], by = points[i * 2 + 3];
+    float dx = bx - ax, dy = by - ay;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length == 0)
+      continue;
+    dx /= length;
+    dy /= length;
+    float nx = -dy * half, ny = dx * half;
+
+    if (started)
+      push_join(out, ax, ay, dirX, dirY, dx, dy, style);
+    else if (style.cap == POLYLINE_CAP_ROUND)
+      push_fan(out, ax, ay, half, atan2f(ny, nx), polylinePi);
+    else if (style.cap == POLYLINE_CAP_SQUARE)
+    {
+      ax -= dx * half;
+      ay -= dy * half;
+    }
+
+    push_triangle(out, ax + nx, ay + ny, ax - nx, ay - ny, bx + nx, by + ny);
+    push_triangle(out, bx + nx, by + ny, ax - nx, ay - ny, bx - nx, by - ny);
+    started = true;
+    endX = bx;
+    endY = by;
+    dirX = dx;
+    dirY = dy;
+  }
+
+  // End caps go on the last segment that had a direction
+  if (!started)
+  {
+    // A point, or only repeats of one
+    if (style.cap == POLYLINE_CAP_ROUND)
+      push_fan(out, endX, endY, half, 0, 2 * polylinePi);
+    else if (style.cap == POLYLINE_CAP_SQUARE)
+    {
+      push_triangle(out, endX - half, endY - half, endX + half, endY - half, endX - half, endY + half);
+      push_triangle(out, endX + half, endY - half, endX + half, endY + half, endX - half, endY + half);
+    }
+  }
+  else if (style.cap == POLYLINE_CAP_ROUND)
+    push_fan(out, endX, endY, half, atan2f(-dirX, dirY), polylinePi);
+  else if (style.cap == POLYLINE_CAP_SQUARE)
+  {
+    float nx = -dirY * half, ny = dirX * half;
+    float tipX = endX + dirX * half, tipY = endY + dirY * half;
+    push_triangle(out, endX + nx, endY + ny, endX - nx, endY - ny, tipX + nx, tipY + ny);
+    push_triangle(out, tipX + nx, tipY + ny, endX - nx, endY - ny, tipX - nx, tipY - ny);
+  }
+  return (out.size() - first) / 2;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Joins between two segments, like CanvasRenderingContext2D.lineJoin
+#define POLYLINE_JOIN_MITER 0
+#define POLYLINE_JOIN_ROUND 1
+#define POLYLINE_JOIN_BEVEL 2
+
+// Ends of a polyline, like CanvasRenderingContext2D.lineCap
+#define POLYLINE_CAP_BUTT 0
+#define POLYLINE_CAP_ROUND 1
+#define POLYLINE_CAP_SQUARE 2
+
+// Round joins and caps stay within this distance of the true arc, in the units of the points
+#define POLYLINE_ROUND_TOLERANCE 0.02f
+#define POLYLINE_MAX_ROUND_SEGMENTS 32
+
+struct PolylineStyle
+{
+  float width = 1;
+  int join = POLYLINE_JOIN_MITER;
+  int cap = POLYLINE_CAP_BUTT;
+  // Miters longer than miterLimit * width / 2 are beveled, like the Canvas' miterLimit
+  float miterLimit = 10;
+  // Points may be dropped when the polyline stays within this distance of them, 0 only merges
+  // collinear steps
+  float tolerance = 0;
+
+  bool operator==(const PolylineStyle &other) const
+  {
+    return width == other.width && join == other.join && cap == other.cap && miterLimit == other.miterLimit &&
+           tolerance == other.tolerance;
+  }
+  bool operator!=(const PolylineStyle &other) const { return !(*this == other); }
+};
+
+// Scratch of simplify_polyline, reused between calls
+struct PolylineScratch
+{
+  std::vector<int32_t> stack;
+  std::vector<uint8_t> keep;
+};
+
+// Drops the points of an x,y polyline that lie on a straight run or repeat the one before, then,
+// with a tolerance, the ones Douglas-Peucker finds within it. points is rewritten in place.
+void simplify_polyline(std::vector<float> &points, float tolerance, PolylineScratch &scratch);
+
+// Appends the triangles covering a stroke of the x,y polyline to out, three x,y vertices each, and
+// returns how many vertices it added. Like a Canvas stroke of the same path but with overlapping
+// triangles where the stroke overlaps itself, so it has to be drawn opaque. A single point is drawn
+// as a dot by round and square caps.
+int tessellate_polyline(const float *points, int count, const PolylineStyle &style, std::vector<float> &out);
@@ -0,0 +1,545 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "Router.h"
+
+// Shared by every router, a revision names one path of one router
+static uint32_t routeRevisions = 0;
+
+static inline bool rects_intersect(const Rect &a, const Rect &b)
+{
+  return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+}
+
+// Clips a descriptor rect to the grid the way fillRect does, x2 and y2 exclusive
+static inline bool clip_descriptor_rect(const Pathfinding &grid, const int32_t *descriptor, int offset, int &x1, int &y1, int &x2, int &y2)
+{
+  x1 = descriptor[offset] < -1 ? -1 : descriptor[offset];
+  y1 = descriptor[offset + 1] < -1 ? -1 : descriptor[offset + 1];
+  x2 = descriptor[offset + 2] > grid.worldWidth + 1 ? grid.worldWidth + 1 : descriptor[offset + 2];
+  y2 = descriptor[offset + 3] > grid.worldHeight + 1 ? grid.worldHeight + 1 : descriptor[offset + 3];
+  return x1 < x2 && y1 < y2;
+}
+
+Router::Router(Pathfinding *p)
+{
+  pathfinding = p;
+  memory_add_evictor(MEMORY_PATHFINDING, evict_router_scratch, this);
+}
+
+Router::~Router(void)
+{
+  memory_remove_evictor(MEMORY_PATHFINDING, evict_router_scratch, this);
+}
+
+void Router::releaseScratch(void)
+{
+  for (RouterWorker &worker : workers)
+    worker = RouterWorker();
+  search = PathSearch();
+  hierarchySearch = HierarchySearch();
+  std::vector<SpeculativeRoute>().swap(speculative);
+  std::vector<int32_t>().swap(candidates);
+  std::vector<uint8_t>().swap(snapshot);
+  std::vector<int32_t>().swap(changeLog);
+  std::vector<CommitChanges>().swap(commits);
+}
+
+// Frees a speculation that was thrown away, its connector still has to be routed
+static void release_speculation(SpeculativeRoute &speculated)
+{
+  speculated.valid = false;
+  speculated.truncated = false;
+  speculated.conflicts++;
+  std::vector<int32_t>().swap(speculated.path);
+  std::vector<uint64_t>().swap(speculated.readBits);
+}
+
+void Router::evict_router_scratch(void *owner, int64_t excess)
+{
+  ((Router *)owner)->releaseScratch();
+}
+
+void Router::setThreads(int threads)
+{
+  if (pool && pool->size() == threads)
+    return;
+  pool.reset(threads > 1 ? new ThreadPool(threads) : nullptr);
+  workers.clear();
+  if (pool)
+  {
+    // The workers search, the scratch of the calling thread is left unused
+    workers.resize(pool->size());
+    search = PathSearch();
+    hierarchySearch = HierarchySearch();
+  }
+}
+
+int32_t *Router::descriptors(int count)
+{
+  if ((int)input.size() < count * CONNECTOR_FIELDS)
+    input.resize(count * CONNECTOR_FIELDS);
+  return input.data();
+}
+
+void Router::addDirty(const Rect &rect)
+{
+  if (rect.x1 <= rect.x2 && rect.y1 <= rect.y2)
+    dirty.push_back(rect);
+}
+
+bool Router::intersectsDirty(const Rect &rect) const
+{
+  for (const Rect &changed : dirty)
+    if (rects_intersect(rect, changed))
+      return true;
+  return false;
+}
+
+// Collects the cells that changed since the last call into row bands
+void Router::diffBase(void)
+{
+  dirty.clear();
+  const uint8_t *cells = pathfinding->cells();
+  int count = pathfinding->cellCount();
+  int stride = pathfinding->stride;
+
+  if ((int)previousBase.size() != count)
+  {
+    addDirty({-1, -1, pathfinding->worldWidth, pathfinding->worldHeight});
+    previousBase.assign(cells, cells + count);
+    return;
+  }
+
+  Rect band = {0, 0, -1, -1};
+  bool inBand = false;
+  for (int row = 0; row < count / stride; row++)
+  {
+    const uint8_t *current = cells + row * stride;
+    const uint8_t *previous = previousBase.data() + row * stride;
+    if (memcmp(current, previous, stride) == 0)
+    {
+      if (inBand)
+        addDirty(band);
+      inBand = false;
+      continue;
+    }
+
+    int first = 0;
+    while (current[first] == previous[first])
+      first++;
+    int last = stride - 1;
+    while (current[last] == previous[last])
+      last--;
+
+    int y = row - 1;
+    if (!inBand)
+    {
+      band = {first - 1, y, last - 1, y};
+      inBand = true;
+    }
+    else
+    {
+      if (first - 1 < band.x1)
+        band.x1 = first - 1;
+      if (last - 1 > band.x2)
+        band.x2 = last - 1;
+      band.y2 = y;
+    }
+  }
+  if (inBand)
+    addDirty(band);
+
+  memcpy(previousBase.data(), cells, count);
+}
+
+Rect Router::pathBounds(const std::vector<int32_t> &path) const
+{
+  Rect bounds = {pathfinding->worldWidth, pathfinding->worldHeight, -1, -1};
+  for (int32_t cell : path)
+  {
+    int x = pathfinding->cellX(cell);
+    int y = pathfinding->cellY(cell);
+    if (x < bounds.x1)
+      bounds.x1 = x;
+    if (y < bounds.y1)
+      bounds.y1 = y;
+    if (x > bounds.x2)
+      bounds.x2 = x;
+    if (y > bounds.y2)
+      bounds.y2 = y;
+  }
+  return bounds;
+}
+
+Rect Router::descriptorRect(const int32_t *descriptor, int offset) const
+{
+  return {descriptor[offset], descriptor[offset + 1], descriptor[offset + 2] - 1, descriptor[offset + 3] - 1};
+}
+
+void Router::fillDescriptorRect(const int32_t *descriptor, int offset, uint8_t weight)
+{
+  pathfinding->fillRect(descriptor[offset], descriptor[offset + 1], descriptor[offset + 2], descriptor[offset + 3], weight);
+}
+
+void Router::restoreDescriptorRect(Pathfinding &grid, const int32_t *descriptor, int offset) const
+{
+  int x1, y1, x2, y2;
+  if (!clip_descriptor_rect(grid, descriptor, offset, x1, y1, x2, y2))
+    return;
+  for (int y = y1; y < y2; y++)
+  {
+    int row = grid.index(x1, y);
+    memcpy(grid.cells() + row, snapshot.data() + row, x2 - x1);
+  }
+}
+
+// False when the search would read exactly the same cells as last time and find the same path. In
+// hierarchical mode the entrance graph of those cells is numbered the same way whatever the history.
+bool Router::needsSearch(const ConnectorRoute &route, const int32_t *descriptor, bool full) const
+{
+  return full || !route.cached || memcmp(route.descriptor, descriptor, sizeof(route.descriptor)) != 0 ||
+         intersectsDirty(route.explored);
+}
+
+void Router::findRoute(const Pathfinding &grid, const int32_t *descriptor, int mode, PathSearch &search, HierarchySearch &scratch) const
+{
+  if (mode == PATHFINDING_HIERARCHICAL)
+    hierarchy->findPath(grid, descriptor[0], descriptor[1], descriptor[2], descriptor[3], search, scratch);
+  else
+    grid.findPath(descriptor[0], descriptor[1], descriptor[2], descriptor[3], mode == PATHFINDING_JUMP_POINTS, search);
+}
+
+// Brings a worker's grid up to the round's snapshot, copying only the cells logged since it was synced
+void Router::syncWorker(RouterWorker &worker) const
+{
+  if (!worker.grid)
+    worker.grid.reset(new Pathfinding(pathfinding->worldWidth, pathfinding->worldHeight));
+  uint8_t *cells = worker.grid->cells();
+  if (!worker.synced)
+  {
+    memcpy(cells, snapshot.data(), snapshot.size());
+    worker.search.recordReads = true;
+    worker.synced = true;
+  }
+  else
+    for (size_t n = worker.logPosition; n < snapshotPosition; n++)
+      cells[changeLog[n]] = snapshot[changeLog[n]];
+  worker.logPosition = snapshotPosition;
+}
+
+// Starts a round: the grid as the connectors committed so far left it becomes the snapshot
+void Router::startRound(void)
+{
+  const uint8_t *cells = pathfinding->cells();
+  for (; snapshotPosition < changeLog.size(); snapshotPosition++)
+    snapshot[changeLog[snapshotPosition]] = cells[changeLog[snapshotPosition]];
+}
+
+// Routes the first window connectors from next that need a search and have no speculation yet, on
+// every worker against its own copy of the snapshot. Nothing else is shared, so the routes do not
+// depend on the scheduling. The one at next sees exactly the grid it is committed on and gets no
+// node limit.
+void Router::speculate(int count, int next, int window, int mode, bool full)
+{
+  candidates.clear();
+  for (int i = next, covered = 0; i < count && covered < window; i++)
+    if (needsSearch(routes[i], input.data() + i * CONNECTOR_FIELDS, full))
+    {
+      covered++;
+      SpeculativeRoute &speculated = speculative[i];
+      if (speculated.valid && readsChanged(speculated))
+      {
+        conflictCount++;
+        release_speculation(speculated);
+      }
+      // One that hit the node limit or keeps being invalidated waits until it is next
+      if (!speculated.valid && ((!speculated.truncated && speculated.conflicts < SPECULATIVE_MAX_CONFLICTS) || i == next))
+        candidates.push_back(i);
+    }
+
+  // Longest first, a long search started last would keep the other workers waiting
+  std::sort(candidates.begin(), candidates.end(), [&](int32_t a, int32_t b) {
+    const int32_t *first = input.data() + a * CONNECTOR_FIELDS, *second = input.data() + b * CONNECTOR_FIELDS;
+    return abs(first[2] - first[0]) + abs(first[3] - first[1]) > abs(second[2] - second[0]) + abs(second[3] - second[1]);
+  });
+
+  size_t commitCount = commits.size();
+  pool->run(candidates.size(), [&](int n, int w) {
+    RouterWorker &worker = workers[w];
+    syncWorker(worker);
+
+    int i = candidates[n];
+    const int32_t *descriptor = input.data() + i * CONNECTOR_FIELDS;
+    Pathfinding &grid = *worker.grid;
+    grid.fillRect(descriptor[4], descriptor[5], descriptor[6], descriptor[7], 0);
+    grid.fillRect(descriptor[8], descriptor[9], descriptor[10], descriptor[11], 0);
+    int distance = abs(descriptor[2] - descriptor[0]) + abs(descriptor[3] - descriptor[1]);
+    worker.search.nodeLimit = i == next ? 0 : SPECULATIVE_MIN_NODES + distance * SPECULATIVE_NODES_PER_CELL;
+    findRoute(grid, descriptor, mode, worker.search, worker.hierarchySearch);
+    restoreDescriptorRect(grid, descriptor, 4);
+    restoreDescriptorRect(grid, descriptor, 8);
+
+    SpeculativeRoute &result = speculative[i];
+    result.truncated = worker.search.truncated;
+    if (result.truncated)
+      return;
+    result.path = worker.search.path;
+    result.explored = {worker.search.exploredX1, worker.search.exploredY1, worker.search.exploredX2, worker.search.exploredY2};
+
+    // Read cells as a bitmap of their bounding box
+    const std::vector<int32_t> &reads = worker.search.reads;
+    int stride = pathfinding->stride;
+    Rect box = {stride, (int)(snapshot.size() / stride), -1, -1};
+    for (int32_t cell : reads)
+    {
+      int x = cell % stride, y = cell / stride;
+      box = {std::min(box.x1, x), std::min(box.y1, y), std::max(box.x2, x), std::max(box.y2, y)};
+    }
+    int width = box.x2 - box.x1 + 1;
+    result.readBits.assign(reads.empty() ? 0 : ((size_t)width * (box.y2 - box.y1 + 1) + 63) / 64, 0);
+    for (int32_t cell : reads)
+    {
+      size_t bit = (size_t)(cell / stride - box.y1) * width + cell % stride - box.x1;
+      result.readBits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    }
+    result.readCells = box;
+    result.checkedCommits = commitCount;
+    result.valid = true;
+  });
+}
+
+// Whether a connector committed since the speculation's round started changed a cell whose
+// neighbourhood its search read. Only the cells of commits whose changes come within a cell of the
+// read box are looked up in the bitmap. Cells in the connector's own anchor rects count too even
+// though it sees them cleared either way.
+bool Router::readsChanged(SpeculativeRoute &speculated)
+{
+  int stride = pathfinding->stride;
+  const Rect &box = speculated.readCells;
+  int width = box.x2 - box.x1 + 1;
+  const uint64_t *bits = speculated.readBits.data();
+  Rect near = {box.x1 - 1, box.y1 - 1, box.x2 + 1, box.y2 + 1};
+  for (size_t c = speculated.checkedCommits; c < commits.size(); c++)
+  {
+    if (!rects_intersect(commits[c].cells, near))
+      continue;
+    for (size_t n = c > 0 ? commits[c - 1].logEnd : 0; n < commits[c].logEnd; n++)
+    {
+      int x = changeLog[n] % stride, y = changeLog[n] / stride;
+      for (int ry = std::max(y - 1, box.y1); ry <= std::min(y + 1, box.y2); ry++)
+        for (int rx = std::max(x - 1, box.x1); rx <= std::min(x + 1, box.x2); rx++)
+        {
+          size_t bit = (size_t)(ry - box.y1) * width + rx - box.x1;
+          if (bits[bit >> 6] >> (bit & 63) & 1)
+            return true;
+        }
+    }
+  }
+  speculated.checkedCommits = commits.size();
+  return false;
+}
+
+// Logs a cell a commit left different from the round's snapshot
+void Router::markChanged(int32_t cell)
+{
+  if (pathfinding->cells()[cell] != snapshot[cell])
+    changeLog.push_back(cell);
+}
+
+void Router::markChangedRect(const int32_t *descriptor, int offset)
+{
+  int x1, y1, x2, y2;
+  if (!clip_descriptor_rect(*pathfinding, descriptor, offset, x1, y1, x2, y2))
+    return;
+  for (int y = y1; y < y2; y++)
+    for (int cell = pathfinding->index(x1, y); cell < pathfinding->index(x2, y); cell++)
+      markChanged(cell);
+}
+
+int Router::route(int count, int mode, bool full)
+{
+  // The grid as the caller left it is the base every connector builds on
+  diffBase();
+  if ((int)routes.size() != count)
+    routes.resize(count);
+
+  // Plans on the base grid, the paths marked while routing only reach the refining searches
+  if (mode == PATHFINDING_HIERARCHICAL)
+  {
+    if (!hierarchy)
+      hierarchy.reset(new Hierarchy(pathfinding));
+    hierarchy->update();
+  }
+
+  conflictCount = 0;
+  int searched = 0;
+  if (pool)
+    searched = routeParallel(count, mode, full);
+  else
+    for (int i = 0; i < count; i++)
+      searched += commit(i, mode, full, nullptr);
+
+  pack(count);
+  return searched;
+}
+
+// Routes connector i on the grid, or takes the route speculated for it, and marks it for the ones
+// after it. Returns 1 when it needed a search.
+int Router::commit(int i, int mode, bool full, const SpeculativeRoute *speculated)
+{
+  uint8_t *cells = pathfinding->cells();
+  const int32_t *descriptor = input.data() + i * CONNECTOR_FIELDS;
+  ConnectorRoute &route = routes[i];
+
+  fillDescriptorRect(descriptor, 4, 0);
+  fillDescriptorRect(descriptor, 8, 0);
+
+  bool sameRects = route.cached && memcmp(route.descriptor + 4, descriptor + 4, 8 * sizeof(int32_t)) == 0;
+
+  int searched = 0;
+  if (needsSearch(route, descriptor, full))
+  {
+    const std::vector<int32_t> *path;
+    Rect explored;
+    if (speculated)
+    {
+      path = &speculated->path;
+      explored = speculated->explored;
+    }
+    else
+    {
+      findRoute(*pathfinding, descriptor, mode, search, hierarchySearch);
+      path = &search.path;
+      explored = {search.exploredX1, search.exploredY1, search.exploredX2, search.exploredY2};
+    }
+    searched = 1;
+
+    // Connectors routed later see this one's writes, anything that moved is dirty for them
+    if (!route.cached || *path != route.path)
+    {
+      if (route.cached)
+        addDirty(pathBounds(route.path));
+      addDirty(pathBounds(*path));
+      route.revision = ++routeRevisions;
+    }
+    if (!sameRects)
+    {
+      if (route.cached)
+      {
+        addDirty(descriptorRect(route.descriptor, 4));
+        addDirty(descriptorRect(route.descriptor, 8));
+      }
+      addDirty(descriptorRect(descriptor, 4));
+      addDirty(descriptorRect(descriptor, 8));
+    }
+
+    route.path = *path;
+    route.explored = explored;
+    memcpy(route.descriptor, descriptor, sizeof(route.descriptor));
+    route.cached = true;
+  }
+
+  for (int32_t cell : route.path)
+    cells[cell] = CONNECTOR_PATH_WEIGHT;
+  fillDescriptorRect(descriptor, 4, ANCHOR_WEIGHT);
+  fillDescriptorRect(descriptor, 8, ANCHOR_WEIGHT);
+
+  if (pool)
+  {
+    size_t logStart = changeLog.size();
+    for (int32_t cell : route.path)
+      markChanged(cell);
+    markChangedRect(descriptor, 4);
+    markChangedRect(descriptor, 8);
+
+    int stride = pathfinding->stride;
+    Rect bounds = {stride, (int)(snapshot.size() / stride), -1, -1};
+    for (size_t n = logStart; n < changeLog.size(); n++)
+    {
+      int x = changeLog[n] % stride, y = changeLog[n] / stride;
+      bounds = {std::min(bounds.x1, x), std::min(bounds.y1, y), std::max(bounds.x2, x), std::max(bounds.y2, y)};
+    }
+    if (changeLog.size() > logStart)
+      commits.push_back({changeLog.size(), bounds});
+  }
+  return searched;
+}
+
+// Commits in rounds, each speculating on the window of connectors from the next one and taking
+// their routes in order until one conflicts
+int Router::routeParallel(int count, int mode, bool full)
+{
+  snapshot.assign(previousBase.begin(), previousBase.end());
+  changeLog.clear();
+  commits.clear();
+  snapshotPosition = 0;
+  speculative.resize(count);
+  for (RouterWorker &worker : workers)
+    worker.synced = false;
+
+  int window = pool->size() * SPECULATIVE_WINDOW_PER_THREAD;
+  int searched = 0;
+  int next = 0;
+  while (next < count)
+  {
+    // Connectors keeping their route need no round
+    if (!needsSearch(routes[next], input.data() + next * CONNECTOR_FIELDS, full))
+    {
+      commit(next++, mode, full, nullptr);
+      continue;
+    }
+
+    startRound();
+    speculate(count, next, window, mode, full);
+
+    for (; next < count; next++)
+    {
+      SpeculativeRoute &speculated = speculative[next];
+      if (!needsSearch(routes[next], input.data() + next * CONNECTOR_FIELDS, full))
+      {
+        speculated = SpeculativeRoute();
+        commit(next, mode, full, nullptr);
+        continue;
+      }
+      // Past the window, waiting to be next, or it only needed a search once an earlier connector moved
+      if (!speculated.valid && !speculated.truncated)
+        break;
+      if (speculated.truncated || readsChanged(speculated))
+      {
+        conflictCount++;
+        release_speculation(speculated);
+        break;
+      }
+      searched += commit(next, mode, full, &speculated);
+      speculated = SpeculativeRoute();
+    }
+  }
+  return searched;
+}
+
+void Router::pack(int count)
+{
+  size_t total = count * 2;
+  for (int i = 0; i < count; i++)
+    total += routes[i].path.size() * 2;
+  packed.resize(total);
+
+  int32_t offset = 0;
+  int32_t *pairs = packed.data() + count * 2;
+  for (int i = 0; i < count; i++)
+  {
+    const std::vector<int32_t> &path = routes[i].path;
+    packed[i * 2] = offset;
+    packed[i * 2 + 1] = path.size();
+    for (int32_t cell : path)
+    {
+      pairs[offset * 2] = pathfinding->cellX(cell);
+      pairs[offset * 2 + 1] = pathfinding->cellY(cell);
+      offset++;
+    }
+  }
+}
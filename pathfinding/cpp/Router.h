@@ -0,0 +1,172 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "Hierarchy.h"
+#include "Pathfinding.h"
+#include "ThreadPool.h"
+#include "../../common/cpp/memory_accounting.h"
+
+// Connector descriptor written by JS, all in world coordinates: startX, startY, endX, endY, then
+// the source and target collision rects as x1, y1, x2, y2 with x2 and y2 exclusive, like fillRect
+#define CONNECTOR_FIELDS 12
+
+// Weights the Engine uses while routing connectors
+#define CONNECTOR_PATH_WEIGHT 2
+#define ANCHOR_WEIGHT 5
+
+// A speculative search gives up after SPECULATIVE_MIN_NODES and this many nodes per cell of distance
+// and waits until its connector is the next one to commit. Searches that wander read so much of the
+// grid that an earlier connector nearly always invalidates them anyway.
+#define SPECULATIVE_NODES_PER_CELL 1
+#define SPECULATIVE_MIN_NODES 1024
+
+// A connector whose speculations were thrown away this many times waits until it is the next one
+#define SPECULATIVE_MAX_CONFLICTS 2
+
+// Connectors needing a search a round looks ahead at, per thread. Speculations a round does not
+// reach stay valid for the next one unless a commit invalidates them.
+#define SPECULATIVE_WINDOW_PER_THREAD 64
+
+struct Rect
+{
+  int x1, y1, x2, y2; // inclusive
+};
+
+struct ConnectorRoute
+{
+  int32_t descriptor[CONNECTOR_FIELDS];
+  std::vector<int32_t> path;
+  Rect explored;
+  bool cached = false;
+  // Changes whenever path does and is never the same for two routers, 0 until routed. See ConnectorMesh.
+  uint32_t revision = 0;
+};
+
+// Route found by a worker against the grid as it was when its round started
+struct SpeculativeRoute
+{
+  bool valid = false;
+  // Gave up at the node limit
+  bool truncated = false;
+  std::vector<int32_t> path;
+  Rect explored;
+  // Cells whose 3x3 neighbourhood the search read, one bit per cell of the box readCells. The box
+  // is in cell indices, x the column and y the row of the grid including its border.
+  Rect readCells;
+  std::vector<uint64_t> readBits;
+  // Commits before this one are known to have left the read cells alone
+  size_t checkedCommits = 0;
+  // Speculations for the connector thrown away so far
+  int conflicts = 0;
+};
+
+// Cells one commit left different from the snapshot of its round, the change log up to logEnd
+struct CommitChanges
+{
+  size_t logEnd;
+  Rect cells;
+};
+
+// Scratch of one pool worker, its own copy of the grid to clear anchor rects in
+struct RouterWorker
+{
+  std::unique_ptr<Pathfinding> grid;
+  PathSearch search;
+  HierarchySearch hierarchySearch;
+  bool synced = false;
+  // Entries of the change log already applied to grid
+  size_t logPosition = 0;
+};
+
+// Routes every connector in order the way the Engine does: clear both anchor rects, find the path,
+// mark it with CONNECTOR_PATH_WEIGHT and block the anchor rects again. Routes are cached between
+// calls and a connector is only searched again when a cell its last search read may have changed.
+// This holds in PATHFINDING_HIERARCHICAL mode too, because an updated Hierarchy routes exactly like
+// a fresh one (see Hierarchy::renumberNodes).
+//
+// With more than one thread connectors are routed in rounds. A round searches the next connectors
+// that need it concurrently, each against a copy of the grid as the round found it, then commits
+// them in order until one read a cell a connector committed after its search changed. That one and
+// the ones after it are left to the next round, which starts from the grid with everything before
+// them marked and searches again every speculation an earlier commit invalidated. Its first search
+// is therefore exact, and the results are the same as the sequential order for any thread count.
+class Router
+{
+public:
+  Router(Pathfinding *pathfinding);
+
+  ~Router(void);
+
+  // Routes count connectors from descriptors() with a PATHFINDING_* mode. The grid is expected to
+  // hold the entity rects only, it is left with the connector paths and anchor rects marked. With
+  // full every connector is searched again. Returns the number of connectors that were searched.
+  int route(int count, int mode, bool full);
+
+  int32_t *descriptors(int count);
+
+  // Worker threads for route(), 1 routes everything on the calling thread
+  void setThreads(int threads);
+
+  // Speculative searches the last route() threw away because an earlier connector changed a cell
+  // they read or they hit the node limit. Each cost a second search.
+  int conflicts(void) const { return conflictCount; }
+
+  // For each connector its offset (in x,y pairs) and length, then all the paths as x,y pairs
+  int32_t *output(void) { return packed.data(); }
+
+  // Routes of the last route(), one per connector
+  const std::vector<ConnectorRoute> &connectorRoutes(void) const { return routes; }
+  const Pathfinding &grid(void) const { return *pathfinding; }
+
+  // Frees the workers' grid copies and the search scratch, which the next route() allocates again.
+  // Cached routes stay. Runs as the pathfinding evictor when it goes over its memory budget.
+  void releaseScratch(void);
+
+private:
+  static void evict_router_scratch(void *owner, int64_t excess);
+
+  void diffBase(void);
+  void addDirty(const Rect &rect);
+  bool intersectsDirty(const Rect &rect) const;
+  Rect pathBounds(const std::vector<int32_t> &path) const;
+  Rect descriptorRect(const int32_t *descriptor, int offset) const;
+  void fillDescriptorRect(const int32_t *descriptor, int offset, uint8_t weight);
+  void restoreDescriptorRect(Pathfinding &grid, const int32_t *descriptor, int offset) const;
+  bool needsSearch(const ConnectorRoute &route, const int32_t *descriptor, bool full) const;
+  void findRoute(const Pathfinding &grid, const int32_t *descriptor, int mode, PathSearch &search, HierarchySearch &scratch) const;
+  int commit(int i, int mode, bool full, const SpeculativeRoute *speculated);
+  int routeParallel(int count, int mode, bool full);
+  void startRound(void);
+  void speculate(int count, int next, int window, int mode, bool full);
+  void syncWorker(RouterWorker &worker) const;
+  bool readsChanged(SpeculativeRoute &speculated);
+  void markChanged(int32_t cell);
+  void markChangedRect(const int32_t *descriptor, int offset);
+  void pack(int count);
+
+  Pathfinding *pathfinding;
+  PathSearch search;
+  HierarchySearch hierarchySearch;
+  // Built from the base grid on the first hierarchical route()
+  std::unique_ptr<Hierarchy> hierarchy;
+  std::unique_ptr<ThreadPool> pool;
+  std::vector<RouterWorker> workers;
+  std::vector<SpeculativeRoute> speculative;
+  std::vector<int32_t> candidates;
+  int conflictCount = 0;
+
+  // Grid as the current round started. Every cell a commit of this route() left different from the
+  // snapshot is logged, the ones up to snapshotPosition are in it.
+  std::vector<uint8_t> snapshot;
+  std::vector<int32_t> changeLog;
+  std::vector<CommitChanges> commits;
+  size_t snapshotPosition = 0;
+  std::vector<int32_t> input;
+  std::vector<ConnectorRoute> routes;
+  std::vector<int32_t> packed;
+
+  // Grid before any connector was routed, as of the last call
+  std::vector<uint8_t> previousBase;
+  std::vector<Rect> dirty;
+};
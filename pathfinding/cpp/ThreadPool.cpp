@@ -0,0 +1,85 @@
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+#ifdef THREAD_POOL_INLINE
+  threadCount = 1;
+#endif
+  workerCount = threadCount < 1 ? 1 : threadCount;
+  next = 0;
+  for (int worker = 1; worker < workerCount; worker++)
+    threads.emplace_back(&ThreadPool::work, this, worker);
+}
+
+ThreadPool::~ThreadPool(void)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+void ThreadPool::drain(int worker)
+{
+  int index;
+  while ((index = next.fetch_add(1)) < count)
+    (*task)(index, worker);
+}
+
+void ThreadPool::work(int worker)
+{
+  unsigned seen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+
+    drain(worker);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      busy--;
+    }
+    finished.notify_one();
+  }
+}
+
+void ThreadPool::run(int taskCount, const std::function<void(int, int)> &taskFunction)
+{
+  if (workerCount == 1 || taskCount <= 1)
+  {
+    for (int index = 0; index < taskCount; index++)
+      taskFunction(index, 0);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    task = &taskFunction;
+    count = taskCount;
+    next = 0;
+    busy = workerCount - 1;
+    generation++;
+  }
+  wake.notify_all();
+
+  drain(0);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return busy == 0; });
+  task = nullptr;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Emscripten only has threads when built with -s USE_PTHREADS=1, run everything inline otherwise
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define THREAD_POOL_INLINE 1
+#endif
+
+// Fixed set of workers for data parallel loops. The calling thread takes part as worker 0.
+class ThreadPool
+{
+public:
+  ThreadPool(int threads);
+  ~ThreadPool(void);
+
+  int size(void) const { return workerCount; }
+
+  // Calls task(index, worker) for every index in [0, count) and returns once all of them are done.
+  // Indices are handed out dynamically, a worker is always in [0, size()).
+  void run(int count, const std::function<void(int, int)> &task);
+
+private:
+  void work(int worker);
+  void drain(int worker);
+
+  int workerCount;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+
+  const std::function<void(int, int)> *task = nullptr;
+  std::atomic<int> next;
+  int count = 0;
+  int busy = 0;
+  unsigned generation = 0;
+  bool stopping = false;
+};
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <emscripten.h>
+#include "Pathfinding.cpp"
+#include "Hierarchy.cpp"
+#include "ThreadPool.cpp"
+#include "Router.cpp"
+#include "Polyline.cpp"
+#include "ConnectorMesh.cpp"
+#include "../../common/cpp/memory_accounting.cpp"
+#include "../../common/cpp/tracking_allocator.cpp"
+
+PathSearch search;
+HierarchySearch hierarchySearch;
+
+// Last path as x,y pairs, read by JS through an Int32Array view
+std::vector<int32_t> pathOutput;
+
+static int write_path(const Pathfinding *pathfinding, int length)
+{
+  pathOutput.resize(length * 2 + 2);
+  for (int i = 0; i < length; i++)
+  {
+    pathOutput[i * 2] = pathfinding->cellX(search.path[i]);
+    pathOutput[i * 2 + 1] = pathfinding->cellY(search.path[i]);
+  }
+  return length;
+}
+
+int main()
+{
+  printf("[WASM] Loaded\n");
+  memory_set_default_subsystem(MEMORY_PATHFINDING);
+
+  EM_ASM(
+      if (typeof window != "undefined") {
+        window.dispatchEvent(new CustomEvent("wasmLoaded"))
+      } else {
+          global.onWASMLoaded && global.onWASMLoaded()});
+
+  return 0;
+}
+
+extern "C"
+{
+  EMSCRIPTEN_KEEPALIVE
+  Pathfinding *createPathfinding(int worldWidth, int worldHeight)
+  {
+    return new Pathfinding(worldWidth, worldHeight);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void destroyPathfinding(Pathfinding *pathfinding)
+  {
+    delete pathfinding;
+  }
+
+  // Grid of cell weights, (worldWidth + 2) x (worldHeight + 2) bytes, row by row with a one cell border
+  EMSCRIPTEN_KEEPALIVE
+  uint8_t *pathfindingCells(Pathfinding *pathfinding)
+  {
+    return pathfinding->cells();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int pathfindingStride(Pathfinding *pathfinding)
+  {
+    return pathfinding->stride;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int32_t *pathfindingOutput()
+  {
+    return pathOutput.data();
+  }
+
+  // Returns the number of cells in the path, written to pathfindingOutput() as x,y pairs
+  EMSCRIPTEN_KEEPALIVE
+  int findPath(Pathfinding *pathfinding, int startX, int startY, int endX, int endY, int jumpPoints)
+  {
+    int length = pathfinding->findPath(startX, startY, endX, endY, jumpPoints != 0, search);
+    return write_path(pathfinding, length);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  Hierarchy *createHierarchy(Pathfinding *pathfinding)
+  {
+    return new Hierarchy(pathfinding);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void destroyHierarchy(Hierarchy *hierarchy)
+  {
+    delete hierarchy;
+  }
+
+  // Call after changing cells and before findHierarchicalPath, returns the number of clusters rebuilt
+  EMSCRIPTEN_KEEPALIVE
+  int updateHierarchy(Hierarchy *hierarchy)
+  {
+    return hierarchy->update();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int hierarchyMemory(Hierarchy *hierarchy)
+  {
+    return hierarchy->memoryUsage();
+  }
+
+  // Same output as findPath
+  EMSCRIPTEN_KEEPALIVE
+  int findHierarchicalPath(Hierarchy *hierarchy, int startX, int startY, int endX, int endY)
+  {
+    int length = hierarchy->findPath(*hierarchy->pathfinding, startX, startY, endX, endY, search, hierarchySearch);
+    return write_path(hierarchy->pathfinding, length);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  Router *createRouter(Pathfinding *pathfinding)
+  {
+    return new Router(pathfinding);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void destroyRouter(Router *router)
+  {
+    delete router;
+  }
+
+  // Room for count connector descriptors of CONNECTOR_FIELDS int32 each
+  EMSCRIPTEN_KEEPALIVE
+  int32_t *routerDescriptors(Router *router, int count)
+  {
+    return router->descriptors(count);
+  }
+
+  // Routes the connectors written to routerDescriptors() with a PATHFINDING_* mode, reusing the
+  // cached routes that cannot have changed. Returns how many connectors were searched.
+  EMSCRIPTEN_KEEPALIVE
+  int routeConnectors(Router *router, int count, int mode, int full)
+  {
+    int searched = router->route(count, mode, full != 0);
+    memory_enforce_budgets();
+    return searched;
+  }
+
+  // Threads routeConnectors() spreads the searches over, only used in a -s USE_PTHREADS=1 build
+  EMSCRIPTEN_KEEPALIVE
+  void setRouterThreads(Router *router, int threads)
+  {
+    router->setThreads(threads);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int routerConflicts(Router *router)
+  {
+    return router->conflicts();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int32_t *routerOutput(Router *router)
+  {
+    return router->output();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  ConnectorMesh *createConnectorMesh(void)
+  {
+    return new ConnectorMesh();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void destroyConnectorMesh(ConnectorMesh *mesh)
+  {
+    delete mesh;
+  }
+
+  // Tessellates the strokes of the router's connectors into the mesh, only the ones whose route changed
+  // unless the style did. width is in tiles, join and cap are POLYLINE_JOIN_* and POLYLINE_CAP_*, see
+  // PolylineStyle. Returns how many connectors were tessellated.
+  EMSCRIPTEN_KEEPALIVE
+  int updateConnectorMesh(ConnectorMesh *mesh, Router *router, float width, int join, int cap, float miterLimit, float tolerance)
+  {
+    PolylineStyle style;
+    style.width = width;
+    style.join = join;
+    style.cap = cap;
+    style.miterLimit = miterLimit;
+    style.tolerance = tolerance;
+    return mesh->update(*router, style);
+  }
+
+  // x,y float pairs of connectorMeshCapacity() vertices, the first connectorMeshVertexCount() drawn as triangles
+  EMSCRIPTEN_KEEPALIVE
+  const float *connectorMeshVertices(ConnectorMesh *mesh)
+  {
+    return mesh->vertices();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int connectorMeshVertexCount(ConnectorMesh *mesh)
+  {
+    return mesh->vertexCount();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int connectorMeshCapacity(ConnectorMesh *mesh)
+  {
+    return mesh->capacity();
+  }
+
+  // Vertex ranges the last updateConnectorMesh() wrote, as first, count int32 pairs
+  EMSCRIPTEN_KEEPALIVE
+  const int32_t *connectorMeshDirtyRanges(ConnectorMesh *mesh)
+  {
+    return mesh->dirtyRanges();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int connectorMeshDirtyRangeCount(ConnectorMesh *mesh)
+  {
+    return mesh->dirtyRangeCount();
+  }
+
+  // Bytes to allocate for the memory statistics, see memoryStats in memory_accounting.h for the layout
+  EMSCRIPTEN_KEEPALIVE
+  int memoryStatisticsSize(void)
+  {
+    return sizeof(memoryStats);
+  }
+
+  // Heap use of this module, all of it under MEMORY_PATHFINDING, into a memoryStatisticsSize() buffer
+  EMSCRIPTEN_KEEPALIVE
+  void memoryStatistics(memoryStats *out)
+  {
+    memory_stats(*out);
+  }
+
+  // Soft budget in bytes for a memorySubsystem, 0 for none. Going over MEMORY_PATHFINDING's frees the
+  // routers' search scratch after routing.
+  EMSCRIPTEN_KEEPALIVE
+  void setMemoryBudget(int subsystem, double bytes)
+  {
+    memory_set_budget(subsystem, (int64_t)bytes);
+    memory_enforce_budgets();
+  }
+}
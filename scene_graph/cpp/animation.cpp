@@ -0,0 +1,239 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "animation.h"
+
+// GCC and Clang vector extensions, wasm SIMD with -msimd128 and SSE natively
+typedef float float4 __attribute__((vector_size(16)));
+typedef int32_t int4 __attribute__((vector_size(16)));
+
+static inline float4 select4(int4 mask, float4 a, float4 b)
+{
+  return (float4)(((int4)a & mask) | ((int4)b & ~mask));
+}
+
+static inline float4 clamp01(float4 x)
+{
+  const float4 zero = {0, 0, 0, 0};
+  const float4 one = {1, 1, 1, 1};
+  x = select4(x > zero, x, zero);
+  return select4(x < one, x, one);
+}
+
+// sin and cos of four angles in degrees. The angle is reduced to [-45, 45] degrees around the nearest
+// even octant, exactly as it is in degrees, and the two minimax polynomials of Cephes' sinf and cosf
+// are swapped and signed by octant.
+static inline void sincos4(float4 degrees, float4 &sines, float4 &cosines)
+{
+  int4 sign = (int4)degrees & (int32_t)0x80000000;
+  float4 x = (float4)((int4)degrees & 0x7FFFFFFF);
+
+  int4 octant = __builtin_convertvector(x * (1.0f / 45), int4);
+  octant = (octant + 1) & ~1;
+  float4 r = (x - __builtin_convertvector(octant, float4) * 45.0f) * 0.017453292519943295f;
+
+  int4 sinSign = sign ^ ((octant & 4) << 29);
+  int4 cosSign = (~(octant - 2) & 4) << 29;
+  int4 sinPolynomial = (octant & 2) == 0;
+
+  float4 z = r * r;
+  float4 c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+  float4 s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+
+  sines = (float4)((int4)select4(sinPolynomial, s, c) ^ sinSign);
+  cosines = (float4)((int4)select4(sinPolynomial, c, s) ^ cosSign);
+}
+
+void animation_sincos(const float *degrees, float *sines, float *cosines, int count)
+{
+  int n = 0;
+  for (; n + 4 <= count; n += 4)
+  {
+    float4 angles, s, c;
+    memcpy(&angles, degrees + n, sizeof(angles));
+    sincos4(angles, s, c);
+    memcpy(sines + n, &s, sizeof(s));
+    memcpy(cosines + n, &c, sizeof(c));
+  }
+  if (n < count)
+  {
+    float4 angles = {0, 0, 0, 0}, s, c;
+    for (int lane = 0; n + lane < count; lane++)
+      angles[lane] = degrees[n + lane];
+    sincos4(angles, s, c);
+    for (int lane = 0; n + lane < count; lane++)
+    {
+      sines[n + lane] = s[lane];
+      cosines[n + lane] = c[lane];
+    }
+  }
+}
+
+// Rewrites the key arrays with only the live tracks' keys, in track order
+static void compact_keys(animationCurves &curves)
+{
+  const int components = curves.components;
+  std::vector<float> times, easing, values;
+  times.reserve(curves.keyTimes.size() - curves.deadKeys);
+  easing.reserve(times.capacity());
+  values.reserve(times.capacity() * components);
+  for (animationTrack &track : curves.tracks.values)
+  {
+    uint32_t first = track.firstKey;
+    track.firstKey = times.size();
+    times.insert(times.end(), &curves.keyTimes[first], &curves.keyTimes[first] + track.keyCount);
+    easing.insert(easing.end(), &curves.keyEasing[first], &curves.keyEasing[first] + track.keyCount);
+    values.insert(values.end(), &curves.keyValues[first * components], &curves.keyValues[first * components] + track.keyCount * components);
+  }
+  curves.keyTimes.swap(times);
+  curves.keyEasing.swap(easing);
+  curves.keyValues.swap(values);
+  curves.deadKeys = 0;
+}
+
+bool animation_set(animationCurves &curves, uint32_t slot, const float *keys, int keyCount, double start, bool loop)
+{
+  const int components = curves.components;
+  const int stride = 2 + components;
+  if (keyCount < 1 || keyCount > ANIMATION_MAX_KEYS)
+    return false;
+  for (int k = 0; k < keyCount; k++)
+  {
+    float time = keys[k * stride];
+    if (!(time >= 0) || (k > 0 && time < keys[(k - 1) * stride]))
+      return false;
+  }
+
+  animation_remove(curves, slot);
+  animationTrack track = {
+      .firstKey = (uint32_t)curves.keyTimes.size(),
+      .keyCount = (uint32_t)keyCount,
+      .cursor = 0,
+      .duration = keys[(keyCount - 1) * stride],
+      .loop = loop,
+      .start = start,
+  };
+  for (int k = 0; k < keyCount; k++)
+  {
+    const float *key = keys + k * stride;
+    curves.keyTimes.push_back(key[0]);
+    curves.keyEasing.push_back(key[1] == EASE_CUBIC ? 1 : 0);
+    curves.keyValues.insert(curves.keyValues.end(), key + 2, key + stride);
+  }
+  curves.tracks.insert(slot, track);
+  if (!loop)
+    curves.nextEnd = std::min(curves.nextEnd, start + track.duration);
+  return true;
+}
+
+void animation_remove(animationCurves &curves, uint32_t slot)
+{
+  animationTrack *track = curves.tracks.find(slot);
+  if (!track)
+    return;
+  curves.deadKeys += track->keyCount;
+  curves.tracks.remove(slot);
+  if (curves.deadKeys * 2 > curves.keyTimes.size())
+    compact_keys(curves);
+}
+
+// Time on the track's curve. A looping track moves its start up by whole repeats once the clock
+// passes its end, so it only divides once per repeat.
+static inline float track_time(animationTrack &track, double time)
+{
+  double local = time - track.start;
+  if (track.loop && track.duration > 0 && (local >= track.duration || local < 0))
+  {
+    track.start += floor(local / track.duration) * track.duration;
+    local = time - track.start;
+  }
+  return (float)local;
+}
+
+void animation_evaluate(animationCurves &curves, double time)
+{
+  const int components = curves.components;
+  const uint32_t count = curves.tracks.size();
+  curves.output.resize((size_t)count * components);
+  const float *keyTimes = curves.keyTimes.data();
+  const float *keyEasing = curves.keyEasing.data();
+  const float *keyValues = curves.keyValues.data();
+  float *output = curves.output.data();
+
+  for (uint32_t n = 0; n < count; n += 4)
+  {
+    // Finding the segment is scalar, spare lanes repeat the last track and are not stored
+    uint32_t lanes = count - n < 4 ? count - n : 4;
+    float laneTime[4], laneFrom[4], laneTo[4], laneEasing[4];
+    uint32_t from[4], to[4];
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+      animationTrack &track = curves.tracks.values[n + (lane < lanes ? lane : lanes - 1)];
+      float local = track_time(track, time);
+      uint32_t cursor = track.cursor;
+      if (local < keyTimes[track.firstKey + cursor])
+        cursor = 0;
+      while (cursor + 1 < track.keyCount && local >= keyTimes[track.firstKey + cursor + 1])
+        cursor++;
+      track.cursor = cursor;
+
+      from[lane] = track.firstKey + cursor;
+      to[lane] = cursor + 1 < track.keyCount ? from[lane] + 1 : from[lane];
+      laneTime[lane] = local;
+      laneFrom[lane] = keyTimes[from[lane]];
+      laneTo[lane] = keyTimes[to[lane]];
+      laneEasing[lane] = keyEasing[from[lane]];
+    }
+    float4 t, t0, t1, easing;
+    memcpy(&t, laneTime, sizeof(t));
+    memcpy(&t0, laneFrom, sizeof(t0));
+    memcpy(&t1, laneTo, sizeof(t1));
+    memcpy(&easing, laneEasing, sizeof(easing));
+
+    // Position in the segment, eased, the same for every component
+    const float4 one = {1, 1, 1, 1};
+    float4 span = t1 - t0;
+    float4 u = clamp01((t - t0) / select4(span > 0, span, one));
+    float4 blend = u + (u * u * (3.0f - 2.0f * u) - u) * easing;
+
+    for (int c = 0; c < components; c++)
+    {
+      float laneValues[2][4];
+      for (uint32_t lane = 0; lane < 4; lane++)
+      {
+        laneValues[0][lane] = keyValues[from[lane] * components + c];
+        laneValues[1][lane] = keyValues[to[lane] * components + c];
+      }
+      float4 v0, v1;
+      memcpy(&v0, laneValues[0], sizeof(v0));
+      memcpy(&v1, laneValues[1], sizeof(v1));
+      float4 value = v0 + (v1 - v0) * blend;
+      for (uint32_t lane = 0; lane < lanes; lane++)
+        output[(n + lane) * components + c] = value[lane];
+    }
+  }
+}
+
+int animation_retire(animationCurves &curves, double time)
+{
+  if (time < curves.nextEnd)
+    return 0;
+
+  // Backwards, removing swaps in a track that was already checked
+  int retired = 0;
+  curves.nextEnd = INFINITY;
+  for (uint32_t n = curves.tracks.size(); n-- > 0;)
+  {
+    const animationTrack &track = curves.tracks.values[n];
+    if (track.loop)
+      continue;
+    if (time - track.start >= track.duration)
+    {
+      animation_remove(curves, curves.tracks.slots[n]);
+      retired++;
+    }
+    else
+      curves.nextEnd = std::min(curves.nextEnd, track.start + track.duration);
+  }
+  return retired;
+}
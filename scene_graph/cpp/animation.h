@@ -0,0 +1,80 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "object_store.h"
+
+// Longest curve a track takes, one command has to fit the command buffer
+#define ANIMATION_MAX_KEYS 64
+
+// Animated properties, values per key in brackets:
+//   ANIMATE_TRANSLATION  [x, y]
+//   ANIMATE_ROTATION     [angle in degrees]
+//   ANIMATE_SCALE        [x, y]
+//   ANIMATE_COLOR        [r, g, b, a]
+enum animationChannel
+{
+  ANIMATE_TRANSLATION = 0,
+  ANIMATE_ROTATION = 1,
+  ANIMATE_SCALE = 2,
+  ANIMATE_COLOR = 3,
+  ANIMATION_CHANNELS = 4,
+};
+
+static const int animationComponents[ANIMATION_CHANNELS] = {2, 1, 2, 4};
+
+// Easing of the segment that starts at a key
+enum animationEasing
+{
+  EASE_LINEAR = 0,
+  // Ease in and out, 3u^2 - 2u^3
+  EASE_CUBIC = 1,
+};
+
+// One object's curve on a channel, its keys are keyCount consecutive entries of the key arrays
+struct animationTrack
+{
+  uint32_t firstKey;
+  uint32_t keyCount;
+  // Segment the last evaluation was in, time mostly moves forward
+  uint32_t cursor;
+  // Time of the last key
+  float duration;
+  bool loop;
+  // Clock time of the first key
+  double start;
+};
+
+// Every track of one channel, by object slot. Keys of all tracks are packed into shared arrays and
+// evaluation writes the values of all tracks to output, components of track n at n * components.
+struct animationCurves
+{
+  int components;
+  componentPool<animationTrack> tracks;
+  // Key time in milliseconds from the track start, easing as 0 or 1 for branch-free blending
+  std::vector<float> keyTimes;
+  std::vector<float> keyEasing;
+  std::vector<float> keyValues;
+  // Keys of removed or replaced tracks, compacted away once they are half of the arrays
+  uint32_t deadKeys = 0;
+  // No track that doesn't loop ends before this clock time, retiring skips the tracks until then
+  double nextEnd = INFINITY;
+  std::vector<float> output;
+};
+
+// Sets the curve of slot's object, replacing its previous one. keys holds keyCount keys of time (ms
+// after start, ascending), easing and the channel's values. False for a curve out of range or order.
+bool animation_set(animationCurves &curves, uint32_t slot, const float *keys, int keyCount, double start, bool loop);
+
+void animation_remove(animationCurves &curves, uint32_t slot);
+
+// Values of every track at clock time into output. Looping tracks repeat their curve, the others hold
+// their first value before it and their last one after it. Runs over four tracks at a time in SIMD.
+void animation_evaluate(animationCurves &curves, double time);
+
+// Removes the tracks that don't loop and ended by time, returns how many
+int animation_retire(animationCurves &curves, double time);
+
+// Sines and cosines of count angles in degrees, four at a time. The angles are reduced exactly in
+// degrees, the error stays below 1e-7 up to at least 1e7 degrees.
+void animation_sincos(const float *degrees, float *sines, float *cosines, int count);
@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <emscripten.h>
+#include "draw_order.h"
+#include "raster.h"
+#include "picking.h"
+#include "object_store.h"
+#include "animation.h"
+#include "webgl.h"
+#include "snapshot.h"
+#include "../../common/cpp/memory_accounting.h"
+
+// Benchmarks are compiled in with -DENABLE_BENCHMARKS and called from the console, e.g.
+// Module.ccall("benchDrawOrder", null, ["number"], [100000])
+
+struct benchDraw
+{
+  uint32_t layer;
+  int translucent;
+  float depth;
+  uint32_t program;
+  uint32_t texture;
+  uint32_t mesh;
+};
+
+struct benchTransform
+{
+  float translation[2];
+  float rotation[2];
+  float scale[2];
+};
+
+// Per-frame pass over a transform pool, what the draw list build reads
+static float transform_pass(const componentPool<benchTransform> &transforms)
+{
+  float sum = 0;
+  for (const benchTransform &transform : transforms.values)
+    sum += transform.translation[0] * transform.scale[0] + transform.translation[1] * transform.scale[1] + transform.rotation[1];
+  return sum;
+}
+
+static double time_transform_pass(const componentPool<benchTransform> &transforms, float *sum)
+{
+  const int runs = 20;
+  double start = emscripten_get_now();
+  for (int run = 0; run < runs; run++)
+    *sum += transform_pass(transforms);
+  return (emscripten_get_now() - start) / runs;
+}
+
+// Appends every element of array to out, what a snapshot without sharing copies. Returns the bytes.
+template <typename T>
+static size_t deep_copy(const chunkedArray<T> &array, std::vector<T> &out)
+{
+  size_t offset = out.size();
+  out.resize(offset + array.size());
+  for (size_t n = 0; n < array.size(); n++)
+    out[offset + n] = array[n];
+  return array.size() * sizeof(T);
+}
+
+// Heap bytes charged to the scene
+static double scene_heap_bytes()
+{
+  memoryStats stats;
+  memory_stats(stats);
+  return stats.subsystems[MEMORY_SCENE].heap.current;
+}
+
+// A curve's value at local time in double precision, the way animation_evaluate defines it
+static double reference_curve(const float *keys, int keyCount, int stride, int component, double local)
+{
+  if (local <= keys[0])
+    return keys[2 + component];
+  for (int k = 0; k + 1 < keyCount; k++)
+  {
+    const float *from = keys + k * stride, *to = from + stride;
+    if (local < to[0])
+    {
+      double u = (local - from[0]) / (to[0] - from[0]);
+      if (from[1] == EASE_CUBIC)
+        u = u * u * (3 - 2 * u);
+      return from[2 + component] + (to[2 + component] - from[2 + component]) * u;
+    }
+  }
+  return keys[(keyCount - 1) * stride + 2 + component];
+}
+
+static int count_state_changes(const std::vector<benchDraw> &draws, const uint32_t *order)
+{
+  int changes = 0;
+  uint32_t program = -1, texture = -1, mesh = -1;
+  for (size_t n = 0; n < draws.size(); n++)
+  {
+    const benchDraw &draw = draws[order[n]];
+    changes += draw.program != program;
+    changes += draw.texture != texture;
+    changes += draw.mesh != mesh;
+    program = draw.program;
+    texture = draw.texture;
+    mesh = draw.mesh;
+  }
+  return changes;
+}
+
+extern "C"
+{
+  EMSCRIPTEN_KEEPALIVE
+  void benchDrawOrder(int count)
+  {
+    srand(1);
+    std::vector<benchDraw> draws(count);
+    for (int i = 0; i < count; i++)
+    {
+      draws[i] = {
+          .layer = (uint32_t)(rand() % 4),
+          .translucent = rand() % 10 == 0,
+          // A 2D scene has few distinct depths, most draws share one
+          .depth = (rand() % 8) / 8.0f,
+          .program = (uint32_t)(rand() % 8),
+          .texture = (uint32_t)(rand() % 64),
+          .mesh = (uint32_t)(rand() % 4),
+      };
+    }
+
+    std::vector<uint64_t> keys(count), keysScratch(count), sortedKeys(count);
+    std::vector<uint32_t> order(count), orderScratch(count), identity(count);
+    for (int i = 0; i < count; i++)
+    {
+      keys[i] = make_sort_key(draws[i].layer, draws[i].translucent, draws[i].depth, draws[i].program, draws[i].texture, draws[i].mesh);
+      identity[i] = i;
+    }
+
+    const int runs = 20;
+    double radixTime = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      std::copy(keys.begin(), keys.end(), sortedKeys.begin());
+      std::copy(identity.begin(), identity.end(), order.begin());
+      double start = emscripten_get_now();
+      radix_sort_keys(sortedKeys.data(), order.data(), keysScratch.data(), orderScratch.data(), count);
+      radixTime += emscripten_get_now() - start;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+    double comparisonTime = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      for (int i = 0; i < count; i++)
+        pairs[i] = {keys[i], (uint32_t)i};
+      double start = emscripten_get_now();
+      std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b) { return a.first < b.first; });
+      comparisonTime += emscripten_get_now() - start;
+    }
+
+    int unsortedChanges = count_state_changes(draws, identity.data());
+    int sortedChanges = count_state_changes(draws, order.data());
+
+    printf("[BENCH] draw order, %d draws\n", count);
+    printf("[BENCH]   radix sort      %.3f ms\n", radixTime / runs);
+    printf("[BENCH]   std::stable_sort %.3f ms\n", comparisonTime / runs);
+    printf("[BENCH]   state changes   %d unsorted, %d sorted (%d saved)\n", unsortedChanges, sortedChanges, unsortedChanges - sortedChanges);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void benchSoftwareRaster(int count, int width, int height, int threads)
+  {
+    // Synthetic rectangles, more than the demo scene has
+    static const float rectangle[12] = {1, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 1};
+    srand(1);
+    std::vector<rasterDraw> draws(count);
+    for (int i = 0; i < count; i++)
+    {
+      float angle = (rand() % 360) * 3.14159265f / 180;
+      float scaleX = 4 + rand() % 60;
+      float scaleY = 4 + rand() % 60;
+      rasterDraw &draw = draws[i];
+      draw.vertices = rectangle;
+      draw.vertexCount = 6;
+      draw.matrix[0] = cosf(angle) * scaleX;
+      draw.matrix[1] = -sinf(angle) * scaleX;
+      draw.matrix[2] = 0;
+      draw.matrix[3] = sinf(angle) * scaleY;
+      draw.matrix[4] = cosf(angle) * scaleY;
+      draw.matrix[5] = 0;
+      draw.matrix[6] = rand() % width;
+      draw.matrix[7] = rand() % height;
+      draw.matrix[8] = 1;
+      for (int c = 0; c < 3; c++)
+        draw.color[c] = rand() % 256;
+      draw.color[3] = 255;
+      draw.id = i + 1;
+    }
+
+    std::vector<uint8_t> color((size_t)width * height * 4), reference((size_t)width * height * 4);
+    std::vector<uint32_t> ids((size_t)width * height), referenceIds((size_t)width * height);
+    const uint8_t clear[4] = {0, 0, 0, 0};
+    rasterTarget referenceTarget = {width, height, reference.data(), referenceIds.data()};
+    rasterTarget target = {width, height, color.data(), ids.data()};
+
+    const int runs = 10;
+    double singleTime = 0, threadedTime = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      double start = emscripten_get_now();
+      raster_draws(draws.data(), count, width, height, clear, true, 1, referenceTarget);
+      singleTime += emscripten_get_now() - start;
+      start = emscripten_get_now();
+      raster_draws(draws.data(), count, width, height, clear, true, threads, target);
+      threadedTime += emscripten_get_now() - start;
+    }
+    bool identical = color == reference && ids == referenceIds;
+
+    std::vector<uint8_t> png;
+    double start = emscripten_get_now();
+    raster_encode_png(color.data(), width, height, png);
+    double pngTime = emscripten_get_now() - start;
+
+    printf("[BENCH] software raster, %d draws at %dx%d\n", count, width, height);
+    printf("[BENCH]   1 thread        %.3f ms\n", singleTime / runs);
+    printf("[BENCH]   %d threads       %.3f ms (%s)\n", threads, threadedTime / runs, identical ? "identical" : "DIFFERENT");
+    printf("[BENCH]   png             %.3f ms, %d bytes\n", pngTime, (int)png.size());
+  }
+
+  // Marquee selection over count synthetic objects: the distinct IDs of a picking target region, as
+  // the GPU pass leaves them, against testing every object's bounds. The target comes from the
+  // software rasterizer, which writes the same draw IDs.
+  EMSCRIPTEN_KEEPALIVE
+  void benchMarquee(int count, int width, int height)
+  {
+    static const float rectangle[12] = {1, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 1};
+    srand(1);
+    std::vector<rasterDraw> draws(count);
+    for (int i = 0; i < count; i++)
+    {
+      float angle = (rand() % 360) * 3.14159265f / 180;
+      float scaleX = 2 + rand() % 12;
+      float scaleY = 2 + rand() % 12;
+      rasterDraw &draw = draws[i];
+      draw.vertices = rectangle;
+      draw.vertexCount = 6;
+      draw.matrix[0] = cosf(angle) * scaleX;
+      draw.matrix[1] = -sinf(angle) * scaleX;
+      draw.matrix[2] = 0;
+      draw.matrix[3] = sinf(angle) * scaleY;
+      draw.matrix[4] = cosf(angle) * scaleY;
+      draw.matrix[5] = 0;
+      draw.matrix[6] = rand() % width;
+      draw.matrix[7] = rand() % height;
+      draw.matrix[8] = 1;
+      draw.color[0] = draw.color[1] = draw.color[2] = draw.color[3] = 255;
+      draw.id = i + 1;
+    }
+
+    std::vector<uint8_t> color((size_t)width * height * 4);
+    std::vector<uint32_t> ids((size_t)width * height);
+    const uint8_t clear[4] = {0, 0, 0, 0};
+    rasterTarget target = {width, height, color.data(), ids.data()};
+    raster_draws(draws.data(), count, width, height, clear, true, 1, target);
+
+    // A quarter of the canvas
+    int x1 = width / 4, y1 = height / 4, x2 = x1 + width / 2, y2 = y1 + height / 2;
+    std::vector<uint32_t> region((size_t)(x2 - x1) * (y2 - y1));
+    for (int y = y1; y < y2; y++)
+      std::copy(&ids[(size_t)y * width + x1], &ids[(size_t)y * width + x2], &region[(size_t)(y - y1) * (x2 - x1)]);
+
+    const int runs = 20;
+    std::vector<uint32_t> picked;
+    double pickTime = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      picked.clear();
+      double start = emscripten_get_now();
+      pick_collect_ids(region.data(), x2 - x1, y2 - y1, 1, count + 1, picked);
+      pickTime += emscripten_get_now() - start;
+    }
+
+    // Bounds of every object against the marquee, which also takes the hidden ones
+    int boundsHits = 0;
+    double boundsTime = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      boundsHits = 0;
+      double start = emscripten_get_now();
+      for (const rasterDraw &draw : draws)
+      {
+        float minX = 0, minY = 0, maxX = 0, maxY = 0;
+        for (int v = 0; v < draw.vertexCount; v++)
+        {
+          float x = draw.matrix[0] * draw.vertices[v * 2] + draw.matrix[3] * draw.vertices[v * 2 + 1] + draw.matrix[6];
+          float y = draw.matrix[1] * draw.vertices[v * 2] + draw.matrix[4] * draw.vertices[v * 2 + 1] + draw.matrix[7];
+          minX = v == 0 || x < minX ? x : minX;
+          minY = v == 0 || y < minY ? y : minY;
+          maxX = v == 0 || x > maxX ? x : maxX;
+          maxY = v == 0 || y > maxY ? y : maxY;
+        }
+        boundsHits += minX < x2 && maxX > x1 && minY < y2 && maxY > y1;
+      }
+      boundsTime += emscripten_get_now() - start;
+    }
+
+    // The same region in RGBA8 fallback encoding
+    std::vector<uint8_t> bytes(region.size() * 4);
+    for (size_t n = 0; n < region.size(); n++)
+    {
+      float rgba[4];
+      pick_encode_rgba8(region[n], rgba);
+      for (int c = 0; c < 4; c++)
+        bytes[n * 4 + c] = (uint8_t)lroundf(rgba[c] * 255);
+    }
+    std::vector<uint32_t> decoded(region.size()), fallback;
+    double start = emscripten_get_now();
+    for (size_t n = 0; n < region.size(); n++)
+      decoded[n] = pick_decode_rgba8(&bytes[n * 4]);
+    pick_collect_ids(decoded.data(), x2 - x1, y2 - y1, 1, count + 1, fallback);
+    double fallbackTime = emscripten_get_now() - start;
+
+    printf("[BENCH] marquee, %d objects at %dx%d, %dx%d region\n", count, width, height, x2 - x1, y2 - y1);
+    printf("[BENCH]   picking target  %.3f ms, %d visible objects\n", pickTime / runs, (int)picked.size());
+    printf("[BENCH]   RGBA8 fallback  %.3f ms (%s)\n", fallbackTime, fallback == picked ? "same IDs" : "DIFFERENT");
+    printf("[BENCH]   object bounds   %.3f ms, %d overlapping, hidden ones included\n", boundsTime / runs, boundsHits);
+  }
+
+  // Object store under churn: count objects live while every frame destroys churn random ones and
+  // creates as many, e.g. 10k of each per second at 60 fps is churn 167. The pass over the packed
+  // transforms should cost the same before and after, and the slots stay at the live count.
+  EMSCRIPTEN_KEEPALIVE
+  void benchObjectChurn(int count, int churn, int frames)
+  {
+    srand(1);
+    handleTable table;
+    componentPool<benchTransform> transforms;
+    std::vector<objectHandle> live;
+    std::vector<objectHandle> destroyed;
+    auto create = [&]() {
+      objectHandle handle = handle_create(table);
+      float x = rand() % 1000, y = rand() % 1000;
+      transforms.insert(handle_slot(handle), {{x, y}, {0, 1}, {10, 10}});
+      live.push_back(handle);
+    };
+
+    for (int i = 0; i < count; i++)
+      create();
+    float sum = 0;
+    double passBefore = time_transform_pass(transforms, &sum);
+
+    double start = emscripten_get_now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+      for (int n = 0; n < churn && !live.empty(); n++)
+      {
+        size_t victim = rand() % live.size();
+        objectHandle handle = live[victim];
+        transforms.remove(handle_slot(handle));
+        handle_destroy(table, handle);
+        live[victim] = live.back();
+        live.pop_back();
+        destroyed.push_back(handle);
+      }
+      for (int n = 0; n < churn; n++)
+        create();
+    }
+    double churnTime = emscripten_get_now() - start;
+    double passAfter = time_transform_pass(transforms, &sum);
+
+    // None of the old handles may reach the objects that reuse their slots
+    int staleResolved = 0;
+    for (objectHandle handle : destroyed)
+      staleResolved += handle_resolve(table, handle) != SLOT_NONE;
+
+    int operations = churn * frames * 2;
+    printf("[BENCH] object churn, %d live, %d destroyed and created per frame for %d frames\n", count, churn, frames);
+    printf("[BENCH]   create/destroy  %.1f ns per operation\n", operations ? churnTime * 1e6 / operations : 0);
+    printf("[BENCH]   transform pass  %.3f ms before, %.3f ms after (%g)\n", passBefore, passAfter, sum);
+    printf("[BENCH]   slots           %u for %u live objects, %d stale handles resolved\n", handle_slot_count(table), table.live, staleResolved);
+  }
+
+  // count scene objects rotating and moving along looping curves of keyCount keys, advanced frames
+  // times at 60 fps without drawing: the SIMD evaluation written into the pools against evaluating
+  // each object on its own in double precision. The objects are destroyed again afterwards.
+  EMSCRIPTEN_KEEPALIVE
+  void benchAnimation(int count, int keyCount, int frames)
+  {
+    srand(1);
+    keyCount = keyCount < 2 ? 2 : keyCount > ANIMATION_MAX_KEYS ? ANIMATION_MAX_KEYS : keyCount;
+    int created = create_objects(count);
+    std::vector<objectHandle> handles(created_objects(), created_objects() + created);
+    std::vector<float> rotationKeys((size_t)created * keyCount * 3);
+    std::vector<float> translationKeys((size_t)created * keyCount * 4);
+    for (int i = 0; i < created; i++)
+    {
+      float *rotation = &rotationKeys[(size_t)i * keyCount * 3];
+      float *translation = &translationKeys[(size_t)i * keyCount * 4];
+      float time = 0;
+      for (int k = 0; k < keyCount; k++)
+      {
+        float easing = rand() % 2 ? EASE_CUBIC : EASE_LINEAR;
+        float rotationKey[3] = {time, easing, (float)(rand() % 1440 - 720)};
+        float translationKey[4] = {time, easing, (float)(rand() % 500), (float)(rand() % 500)};
+        memcpy(rotation + k * 3, rotationKey, sizeof(rotationKey));
+        memcpy(translation + k * 4, translationKey, sizeof(translationKey));
+        time += 100 + rand() % 400;
+      }
+      animate_object(handles[i], ANIMATE_ROTATION, rotation, keyCount, 1);
+      animate_object(handles[i], ANIMATE_TRANSLATION, translation, keyCount, 1);
+    }
+    double clockStart = animationClock;
+
+    double start = emscripten_get_now();
+    for (int frame = 0; frame < frames; frame++)
+      advance_animations(1000.0f / 60);
+    double simdTime = (emscripten_get_now() - start) / frames;
+
+    // The same frame object by object, with sin and cos in double precision
+    double local = animationClock - clockStart;
+    double maxError = 0;
+    start = emscripten_get_now();
+    for (int i = 0; i < created; i++)
+    {
+      const float *rotation = &rotationKeys[(size_t)i * keyCount * 3];
+      const float *translation = &translationKeys[(size_t)i * keyCount * 4];
+      double duration = rotation[(keyCount - 1) * 3];
+      double angle = reference_curve(rotation, keyCount, 3, 0, fmod(local, duration)) * PI / 180;
+      double translationTime = fmod(local, translation[(keyCount - 1) * 4]);
+      double x = reference_curve(translation, keyCount, 4, 0, translationTime);
+      double y = reference_curve(translation, keyCount, 4, 1, translationTime);
+      const transformComponent &transform = transforms.read(handle_slot(handles[i]));
+      maxError = std::max(maxError, fabs(transform.rotation[0] - sin(angle)));
+      maxError = std::max(maxError, fabs(transform.rotation[1] - cos(angle)));
+      maxError = std::max(maxError, std::max(fabs(transform.translation[0] - x), fabs(transform.translation[1] - y)) / 500);
+    }
+    double referenceTime = emscripten_get_now() - start;
+
+    for (objectHandle handle : handles)
+      destroy_object(handle);
+
+    printf("[BENCH] animation, %d objects with rotation and translation curves of %d keys\n", created, keyCount);
+    printf("[BENCH]   SIMD evaluation %.3f ms per frame\n", simdTime);
+    printf("[BENCH]   scalar double   %.3f ms, largest difference %.2g\n", referenceTime, maxError);
+  }
+
+  // Undo history over count scene objects: steps times edited objects moved and a snapshot taken,
+  // then every step undone, newest first. Snapshots against deep copies of the pools, and the heap
+  // the history holds against what steps deep copies would. A worker renders a snapshot while the
+  // main thread edits, it has to match rendering the snapshot afterwards. The objects are destroyed
+  // again afterwards.
+  EMSCRIPTEN_KEEPALIVE
+  void benchSnapshots(int count, int steps, int edited)
+  {
+    srand(1);
+    double heapBefore = scene_heap_bytes();
+    int created = create_objects(count);
+    std::vector<objectHandle> handles(created_objects(), created_objects() + created);
+    if (created == 0)
+      return;
+    std::vector<transformComponent> initial(created);
+    for (int i = 0; i < created; i++)
+      initial[i] = transforms.read(handle_slot(handles[i]));
+    double heapScene = scene_heap_bytes();
+
+    std::vector<uint32_t> history;
+    history.push_back(take_snapshot());
+    double snapshotTime = 0, editTime = 0;
+    for (int step = 0; step < steps; step++)
+    {
+      double start = emscripten_get_now();
+      for (int e = 0; e < edited; e++)
+        set_translation(handles[rand() % created], rand() % 1000, rand() % 1000);
+      editTime += emscripten_get_now() - start;
+      start = emscripten_get_now();
+      history.push_back(take_snapshot());
+      snapshotTime += emscripten_get_now() - start;
+    }
+    double heapHistory = scene_heap_bytes();
+
+    // What a snapshot costs without sharing: every pool copied out
+    const int copies = 5;
+    size_t deepBytes = 0;
+    double start = emscripten_get_now();
+    for (int copy = 0; copy < copies; copy++)
+    {
+      std::vector<uint32_t> words;
+      std::vector<transformComponent> transformCopy;
+      std::vector<colorComponent> colorCopy;
+      std::vector<meshComponent> meshCopy;
+      std::vector<GLuint> pickIdCopy;
+      deepBytes = deep_copy(objectHandles.generations, words) + deep_copy(objectHandles.nextFree, words) + deep_copy(objectHandles.issued, words) +
+                  deep_copy(transforms.sparse, words) + deep_copy(transforms.slots, words) + deep_copy(transforms.values, transformCopy) +
+                  deep_copy(colors.sparse, words) + deep_copy(colors.slots, words) + deep_copy(colors.values, colorCopy) +
+                  deep_copy(meshes.sparse, words) + deep_copy(meshes.slots, words) + deep_copy(meshes.values, meshCopy) +
+                  deep_copy(pickIds.sparse, words) + deep_copy(pickIds.slots, words) + deep_copy(pickIds.values, pickIdCopy);
+    }
+    double deepTime = (emscripten_get_now() - start) / copies;
+
+    // Rendered by a worker while the main thread keeps editing, then again once it is done
+    bool consistent;
+    double backgroundEditTime;
+    {
+      const int width = 256, height = 256;
+      std::shared_ptr<const sceneSnapshot> shared = find_snapshot(history.back());
+      snapshotRender background, foreground;
+#ifndef RASTER_NO_THREADS
+      std::thread worker([&]() {
+        snapshot_render(*shared, width, height, width, height, 1, true, background);
+      });
+#else
+      snapshot_render(*shared, width, height, width, height, 1, true, background);
+#endif
+      start = emscripten_get_now();
+      for (int e = 0; e < edited * 10; e++)
+      {
+        objectHandle handle = handles[rand() % created];
+        set_scale(handle, rand() % 300, rand() % 300);
+        set_color(handle, 1, 0, 0, 1);
+      }
+      backgroundEditTime = emscripten_get_now() - start;
+#ifndef RASTER_NO_THREADS
+      worker.join();
+#endif
+      snapshot_render(*shared, width, height, width, height, 1, true, foreground);
+      consistent = background.color == foreground.color && background.ids == foreground.ids;
+    }
+
+    // Undo back to the first snapshot, checking one step on the way
+    int checkedStep = steps / 2;
+    std::vector<transformComponent> checked;
+    double undoTime = 0;
+    for (int step = steps; step >= 0; step--)
+    {
+      start = emscripten_get_now();
+      restore_snapshot(history[step]);
+      undoTime += emscripten_get_now() - start;
+      if (step == checkedStep)
+        for (int i = 0; i < created; i++)
+          checked.push_back(transforms.read(handle_slot(handles[i])));
+    }
+    bool undone = true;
+    for (int i = 0; i < created; i++)
+      undone = undone && !memcmp(&transforms.read(handle_slot(handles[i])), &initial[i], sizeof(transformComponent));
+    // Redo to the checked step, it has to come back the same
+    restore_snapshot(history[checkedStep]);
+    bool redone = true;
+    for (int i = 0; i < created; i++)
+      redone = redone && !memcmp(&transforms.read(handle_slot(handles[i])), &checked[i], sizeof(transformComponent));
+
+    double heapUndone = scene_heap_bytes();
+    for (uint32_t snapshot : history)
+      release_snapshot(snapshot);
+    double heapReleased = scene_heap_bytes();
+    for (objectHandle handle : handles)
+      destroy_object(handle);
+
+    printf("[BENCH] snapshots, %d objects, %d steps of %d edits\n", created, steps, edited);
+    printf("[BENCH]   snapshot        %.4f ms, deep copy %.3f ms\n", snapshotTime / steps, deepTime);
+    printf("[BENCH]   edits           %.4f ms per step (%.1f ns per edit)\n", editTime / steps, editTime * 1e6 / ((double)steps * edited));
+    printf("[BENCH]   undo            %.3f ms per step, %s, redo %s\n", undoTime / (steps + 1), undone ? "back to the start" : "DIFFERENT", redone ? "identical" : "DIFFERENT");
+    printf("[BENCH]   history         %.1f MB for %d snapshots of a %.1f MB scene, deep copies %.1f MB\n", (heapHistory - heapScene) / 1048576,
+           steps + 1, (heapScene - heapBefore) / 1048576, (double)deepBytes * (steps + 1) / 1048576);
+    printf("[BENCH]   background      render %s, %d edits meanwhile in %.3f ms\n", consistent ? "consistent" : "INCONSISTENT", edited * 10, backgroundEditTime);
+    printf("[BENCH]   released        %.1f MB\n", (heapUndone - heapReleased) / 1048576);
+  }
+}
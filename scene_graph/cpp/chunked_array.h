@@ -0,0 +1,130 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Elements per chunk, a chunk is the unit edits copy
+#define CHUNK_BITS 8
+#define CHUNK_SIZE (1u << CHUNK_BITS)
+
+// Persistent array of fixed-size chunks shared between copies. Copying one is O(1): the copy shares
+// the chunk directory and every chunk with the original. The first edit through either copies the
+// directory, 1 / CHUNK_SIZE of the array's size in pointers, and each edit copies the chunk it lands
+// in unless that chunk is already its own. A chunk is freed with the last copy that shares it.
+//
+// Reading is const only, so reads never copy. Copies may be handed to other threads and read there
+// while the original is edited, as long as one copy is only ever used by one thread at a time.
+template <typename T>
+class chunkedArray
+{
+public:
+  size_t size() const
+  {
+    return count;
+  }
+
+  bool empty() const
+  {
+    return count == 0;
+  }
+
+  const T &operator[](size_t index) const
+  {
+    return (*chunks)[index >> CHUNK_BITS]->values[index & (CHUNK_SIZE - 1)];
+  }
+
+  const T &back() const
+  {
+    return (*this)[count - 1];
+  }
+
+  // Writable element, copying its chunk first when another copy shares it
+  T &edit(size_t index)
+  {
+    std::shared_ptr<chunk> &owned = own_directory()[index >> CHUNK_BITS];
+    if (!sole_owner(owned))
+      owned = std::make_shared<chunk>(*owned);
+    return owned->values[index & (CHUNK_SIZE - 1)];
+  }
+
+  void push_back(const T &value)
+  {
+    if ((count & (CHUNK_SIZE - 1)) == 0)
+      own_directory().push_back(std::make_shared<chunk>());
+    count++;
+    edit(count - 1) = value;
+  }
+
+  // Drops the last chunk once it is empty
+  void pop_back()
+  {
+    count--;
+    if ((count & (CHUNK_SIZE - 1)) == 0)
+      own_directory().pop_back();
+  }
+
+  void resize(size_t size, const T &fill)
+  {
+    while (count < size)
+      push_back(fill);
+    while (count > size)
+      pop_back();
+  }
+
+  void clear()
+  {
+    chunks.reset();
+    count = 0;
+  }
+
+  // Chunks this copy holds, shared or not
+  size_t chunk_count() const
+  {
+    return chunks ? chunks->size() : 0;
+  }
+
+  // True when both copies hold the very same chunk, which then has the same values in both. False
+  // says nothing, the values may still be equal.
+  bool shares_chunk(const chunkedArray &other, size_t chunk) const
+  {
+    return chunk < chunk_count() && chunk < other.chunk_count() && (*chunks)[chunk] == (*other.chunks)[chunk];
+  }
+
+private:
+  struct chunk
+  {
+    T values[CHUNK_SIZE];
+  };
+  typedef std::vector<std::shared_ptr<chunk>> chunkDirectory;
+
+  std::shared_ptr<chunkDirectory> chunks;
+  size_t count = 0;
+
+  // A count of 1 read after another thread dropped its copy has to see that thread's reads done
+  // before the chunk is written
+  template <typename P>
+  static bool sole_owner(const std::shared_ptr<P> &pointer)
+  {
+    if (pointer.use_count() != 1)
+      return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+  }
+
+  chunkDirectory &own_directory()
+  {
+    if (!chunks)
+      chunks = std::make_shared<chunkDirectory>();
+    else if (!sole_owner(chunks))
+      chunks = std::make_shared<chunkDirectory>(*chunks);
+    return *chunks;
+  }
+};
+
+// Writable element of an array, array_edit on a std::vector is plain indexing
+template <typename T>
+static inline T &array_edit(chunkedArray<T> &array, size_t index)
+{
+  return array.edit(index);
+}
@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <string.h>
+#include "commands.h"
+#include "webgl.h"
+#include "animation.h"
+
+static uint32_t commandWords[COMMAND_BUFFER_SIZE / sizeof(uint32_t)];
+
+// Number of argument words following each opcode, -1 for a retired one
+static const int commandArguments[] = {
+    0, // CMD_END
+    3, // CMD_SET_TRANSLATION
+    2, // CMD_SET_ROTATION
+    3, // CMD_SET_SCALE
+    6, // CMD_SET_TRANSFORM
+    5, // CMD_SET_COLOR
+    -1, // retired CMD_ADD_NODE
+    1, // CMD_REMOVE_NODE
+    2, // CMD_POINTER_MOVE
+    4, // CMD_ANIMATE, and its keys
+    2, // CMD_STOP_ANIMATION
+};
+
+static inline float read_float(const uint32_t *word)
+{
+  float value;
+  memcpy(&value, word, sizeof(value));
+  return value;
+}
+
+uint32_t *command_buffer()
+{
+  return commandWords;
+}
+
+int apply_commands(int length)
+{
+  int wordCount = length / sizeof(uint32_t);
+  if (wordCount > (int)(COMMAND_BUFFER_SIZE / sizeof(uint32_t)))
+    wordCount = COMMAND_BUFFER_SIZE / sizeof(uint32_t);
+
+  int applied = 0;
+  int position = 0;
+  while (position < wordCount)
+  {
+    uint32_t type = commandWords[position];
+    if (type == CMD_END || type > CMD_STOP_ANIMATION)
+      break;
+    int argumentCount = commandArguments[type];
+    if (argumentCount < 0 || position + 1 + argumentCount > wordCount)
+      break;
+
+    const uint32_t *args = commandWords + position + 1;
+    if (type == CMD_ANIMATE)
+    {
+      int channel = (int32_t)args[1];
+      int keyCount = (int32_t)args[3];
+      if (channel < 0 || channel >= ANIMATION_CHANNELS || keyCount < 1 || keyCount > ANIMATION_MAX_KEYS)
+        break;
+      argumentCount += keyCount * (2 + animationComponents[channel]);
+      if (position + 1 + argumentCount > wordCount)
+        break;
+    }
+
+    uint32_t id = args[0];
+    switch (type)
+    {
+    case CMD_SET_TRANSLATION:
+      set_translation(id, read_float(args + 1), read_float(args + 2));
+      break;
+    case CMD_SET_ROTATION:
+      set_rotation(id, read_float(args + 1));
+      break;
+    case CMD_SET_SCALE:
+      set_scale(id, read_float(args + 1), read_float(args + 2));
+      break;
+    case CMD_SET_TRANSFORM:
+      set_translation(id, read_float(args + 1), read_float(args + 2));
+      set_rotation(id, read_float(args + 3));
+      set_scale(id, read_float(args + 4), read_float(args + 5));
+      break;
+    case CMD_SET_COLOR:
+      set_color(id, read_float(args + 1), read_float(args + 2), read_float(args + 3), read_float(args + 4));
+      break;
+    case CMD_REMOVE_NODE:
+      destroy_object(id);
+      break;
+    case CMD_POINTER_MOVE:
+      set_mouse((int)read_float(args), (int)read_float(args + 1));
+      break;
+    case CMD_ANIMATE:
+    {
+      float keys[ANIMATION_MAX_KEYS * (2 + 4)];
+      memcpy(keys, args + 4, (argumentCount - 4) * sizeof(float));
+      animate_object(id, (int32_t)args[1], keys, (int32_t)args[3], args[2] != 0);
+      break;
+    }
+    case CMD_STOP_ANIMATION:
+      stop_animation(id, (int32_t)args[1]);
+      break;
+    }
+
+    position += 1 + argumentCount;
+    applied++;
+  }
+
+  // The whole batch costs a single redraw
+  if (applied > 0)
+    draw_scene();
+
+  return applied;
+}
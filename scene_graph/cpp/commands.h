@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+
+// Command stream layout: a sequence of 32-bit words. Each command is an opcode word followed by
+// its arguments, object handles as uint32, channels and counts as int32 and everything else as float32.
+//   CMD_SET_TRANSLATION  id, x, y
+//   CMD_SET_ROTATION     id, angle (degrees)
+//   CMD_SET_SCALE        id, x, y
+//   CMD_SET_TRANSFORM    id, x, y, angle, scaleX, scaleY
+//   CMD_SET_COLOR        id, r, g, b, a
+//   CMD_REMOVE_NODE      id
+//   CMD_POINTER_MOVE     x, y
+//   CMD_ANIMATE          id, channel, loop, keyCount, then keyCount keys of time (ms), easing and the
+//                        channel's values, see animation.h
+//   CMD_STOP_ANIMATION   id, channel (-1 for all)
+enum commandType
+{
+  CMD_END = 0,
+  CMD_SET_TRANSLATION = 1,
+  CMD_SET_ROTATION = 2,
+  CMD_SET_SCALE = 3,
+  CMD_SET_TRANSFORM = 4,
+  CMD_SET_COLOR = 5,
+  // 6 was CMD_ADD_NODE, create_objects returns handles right away. A retired opcode is unknown.
+  CMD_REMOVE_NODE = 7,
+  CMD_POINTER_MOVE = 8,
+  CMD_ANIMATE = 9,
+  CMD_STOP_ANIMATION = 10,
+};
+
+// Size of the shared command region in bytes
+#define COMMAND_BUFFER_SIZE (256 * 1024)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Returns the heap region JS writes commands into. The address is stable for the module lifetime.
+  uint32_t *command_buffer();
+
+  // Applies the first length bytes of the command region. Returns the number of commands applied,
+  // stops at CMD_END, an unknown opcode or a truncated command.
+  int apply_commands(int length);
+
+#ifdef __cplusplus
+}
+#endif
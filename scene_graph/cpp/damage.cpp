@@ -0,0 +1,88 @@
+#include "damage.h"
+
+static int rect_area(const screenRect &rect)
+{
+  return rect_empty(rect) ? 0 : (rect.x2 - rect.x1) * (rect.y2 - rect.y1);
+}
+
+bool rect_empty(const screenRect &rect)
+{
+  return rect.x1 >= rect.x2 || rect.y1 >= rect.y2;
+}
+
+bool rect_intersects(const screenRect &a, const screenRect &b)
+{
+  return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+screenRect rect_union(const screenRect &a, const screenRect &b)
+{
+  if (rect_empty(a))
+    return b;
+  if (rect_empty(b))
+    return a;
+  return {
+      a.x1 < b.x1 ? a.x1 : b.x1,
+      a.y1 < b.y1 ? a.y1 : b.y1,
+      a.x2 > b.x2 ? a.x2 : b.x2,
+      a.y2 > b.y2 ? a.y2 : b.y2,
+  };
+}
+
+void damage_add(damageList &damage, screenRect rect, int width, int height)
+{
+  if (damage.full)
+    return;
+  rect.x1 = rect.x1 < 0 ? 0 : rect.x1;
+  rect.y1 = rect.y1 < 0 ? 0 : rect.y1;
+  rect.x2 = rect.x2 > width ? width : rect.x2;
+  rect.y2 = rect.y2 > height ? height : rect.y2;
+  if (rect_empty(rect))
+    return;
+
+  // Every merge removes a rectangle, so this ends
+  for (;;)
+  {
+    int overlapping = -1;
+    for (int i = 0; i < damage.count && overlapping < 0; i++)
+      if (rect_intersects(damage.rects[i], rect))
+        overlapping = i;
+
+    if (overlapping < 0 && damage.count < DAMAGE_MAX_RECTS)
+    {
+      damage.rects[damage.count++] = rect;
+      return;
+    }
+
+    // Out of rectangles, merge with the one that grows the least
+    if (overlapping < 0)
+    {
+      int bestGrowth = 0;
+      for (int i = 0; i < damage.count; i++)
+      {
+        int growth = rect_area(rect_union(damage.rects[i], rect)) - rect_area(damage.rects[i]);
+        if (overlapping < 0 || growth < bestGrowth)
+        {
+          overlapping = i;
+          bestGrowth = growth;
+        }
+      }
+    }
+    rect = rect_union(damage.rects[overlapping], rect);
+    damage.rects[overlapping] = damage.rects[--damage.count];
+  }
+}
+
+int damage_area(const damageList &damage)
+{
+  int area = 0;
+  for (int i = 0; i < damage.count; i++)
+    area += rect_area(damage.rects[i]);
+  return area;
+}
+
+void damage_clear(damageList &damage)
+{
+  damage.count = 0;
+  damage.full = false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Damage rectangles kept per frame, more are merged into the closest one
+#define DAMAGE_MAX_RECTS 8
+
+// When the damage covers more than this fraction of the canvas the whole frame is redrawn
+#define DAMAGE_FULL_REDRAW_FRACTION 0.5f
+
+// Pixel rectangle, y down like u_resolution space, x2 and y2 exclusive
+struct screenRect
+{
+  int x1, y1, x2, y2;
+};
+
+struct damageList
+{
+  screenRect rects[DAMAGE_MAX_RECTS];
+  int count;
+  // Set when everything has to be redrawn, e.g. on the first frame
+  bool full;
+};
+
+bool rect_empty(const screenRect &rect);
+bool rect_intersects(const screenRect &a, const screenRect &b);
+// Bounding rectangle of both, empty rectangles are ignored
+screenRect rect_union(const screenRect &a, const screenRect &b);
+
+// Adds rect clipped to the canvas. Overlapping rectangles are merged so no pixel is redrawn twice.
+void damage_add(damageList &damage, screenRect rect, int width, int height);
+int damage_area(const damageList &damage);
+void damage_clear(damageList &damage);
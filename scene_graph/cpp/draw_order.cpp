@@ -0,0 +1,88 @@
+#include <stdint.h>
+#include <string.h>
+#include "draw_order.h"
+
+static uint64_t clamp_bits(uint32_t value, int bits)
+{
+  uint32_t max = (1u << bits) - 1;
+  return value > max ? max : value;
+}
+
+uint64_t make_sort_key(uint32_t layer, int translucent, float depth, uint32_t program, uint32_t texture, uint32_t mesh)
+{
+  const uint32_t maxDepth = (1u << SORT_KEY_DEPTH_BITS) - 1;
+  if (depth < 0)
+    depth = 0;
+  if (depth > 1)
+    depth = 1;
+  uint32_t quantizedDepth = (uint32_t)(depth * maxDepth);
+  // Translucent draws need to blend over what is behind them, so the farthest one goes first
+  if (translucent)
+    quantizedDepth = maxDepth - quantizedDepth;
+
+  uint64_t key = 0;
+  key |= clamp_bits(layer, SORT_KEY_LAYER_BITS) << 56;
+  key |= (uint64_t)(translucent ? 1 : 0) << 55;
+  key |= (uint64_t)quantizedDepth << 31;
+  key |= clamp_bits(program, SORT_KEY_PROGRAM_BITS) << 19;
+  key |= clamp_bits(texture, SORT_KEY_TEXTURE_BITS) << 8;
+  key |= clamp_bits(mesh, SORT_KEY_MESH_BITS);
+  return key;
+}
+
+void radix_sort_keys(uint64_t *keys, uint32_t *indices, uint64_t *tmpKeys, uint32_t *tmpIndices, int count)
+{
+  // One histogram per byte, all filled in a single read of the keys
+  uint32_t histograms[8][256];
+  memset(histograms, 0, sizeof(histograms));
+  for (int i = 0; i < count; i++)
+  {
+    uint64_t key = keys[i];
+    for (int pass = 0; pass < 8; pass++)
+      histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+  }
+
+  uint64_t *srcKeys = keys;
+  uint32_t *srcIndices = indices;
+  uint64_t *dstKeys = tmpKeys;
+  uint32_t *dstIndices = tmpIndices;
+
+  for (int pass = 0; pass < 8; pass++)
+  {
+    uint32_t *histogram = histograms[pass];
+    int shift = pass * 8;
+
+    // Every key has the same digit, nothing would move
+    if (count == 0 || histogram[(srcKeys[0] >> shift) & 0xFF] == (uint32_t)count)
+      continue;
+
+    uint32_t offset = 0;
+    for (int digit = 0; digit < 256; digit++)
+    {
+      uint32_t bucket = histogram[digit];
+      histogram[digit] = offset;
+      offset += bucket;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      uint32_t position = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+      dstKeys[position] = srcKeys[i];
+      dstIndices[position] = srcIndices[i];
+    }
+
+    uint64_t *swapKeys = srcKeys;
+    srcKeys = dstKeys;
+    dstKeys = swapKeys;
+    uint32_t *swapIndices = srcIndices;
+    srcIndices = dstIndices;
+    dstIndices = swapIndices;
+  }
+
+  // Odd number of executed passes leaves the result in the scratch buffers
+  if (srcKeys != keys)
+  {
+    memcpy(keys, srcKeys, count * sizeof(uint64_t));
+    memcpy(indices, srcIndices, count * sizeof(uint32_t));
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+
+// Sort key layout, most significant bits first:
+//   [63..56] layer
+//   [55]     translucent (opaque draws go first)
+//   [54..31] depth, front to back for opaque and back to front for translucent
+//   [30..19] program
+//   [18..8]  texture
+//   [7..0]   mesh
+#define SORT_KEY_LAYER_BITS 8
+#define SORT_KEY_DEPTH_BITS 24
+#define SORT_KEY_PROGRAM_BITS 12
+#define SORT_KEY_TEXTURE_BITS 11
+#define SORT_KEY_MESH_BITS 8
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Packs the draw state into a 64-bit key. depth is expected in [0, 1], 0 being the closest.
+  uint64_t make_sort_key(uint32_t layer, int translucent, float depth, uint32_t program, uint32_t texture, uint32_t mesh);
+
+  // Sorts keys ascending with an LSD radix sort (8 bits per pass) and permutes indices alongside.
+  // tmpKeys and tmpIndices must hold count elements. Passes where every key shares the same digit are skipped.
+  void radix_sort_keys(uint64_t *keys, uint32_t *indices, uint64_t *tmpKeys, uint32_t *tmpIndices, int count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,11 +5,25 @@
 #include <stdio.h>
 #include <emscripten/html5.h>
 #include "webgl.cpp"
+#include "commands.cpp"
+#include "trace.cpp"
+#include "../../common/cpp/tracking_allocator.cpp"
+#ifdef ENABLE_BENCHMARKS
+#include "bench.cpp"
+#endif
+
+// The scene's evictor, runs every frame while it stays over budget, quietly
+static void evict_scene_caches(void *owner, int64_t excess)
+{
+  release_scene_caches();
+}
 
 int main()
 {
   // emscripten_request_animation_frame_loop(&draw_frame, 0);
   printf("[WASM] Loaded\n");
+  memory_set_default_subsystem(MEMORY_SCENE);
+  memory_add_evictor(MEMORY_SCENE, evict_scene_caches, NULL);
 
   EM_ASM(
       if (typeof window != "undefined") {
@@ -25,30 +39,213 @@ extern "C"
   EMSCRIPTEN_KEEPALIVE
   void init(int width, int height)
   {
+    trace_record(TRACE_INIT, width, height);
     webgl_init(width, height);
   }
 
   EMSCRIPTEN_KEEPALIVE
   void updateTranslation(int x, int y)
   {
+    trace_record(TRACE_UPDATE_TRANSLATION, x, y);
     update_translation(x, y);
   }
 
   EMSCRIPTEN_KEEPALIVE
   void updateRotation(int angle)
   {
+    trace_record(TRACE_UPDATE_ROTATION, angle, 0);
     update_rotation(angle);
   }
 
   EMSCRIPTEN_KEEPALIVE
   void updateScale(int x, int y)
   {
+    trace_record(TRACE_UPDATE_SCALE, x, y);
     update_scale(x, y);
   }
 
   EMSCRIPTEN_KEEPALIVE
   void updateMouse(int x, int y)
   {
+    trace_record(TRACE_UPDATE_MOUSE, x, y);
     update_mouse(x, y);
   }
+
+  // Creates count objects, returns how many fit. createdNodes points at their handles.
+  EMSCRIPTEN_KEEPALIVE
+  int createNodes(int count)
+  {
+    trace_record(TRACE_CREATE_OBJECTS, count, 0);
+    return create_objects(count);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint32_t *createdNodes()
+  {
+    return created_objects();
+  }
+
+  // Advances keyframe animations by deltaMs and redraws, once per frame. Animations are set up
+  // with CMD_ANIMATE commands.
+  EMSCRIPTEN_KEEPALIVE
+  int animate(float deltaMs)
+  {
+    int32_t bits;
+    memcpy(&bits, &deltaMs, sizeof(bits));
+    trace_record(TRACE_ANIMATE, bits, 0);
+    int animated = update_animations(deltaMs);
+    memory_enforce_budgets();
+    return animated;
+  }
+
+  // Marquee selection, see pick_region
+  EMSCRIPTEN_KEEPALIVE
+  int pickRegion(int x1, int y1, int x2, int y2)
+  {
+    const int32_t args[] = {x1, y1, x2, y2};
+    trace_record_args(TRACE_PICK_REGION, args);
+    return pick_region(x1, y1, x2, y2);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint32_t *pickedIds()
+  {
+    return picked_ids();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void setPartialRedraw(int enabled)
+  {
+    trace_record(TRACE_SET_PARTIAL_REDRAW, enabled, 0);
+    set_partial_redraw(enabled);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint32_t *commandBuffer()
+  {
+    return command_buffer();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int commandBufferSize()
+  {
+    return COMMAND_BUFFER_SIZE;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int applyCommands(int length)
+  {
+    trace_record_commands(command_buffer(), length);
+    int applied = apply_commands(length);
+    memory_enforce_budgets();
+    return applied;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint8_t *renderSoftware(int width, int height, int threads, int ids)
+  {
+    const int32_t args[] = {width, height, threads, ids};
+    trace_record_args(TRACE_RENDER_SOFTWARE, args);
+    return render_software(width, height, threads, ids);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint32_t *softwareIds()
+  {
+    return software_ids();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint8_t *softwarePng()
+  {
+    return software_png();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int softwarePngSize()
+  {
+    return software_png_size();
+  }
+
+  // Undo and redo: snapshots are O(1) and share unchanged chunks, see snapshot.h. Restoring redraws.
+  EMSCRIPTEN_KEEPALIVE
+  uint32_t takeSnapshot()
+  {
+    uint32_t snapshot = take_snapshot();
+    trace_record(TRACE_TAKE_SNAPSHOT, snapshot, 0);
+    return snapshot;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int restoreSnapshot(uint32_t snapshot)
+  {
+    trace_record(TRACE_RESTORE_SNAPSHOT, snapshot, 0);
+    if (!restore_snapshot(snapshot))
+      return 0;
+    draw_scene();
+    memory_enforce_budgets();
+    return 1;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void releaseSnapshot(uint32_t snapshot)
+  {
+    trace_record(TRACE_RELEASE_SNAPSHOT, snapshot, 0);
+    release_snapshot(snapshot);
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  uint8_t *renderSnapshot(uint32_t snapshot, int width, int height, int threads, int ids)
+  {
+    const int32_t args[] = {(int32_t)snapshot, width, height, threads, ids};
+    trace_record_args(TRACE_RENDER_SNAPSHOT, args);
+    return render_snapshot(snapshot, width, height, threads, ids);
+  }
+
+  // Bytes to allocate for the memory statistics, see memoryStats in memory_accounting.h for the layout
+  EMSCRIPTEN_KEEPALIVE
+  int memoryStatisticsSize()
+  {
+    return sizeof(memoryStats);
+  }
+
+  // Current, peak and churn of the scene's heap and GPU memory into a memoryStatisticsSize() buffer
+  EMSCRIPTEN_KEEPALIVE
+  void memoryStatistics(memoryStats *out)
+  {
+    memory_stats(*out);
+  }
+
+  // Soft budget in bytes for a memorySubsystem, 0 for none. Going over MEMORY_SCENE's frees the
+  // software render target and the picking readback after the next commands or animation frame.
+  EMSCRIPTEN_KEEPALIVE
+  void setMemoryBudget(int subsystem, double bytes)
+  {
+    memory_set_budget(subsystem, (int64_t)bytes);
+  }
+
+  // Records the calls above into a trace for the replay driver, see trace.h
+  EMSCRIPTEN_KEEPALIVE
+  void startRecording()
+  {
+    trace_start();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  void stopRecording()
+  {
+    trace_stop();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  const uint32_t *recordingData()
+  {
+    return trace_data();
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int recordingSize()
+  {
+    return trace_size();
+  }
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include "object_store.h"
+
+// nextFree of a slot in use
+#define SLOT_LIVE 0xFFFFFFFEu
+
+// Lowest generation a slot can hand out without reviving a handle it handed out before
+static uint32_t next_generation(const handleTable &table, uint32_t slot)
+{
+  if (slot >= table.generations.size())
+    return 1;
+  uint32_t generation = std::max(table.generations[slot] + (table.nextFree[slot] == SLOT_LIVE ? 1 : 0), table.issued[slot] + 1);
+  // Skip generation 0 on wrap around, it would let slot 0 hand out HANDLE_NONE
+  return generation > HANDLE_MAX_GENERATION ? 1 : generation;
+}
+
+static void push_free(handleTable &table, uint32_t slot)
+{
+  table.nextFree.edit(slot) = SLOT_NONE;
+  if (table.freeTail != SLOT_NONE)
+    table.nextFree.edit(table.freeTail) = slot;
+  else
+    table.freeHead = slot;
+  table.freeTail = slot;
+}
+
+objectHandle handle_create(handleTable &table)
+{
+  uint32_t slot;
+  if (table.freeHead != SLOT_NONE)
+  {
+    slot = table.freeHead;
+    table.freeHead = table.nextFree[slot];
+    if (table.freeHead == SLOT_NONE)
+      table.freeTail = SLOT_NONE;
+  }
+  else
+  {
+    if (table.generations.size() >= HANDLE_MAX_SLOTS)
+      return HANDLE_NONE;
+    slot = table.generations.size();
+    table.generations.push_back(1);
+    table.nextFree.push_back(SLOT_NONE);
+    table.issued.push_back(0);
+  }
+  table.nextFree.edit(slot) = SLOT_LIVE;
+  table.live++;
+  return table.generations[slot] << HANDLE_SLOT_BITS | slot;
+}
+
+bool handle_destroy(handleTable &table, objectHandle handle)
+{
+  uint32_t slot = handle_resolve(table, handle);
+  if (slot == SLOT_NONE)
+    return false;
+
+  table.generations.edit(slot) = next_generation(table, slot);
+  push_free(table, slot);
+  table.live--;
+  return true;
+}
+
+void handle_restore(handleTable &table, const handleTable &snapshot)
+{
+  handleTable restored = snapshot;
+  uint32_t count = std::max(table.generations.size(), snapshot.generations.size());
+  for (uint32_t slot = snapshot.generations.size(); slot < count; slot++)
+  {
+    restored.generations.push_back(0);
+    restored.nextFree.push_back(SLOT_NONE);
+    restored.issued.push_back(0);
+    push_free(restored, slot);
+  }
+
+  for (uint32_t first = 0; first < count; first += CHUNK_SIZE)
+  {
+    size_t chunk = first >> CHUNK_BITS;
+    if (table.generations.shares_chunk(snapshot.generations, chunk) && table.nextFree.shares_chunk(snapshot.nextFree, chunk) &&
+        table.issued.shares_chunk(snapshot.issued, chunk))
+      continue;
+    for (uint32_t slot = first; slot < std::min(first + CHUNK_SIZE, count); slot++)
+    {
+      uint32_t next = std::max(next_generation(table, slot), next_generation(snapshot, slot));
+      if (restored.nextFree[slot] == SLOT_LIVE)
+        restored.issued.edit(slot) = next - 1;
+      else
+        restored.generations.edit(slot) = next;
+    }
+  }
+  table = restored;
+}
+
+uint32_t handle_resolve(const handleTable &table, objectHandle handle)
+{
+  uint32_t slot = handle_slot(handle);
+  if (slot >= table.generations.size() || table.nextFree[slot] != SLOT_LIVE || table.generations[slot] != handle_generation(handle))
+    return SLOT_NONE;
+  return slot;
+}
+
+objectHandle handle_of(const handleTable &table, uint32_t slot)
+{
+  if (slot >= table.generations.size() || table.nextFree[slot] != SLOT_LIVE)
+    return HANDLE_NONE;
+  return table.generations[slot] << HANDLE_SLOT_BITS | slot;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "chunked_array.h"
+
+// Object handles are 32 bits: the slot index in the low HANDLE_SLOT_BITS and the slot's generation
+// above. Destroying an object bumps its slot's generation, so a stale handle stops resolving instead
+// of reaching whatever reuses the slot. Generations start at 1, no handle is ever HANDLE_NONE.
+#define HANDLE_SLOT_BITS 20
+#define HANDLE_MAX_SLOTS (1u << HANDLE_SLOT_BITS)
+#define HANDLE_MAX_GENERATION ((1u << (32 - HANDLE_SLOT_BITS)) - 1)
+#define HANDLE_NONE 0
+
+// Absent slot or dense index
+#define SLOT_NONE 0xFFFFFFFFu
+
+typedef uint32_t objectHandle;
+
+static inline uint32_t handle_slot(objectHandle handle)
+{
+  return handle & (HANDLE_MAX_SLOTS - 1);
+}
+
+static inline uint32_t handle_generation(objectHandle handle)
+{
+  return handle >> HANDLE_SLOT_BITS;
+}
+
+// Slot allocator. Freed slots queue up and are reused oldest first, which spreads the generation
+// bumps over every slot and puts off a generation wrapping around for as long as possible. Copying a
+// table is O(1), see chunked_array.h.
+struct handleTable
+{
+  // Per slot: current generation, and the next free slot or SLOT_LIVE
+  chunkedArray<uint32_t> generations;
+  chunkedArray<uint32_t> nextFree;
+  // Per slot the highest generation handed out as far as a restore knows, ahead of generations when
+  // the object it brought back is older than ones the slot had since. 0 until then.
+  chunkedArray<uint32_t> issued;
+  uint32_t freeHead = SLOT_NONE;
+  uint32_t freeTail = SLOT_NONE;
+  uint32_t live = 0;
+};
+
+// O(1), HANDLE_NONE once HANDLE_MAX_SLOTS objects are live
+objectHandle handle_create(handleTable &table);
+
+// O(1), false for a stale or invalid handle
+bool handle_destroy(handleTable &table, objectHandle handle);
+
+// Slot of a live handle, SLOT_NONE when it is stale
+uint32_t handle_resolve(const handleTable &table, objectHandle handle);
+
+// Makes table the snapshot of an earlier one again. Objects live in the snapshot get their handles
+// back, every other handle either table handed out stays stale: the slots keep the higher of the two
+// generations and slots created after the snapshot stay, free. Only chunks the two don't share are
+// looked at.
+void handle_restore(handleTable &table, const handleTable &snapshot);
+
+// Handle of the object in a slot, HANDLE_NONE when the slot is free
+objectHandle handle_of(const handleTable &table, uint32_t slot);
+
+// One past the highest slot ever used, the size per-slot arrays need
+static inline uint32_t handle_slot_count(const handleTable &table)
+{
+  return table.generations.size();
+}
+
+// Sparse set of components by slot. Values are packed densely in no particular order, so a pass over
+// a component walks contiguous memory however objects come and go. Insert and remove are O(1), remove
+// moves the last value into the hole. Values move on insert and remove, don't keep pointers to them.
+//
+// Array is std::vector, or chunkedArray for pools that are snapshotted: copying the pool is then
+// O(1), and get and find on a non-const pool copy the chunk they land in. read only ever reads.
+template <typename T>
+using denseArray = std::vector<T>;
+
+template <typename T>
+static inline T &array_edit(std::vector<T> &array, size_t index)
+{
+  return array[index];
+}
+
+template <typename T, template <typename> class Array = denseArray>
+struct componentPool
+{
+  // slot -> dense index, SLOT_NONE when the slot has no value
+  Array<uint32_t> sparse;
+  // dense index -> slot
+  Array<uint32_t> slots;
+  Array<T> values;
+
+  uint32_t size() const
+  {
+    return values.size();
+  }
+
+  bool has(uint32_t slot) const
+  {
+    return slot < sparse.size() && sparse[slot] != SLOT_NONE;
+  }
+
+  // The slot has to have a value
+  T &get(uint32_t slot)
+  {
+    return array_edit(values, sparse[slot]);
+  }
+
+  const T &get(uint32_t slot) const
+  {
+    return values[sparse[slot]];
+  }
+
+  const T &read(uint32_t slot) const
+  {
+    return values[sparse[slot]];
+  }
+
+  T *find(uint32_t slot)
+  {
+    return has(slot) ? &array_edit(values, sparse[slot]) : NULL;
+  }
+
+  // Replaces the value when the slot already has one
+  T &insert(uint32_t slot, const T &value)
+  {
+    if (slot >= sparse.size())
+      sparse.resize(slot + 1, SLOT_NONE);
+    if (sparse[slot] != SLOT_NONE)
+      return array_edit(values, sparse[slot]) = value;
+    array_edit(sparse, slot) = values.size();
+    slots.push_back(slot);
+    values.push_back(value);
+    return array_edit(values, values.size() - 1);
+  }
+
+  void remove(uint32_t slot)
+  {
+    if (!has(slot))
+      return;
+    uint32_t index = sparse[slot];
+    uint32_t last = values.size() - 1;
+    if (index != last)
+    {
+      array_edit(values, index) = values[last];
+      array_edit(slots, index) = slots[last];
+      array_edit(sparse, slots[index]) = index;
+    }
+    values.pop_back();
+    slots.pop_back();
+    array_edit(sparse, slot) = SLOT_NONE;
+  }
+};
@@ -0,0 +1,44 @@
+#include "picking.h"
+
+void pick_encode_rgba8(uint32_t id, float rgba[4])
+{
+  rgba[0] = ((id >> 0) & 0xFF) / 255.0f;
+  rgba[1] = ((id >> 8) & 0xFF) / 255.0f;
+  rgba[2] = ((id >> 16) & 0xFF) / 255.0f;
+  rgba[3] = 1.0f;
+}
+
+uint32_t pick_decode_rgba8(const uint8_t rgba[4])
+{
+  return rgba[0] | (rgba[1] << 8) | (rgba[2] << 16);
+}
+
+// Bits of the IDs seen by pick_collect_ids
+static std::vector<uint64_t> pickSeen;
+
+void pick_collect_ids(const uint32_t *pixels, int width, int height, size_t stride, uint32_t idLimit, std::vector<uint32_t> &ids)
+{
+  // Comparing with the neighbours first costs more than it saves: small objects make the branches
+  // unpredictable, and setting a bit that is already set is cheap
+  size_t words = idLimit / 64 + 1;
+  pickSeen.assign(words, 0);
+  uint64_t *seen = pickSeen.data();
+  const size_t row = (size_t)width * stride;
+  for (int y = 0; y < height; y++)
+  {
+    const uint32_t *line = pixels + y * row;
+    for (int x = 0; x < width; x++)
+    {
+      uint32_t id = line[x * stride];
+      id = id < idLimit ? id : PICK_NONE;
+      seen[id / 64] |= (uint64_t)1 << (id % 64);
+    }
+  }
+  seen[PICK_NONE / 64] &= ~((uint64_t)1 << (PICK_NONE % 64));
+
+  for (size_t w = 0; w < words; w++)
+  {
+    for (uint64_t bits = pickSeen[w]; bits; bits &= bits - 1)
+      ids.push_back(w * 64 + __builtin_ctzll(bits));
+  }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Draw IDs in the picking target are the object's handle slot + 1, 0 is the background
+#define PICK_NONE 0
+
+// The RGBA8 fallback target holds the low 24 bits of a draw ID as red, green and blue
+#define PICK_RGBA8_MAX_ID 0xFFFFFF
+
+// Normalized color of id for the RGBA8 fallback, exact at any float precision
+void pick_encode_rgba8(uint32_t id, float rgba[4]);
+uint32_t pick_decode_rgba8(const uint8_t rgba[4]);
+
+// Appends the distinct draw IDs other than PICK_NONE below idLimit in a width x height region, pixels
+// stride words apart, to ids in ascending order. Every pixel sets its ID's bit in a bitmap of idLimit
+// bits without a branch, the set bits then come out in order.
+void pick_collect_ids(const uint32_t *pixels, int width, int height, size_t stride, uint32_t idLimit, std::vector<uint32_t> &ids);
@@ -0,0 +1,417 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "raster.h"
+
+// Emscripten only has threads when built with -s USE_PTHREADS=1
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define RASTER_NO_THREADS 1
+#endif
+
+#define RASTER_ONE (1 << RASTER_SUBPIXEL_BITS)
+#define RASTER_HALF (RASTER_ONE / 2)
+
+// Draws set up per task
+#define RASTER_SETUP_CHUNK 1024
+
+// Scratch of raster_draws calls without their own
+static rasterScratch sharedScratch;
+
+static inline int64_t floor_div(int64_t a, int64_t b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int64_t ceil_div(int64_t a, int64_t b)
+{
+  return -floor_div(-a, b);
+}
+
+// Smallest i in [0, limit] where value + step * i >= 0, with step > 0. The division is only a
+// guess, the integer checks make the result exact.
+static inline int64_t span_first(int64_t value, int64_t step, int64_t limit)
+{
+  if (value >= 0)
+    return 0;
+  double guess = ceil(-(double)value / step);
+  int64_t i = guess < limit ? (int64_t)guess : limit;
+  while (i < limit && value + step * i < 0)
+    i++;
+  while (i > 0 && value + step * (i - 1) >= 0)
+    i--;
+  return i;
+}
+
+// Largest i in [-1, limit] where value - step * i >= 0, with step > 0
+static inline int64_t span_last(int64_t value, int64_t step, int64_t limit)
+{
+  if (value < 0)
+    return -1;
+  double guess = floor((double)value / step);
+  int64_t i = guess < limit ? (int64_t)guess : limit;
+  while (i >= 0 && value - step * i < 0)
+    i--;
+  while (i < limit && value - step * (i + 1) >= 0)
+    i++;
+  return i;
+}
+
+static void setup_triangles(const rasterDraw *draws, int first, int last, float scaleX, float scaleY, int width, int height, rasterScratch &scratch)
+{
+  for (int i = first; i < last; i++)
+  {
+    const rasterDraw &draw = draws[i];
+    const float *m = draw.matrix;
+    uint32_t color;
+    memcpy(&color, draw.color, 4);
+
+    for (int v = 0; v + 2 < draw.vertexCount; v += 3)
+    {
+      rasterTriangle &triangle = scratch.triangles[scratch.triangleOffsets[i] + v / 3];
+      triangle.minX = 1;
+      triangle.maxX = 0;
+      bool valid = true;
+      for (int k = 0; k < 3; k++)
+      {
+        float ox = draw.vertices[(v + k) * 2];
+        float oy = draw.vertices[(v + k) * 2 + 1];
+        double px = (m[0] * ox + m[3] * oy + m[6]) * scaleX * RASTER_ONE;
+        double py = (m[1] * ox + m[4] * oy + m[7]) * scaleY * RASTER_ONE;
+        // Edge functions need the products of two coordinates to fit 63 bits, triangles with a
+        // vertex more than 2^21 pixels out are dropped
+        if (!(fabs(px) < (1 << 29) && fabs(py) < (1 << 29)))
+          valid = false;
+        triangle.x[k] = (int64_t)llround(px);
+        triangle.y[k] = (int64_t)llround(py);
+      }
+      if (!valid)
+        continue;
+
+      // vertex_shader_2d flips y, front faces are counter clockwise in window space and so have a
+      // negative area here. Back faces and degenerate triangles are culled like with GL_CULL_FACE.
+      int64_t area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+                     (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+      if (area >= 0)
+        continue;
+      int64_t swapX = triangle.x[1], swapY = triangle.y[1];
+      triangle.x[1] = triangle.x[2];
+      triangle.y[1] = triangle.y[2];
+      triangle.x[2] = swapX;
+      triangle.y[2] = swapY;
+
+      // Pixels are covered when their center is
+      int64_t minX = triangle.x[0], maxX = triangle.x[0], minY = triangle.y[0], maxY = triangle.y[0];
+      for (int k = 1; k < 3; k++)
+      {
+        minX = triangle.x[k] < minX ? triangle.x[k] : minX;
+        maxX = triangle.x[k] > maxX ? triangle.x[k] : maxX;
+        minY = triangle.y[k] < minY ? triangle.y[k] : minY;
+        maxY = triangle.y[k] > maxY ? triangle.y[k] : maxY;
+      }
+      minX = ceil_div(minX - RASTER_HALF, RASTER_ONE);
+      maxX = floor_div(maxX - RASTER_HALF, RASTER_ONE);
+      minY = ceil_div(minY - RASTER_HALF, RASTER_ONE);
+      maxY = floor_div(maxY - RASTER_HALF, RASTER_ONE);
+      if (minX < 0)
+        minX = 0;
+      if (minY < 0)
+        minY = 0;
+      if (maxX > width - 1)
+        maxX = width - 1;
+      if (maxY > height - 1)
+        maxY = height - 1;
+      if (minX > maxX || minY > maxY)
+        continue;
+
+      triangle.minX = minX;
+      triangle.minY = minY;
+      triangle.maxX = maxX;
+      triangle.maxY = maxY;
+      triangle.color = color;
+      triangle.id = draw.id;
+    }
+  }
+}
+
+static void bin_triangles(int tilesX, int tilesY, rasterScratch &scratch)
+{
+  int tileCount = tilesX * tilesY;
+  scratch.binOffsets.assign(tileCount + 1, 0);
+  for (const rasterTriangle &triangle : scratch.triangles)
+  {
+    if (triangle.minX > triangle.maxX)
+      continue;
+    for (int ty = triangle.minY / RASTER_TILE_SIZE; ty <= triangle.maxY / RASTER_TILE_SIZE; ty++)
+      for (int tx = triangle.minX / RASTER_TILE_SIZE; tx <= triangle.maxX / RASTER_TILE_SIZE; tx++)
+        scratch.binOffsets[ty * tilesX + tx + 1]++;
+  }
+  for (int tile = 0; tile < tileCount; tile++)
+    scratch.binOffsets[tile + 1] += scratch.binOffsets[tile];
+
+  scratch.bins.resize(scratch.binOffsets[tileCount]);
+  scratch.binCursors.assign(scratch.binOffsets.begin(), scratch.binOffsets.end() - 1);
+  for (uint32_t index = 0; index < scratch.triangles.size(); index++)
+  {
+    const rasterTriangle &triangle = scratch.triangles[index];
+    if (triangle.minX > triangle.maxX)
+      continue;
+    for (int ty = triangle.minY / RASTER_TILE_SIZE; ty <= triangle.maxY / RASTER_TILE_SIZE; ty++)
+      for (int tx = triangle.minX / RASTER_TILE_SIZE; tx <= triangle.maxX / RASTER_TILE_SIZE; tx++)
+        scratch.bins[scratch.binCursors[ty * tilesX + tx]++] = index;
+  }
+}
+
+// Fills one tile. Triangles are visited winner first and a pixel is only written once, so a tile
+// under heavy overdraw stops as soon as every pixel is covered.
+static void render_tile(int tile, int tilesX, const uint8_t clear[4], bool firstWins, rasterTarget &target, const rasterScratch &scratch)
+{
+  int x0 = (tile % tilesX) * RASTER_TILE_SIZE;
+  int y0 = (tile / tilesX) * RASTER_TILE_SIZE;
+  int x1 = x0 + RASTER_TILE_SIZE < target.width ? x0 + RASTER_TILE_SIZE : target.width;
+  int y1 = y0 + RASTER_TILE_SIZE < target.height ? y0 + RASTER_TILE_SIZE : target.height;
+
+  uint8_t covered[RASTER_TILE_SIZE * RASTER_TILE_SIZE];
+  memset(covered, 0, sizeof(covered));
+  int rowRemaining[RASTER_TILE_SIZE];
+  for (int y = y0; y < y1; y++)
+    rowRemaining[y - y0] = x1 - x0;
+  int remaining = (x1 - x0) * (y1 - y0);
+
+  uint32_t begin = scratch.binOffsets[tile];
+  uint32_t end = scratch.binOffsets[tile + 1];
+  for (uint32_t n = 0; n < end - begin && remaining > 0; n++)
+  {
+    const rasterTriangle &triangle = scratch.triangles[scratch.bins[firstWins ? begin + n : end - 1 - n]];
+    int minX = triangle.minX > x0 ? triangle.minX : x0;
+    int maxX = triangle.maxX < x1 - 1 ? triangle.maxX : x1 - 1;
+    int minY = triangle.minY > y0 ? triangle.minY : y0;
+    int maxY = triangle.maxY < y1 - 1 ? triangle.maxY : y1 - 1;
+
+    // Edge functions at the center of (minX, y), inside when >= 0. Edges that are not top or left
+    // edges lose their pixels to the neighbouring triangle, so shared edges are drawn once.
+    int64_t stepX[3], stepY[3], row[3];
+    int64_t px = (int64_t)minX * RASTER_ONE + RASTER_HALF;
+    int64_t py = (int64_t)minY * RASTER_ONE + RASTER_HALF;
+    for (int e = 0; e < 3; e++)
+    {
+      int a = e;
+      int b = (e + 1) % 3;
+      int64_t dx = triangle.x[b] - triangle.x[a];
+      int64_t dy = triangle.y[b] - triangle.y[a];
+      bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+      stepX[e] = -dy * RASTER_ONE;
+      stepY[e] = dx * RASTER_ONE;
+      row[e] = dx * (py - triangle.y[a]) - dy * (px - triangle.x[a]) - (topLeft ? 0 : 1);
+    }
+
+    for (int y = minY; y <= maxY; y++)
+    {
+      if (rowRemaining[y - y0] == 0)
+      {
+        for (int e = 0; e < 3; e++)
+          row[e] += stepY[e];
+        continue;
+      }
+
+      // Span of the row where all three edge functions are >= 0
+      int64_t first = 0;
+      int64_t last = maxX - minX;
+      for (int e = 0; e < 3; e++)
+      {
+        if (stepX[e] > 0)
+        {
+          int64_t start = span_first(row[e], stepX[e], last + 1);
+          first = start > first ? start : first;
+        }
+        else if (stepX[e] < 0)
+        {
+          int64_t stop = span_last(row[e], -stepX[e], last);
+          last = stop < last ? stop : last;
+        }
+        else if (row[e] < 0)
+          last = -1;
+        row[e] += stepY[e];
+      }
+
+      uint8_t *mask = covered + (y - y0) * RASTER_TILE_SIZE - x0 + minX;
+      size_t pixel = (size_t)y * target.width + minX;
+      for (int64_t i = first; i <= last; i++)
+      {
+        if (mask[i])
+          continue;
+        mask[i] = 1;
+        rowRemaining[y - y0]--;
+        remaining--;
+        if (target.color)
+          memcpy(target.color + (pixel + i) * 4, &triangle.color, 4);
+        if (target.ids)
+          target.ids[pixel + i] = triangle.id;
+      }
+    }
+  }
+
+  if (remaining == 0)
+    return;
+  for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++)
+    {
+      if (covered[(y - y0) * RASTER_TILE_SIZE + x - x0])
+        continue;
+      size_t pixel = (size_t)y * target.width + x;
+      if (target.color)
+        memcpy(target.color + pixel * 4, clear, 4);
+      if (target.ids)
+        target.ids[pixel] = 0;
+    }
+}
+
+// Runs task(0) .. task(count - 1) on up to threads threads, the calling one included
+template <typename Task>
+static void run_parallel(int count, int threads, const Task &task)
+{
+  std::atomic<int> next(0);
+  auto work = [&]() {
+    int index;
+    while ((index = next++) < count)
+      task(index);
+  };
+
+#ifdef RASTER_NO_THREADS
+  threads = 1;
+#endif
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads && i < count; i++)
+    workers.emplace_back(work);
+  work();
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+void raster_draws(const rasterDraw *draws, int count, float resolutionX, float resolutionY, const uint8_t clear[4], bool firstWins, int threads, rasterTarget &target)
+{
+  raster_draws(draws, count, resolutionX, resolutionY, clear, firstWins, threads, target, sharedScratch);
+}
+
+void raster_draws(const rasterDraw *draws, int count, float resolutionX, float resolutionY, const uint8_t clear[4], bool firstWins, int threads, rasterTarget &target, rasterScratch &scratch)
+{
+  if (target.width <= 0 || target.height <= 0)
+    return;
+
+  scratch.triangleOffsets.resize(count + 1);
+  scratch.triangleOffsets[0] = 0;
+  for (int i = 0; i < count; i++)
+    scratch.triangleOffsets[i + 1] = scratch.triangleOffsets[i] + (draws[i].vertexCount > 0 ? draws[i].vertexCount / 3 : 0);
+  scratch.triangles.resize(scratch.triangleOffsets[count]);
+
+  float scaleX = target.width / resolutionX;
+  float scaleY = target.height / resolutionY;
+  run_parallel((count + RASTER_SETUP_CHUNK - 1) / RASTER_SETUP_CHUNK, threads, [&](int chunk) {
+    int first = chunk * RASTER_SETUP_CHUNK;
+    int last = first + RASTER_SETUP_CHUNK < count ? first + RASTER_SETUP_CHUNK : count;
+    setup_triangles(draws, first, last, scaleX, scaleY, target.width, target.height, scratch);
+  });
+
+  int tilesX = (target.width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  int tilesY = (target.height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  bin_triangles(tilesX, tilesY, scratch);
+
+  // Tiles do not share pixels, workers only need to agree on which tile is next
+  run_parallel(tilesX * tilesY, threads, [&](int tile) {
+    render_tile(tile, tilesX, clear, firstWins, target, scratch);
+  });
+}
+
+static uint32_t crc_table[256];
+
+static uint32_t png_crc(const uint8_t *data, size_t length, uint32_t crc)
+{
+  if (crc_table[1] == 0)
+    for (uint32_t n = 0; n < 256; n++)
+    {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      crc_table[n] = c;
+    }
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+    crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void png_u32(std::vector<uint8_t> &out, uint32_t value)
+{
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+static void png_chunk(std::vector<uint8_t> &png, const char *type, const std::vector<uint8_t> &data)
+{
+  png_u32(png, data.size());
+  size_t start = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  png_u32(png, png_crc(png.data() + start, png.size() - start, 0));
+}
+
+void raster_encode_png(const uint8_t *rgba, int width, int height, std::vector<uint8_t> &png)
+{
+  static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  png.assign(signature, signature + 8);
+
+  std::vector<uint8_t> header;
+  png_u32(header, width);
+  png_u32(header, height);
+  // 8 bits per channel, RGBA, deflate, no filtering, not interlaced
+  const uint8_t format[5] = {8, 6, 0, 0, 0};
+  header.insert(header.end(), format, format + 5);
+  png_chunk(png, "IHDR", header);
+
+  // Every row starts with filter type 0, then goes into stored deflate blocks
+  size_t rowBytes = (size_t)width * 4 + 1;
+  std::vector<uint8_t> raw(rowBytes * height);
+  for (int y = 0; y < height; y++)
+  {
+    raw[y * rowBytes] = 0;
+    memcpy(&raw[y * rowBytes + 1], rgba + (size_t)y * width * 4, width * 4);
+  }
+
+  std::vector<uint8_t> data;
+  data.reserve(raw.size() + (raw.size() / 65535 + 1) * 5 + 6);
+  data.push_back(0x78);
+  data.push_back(0x01);
+  size_t written = 0;
+  do
+  {
+    size_t length = raw.size() - written < 65535 ? raw.size() - written : 65535;
+    data.push_back(written + length == raw.size() ? 1 : 0);
+    data.push_back(length & 0xff);
+    data.push_back(length >> 8);
+    data.push_back(~length & 0xff);
+    data.push_back((~length >> 8) & 0xff);
+    data.insert(data.end(), raw.begin() + written, raw.begin() + written + length);
+    written += length;
+  } while (written < raw.size());
+
+  // Adler-32, the sums fit 32 bits for 5552 bytes between reductions
+  uint32_t adlerA = 1, adlerB = 0;
+  for (size_t i = 0; i < raw.size();)
+  {
+    size_t stop = raw.size() - i < 5552 ? raw.size() : i + 5552;
+    for (; i < stop; i++)
+    {
+      adlerA += raw[i];
+      adlerB += adlerA;
+    }
+    adlerA %= 65521;
+    adlerB %= 65521;
+  }
+  png_u32(data, adlerB << 16 | adlerA);
+  png_chunk(png, "IDAT", data);
+  png_chunk(png, "IEND", std::vector<uint8_t>());
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Software rasterizer for headless rendering of the draw list, no GL needed.
+// Pixels are binned into RASTER_TILE_SIZE square tiles that are filled in parallel.
+#define RASTER_TILE_SIZE 64
+
+// Vertex positions carry this many bits of sub-pixel precision
+#define RASTER_SUBPIXEL_BITS 8
+
+// One draw of the list: triangles in object space (x,y pairs) taken through u_matrix
+// (3x3, column major) into u_resolution pixel space like vertex_shader_2d does
+struct rasterDraw
+{
+  const float *vertices;
+  int vertexCount;
+  float matrix[9];
+  uint8_t color[4];
+  uint32_t id;
+};
+
+struct rasterTarget
+{
+  int width;
+  int height;
+  // width * height RGBA, first row at the top. Either buffer may be null.
+  uint8_t *color;
+  // width * height draw ids, 0 where nothing was drawn
+  uint32_t *ids;
+};
+
+// Triangle after setup, vertices in fixed point pixels, counter clockwise in y-down space
+struct rasterTriangle
+{
+  int64_t x[3];
+  int64_t y[3];
+  // Pixels whose center may be covered, inclusive and inside the target
+  int minX, minY, maxX, maxY;
+  uint32_t color;
+  uint32_t id;
+};
+
+// Working memory of raster_draws, kept between calls
+struct rasterScratch
+{
+  // Triangles of draw i start at triangleOffsets[i], culled ones are left with an empty box
+  std::vector<rasterTriangle> triangles;
+  std::vector<uint32_t> triangleOffsets;
+  // Triangle indices per tile in draw order, tile t owns bins[binOffsets[t]..binOffsets[t + 1])
+  std::vector<uint32_t> binOffsets;
+  std::vector<uint32_t> binCursors;
+  std::vector<uint32_t> bins;
+};
+
+// Rasterizes count draws into target, the u_resolution space is scaled to the target size.
+// Like the GL pipeline back faces are culled and colors are written without blending. With
+// firstWins the first draw covering a pixel keeps it, which is what the depth test does when every
+// draw is at the same depth, otherwise the last one does. threads <= 1 renders on the calling thread.
+// Calls without a scratch of their own share one and have to come from one thread at a time.
+void raster_draws(const rasterDraw *draws, int count, float resolutionX, float resolutionY, const uint8_t clear[4], bool firstWins, int threads, rasterTarget &target);
+void raster_draws(const rasterDraw *draws, int count, float resolutionX, float resolutionY, const uint8_t clear[4], bool firstWins, int threads, rasterTarget &target, rasterScratch &scratch);
+
+// Encodes RGBA pixels, first row at the top, into an uncompressed PNG
+void raster_encode_png(const uint8_t *rgba, int width, int height, std::vector<uint8_t> &png);
@@ -0,0 +1,16 @@
+#pragma once
+// Native stand-in for the parts of the Emscripten API the scene uses, see platform.cpp
+
+#define EMSCRIPTEN_KEEPALIVE
+#define EM_ASM(...) ((void)0)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  double emscripten_get_now(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,246 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <GLES3/gl3.h>
+#include "emscripten.h"
+#include "emscripten/html5.h"
+#include "platform.h"
+
+// ------ Emscripten
+
+double emscripten_get_now(void)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void emscripten_webgl_init_context_attributes(EmscriptenWebGLContextAttributes *attributes)
+{
+  memset(attributes, 0, sizeof(*attributes));
+}
+
+EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_create_context(const char *target, const EmscriptenWebGLContextAttributes *attributes)
+{
+  return 1;
+}
+
+EMSCRIPTEN_RESULT emscripten_webgl_make_context_current(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context)
+{
+  return 0;
+}
+
+EMSCRIPTEN_RESULT emscripten_set_element_css_size(const char *target, double width, double height)
+{
+  return 0;
+}
+
+EMSCRIPTEN_RESULT emscripten_set_canvas_element_size(const char *target, int width, int height)
+{
+  return 0;
+}
+
+double emscripten_get_device_pixel_ratio(void)
+{
+  return 1;
+}
+
+// ------ Allocations, counted for everything going through operator new
+
+static uint64_t allocations = 0;
+static uint64_t allocatedBytes = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  allocatedBytes += size;
+  void *pointer = malloc(size ? size : 1);
+  if (!pointer)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+// Both sides are malloc and free. GCC inlines these into code that got its pointer from operator
+// new and takes that for a mismatch, so the warning is off for the replacements only.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+uint64_t allocation_count()
+{
+  return allocations;
+}
+
+uint64_t allocation_bytes()
+{
+  return allocatedBytes;
+}
+
+// ------ Null GL: every call is counted and does nothing. Reads return zeros, so nothing is picked.
+
+#define GL_MAX_COUNTERS 128
+
+static glCallCounter glCounters[GL_MAX_COUNTERS];
+static int glCounterCount = 0;
+static uint64_t glTotal = 0;
+static GLuint nextName = 1;
+
+static int gl_counter(const char *name)
+{
+  glCounters[glCounterCount] = {name, 0};
+  return glCounterCount++;
+}
+
+#define COUNT_GL_CALL()                           \
+  do                                              \
+  {                                               \
+    static const int slot = gl_counter(__func__); \
+    glCounters[slot].calls++;                     \
+    glTotal++;                                    \
+  } while (0)
+
+const glCallCounter *gl_call_counters(int *count)
+{
+  *count = glCounterCount;
+  return glCounters;
+}
+
+uint64_t gl_call_total()
+{
+  return glTotal;
+}
+
+void reset_counters()
+{
+  for (int i = 0; i < glCounterCount; i++)
+    glCounters[i].calls = 0;
+  glTotal = 0;
+  allocations = 0;
+  allocatedBytes = 0;
+}
+
+extern "C"
+{
+  void glAttachShader(GLuint program, GLuint shader) { COUNT_GL_CALL(); }
+  void glBindAttribLocation(GLuint program, GLuint index, const GLchar *name) { COUNT_GL_CALL(); }
+  void glBindBuffer(GLenum target, GLuint buffer) { COUNT_GL_CALL(); }
+  void glBindFramebuffer(GLenum target, GLuint framebuffer) { COUNT_GL_CALL(); }
+  void glBindRenderbuffer(GLenum target, GLuint renderbuffer) { COUNT_GL_CALL(); }
+  void glBindTexture(GLenum target, GLuint texture) { COUNT_GL_CALL(); }
+  void glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) { COUNT_GL_CALL(); }
+  void glClear(GLbitfield mask) { COUNT_GL_CALL(); }
+  void glClearBufferuiv(GLenum buffer, GLint drawbuffer, const GLuint *value) { COUNT_GL_CALL(); }
+  void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { COUNT_GL_CALL(); }
+  void glCompileShader(GLuint shader) { COUNT_GL_CALL(); }
+  void glDisable(GLenum cap) { COUNT_GL_CALL(); }
+  void glDrawArrays(GLenum mode, GLint first, GLsizei count) { COUNT_GL_CALL(); }
+  void glEnable(GLenum cap) { COUNT_GL_CALL(); }
+  void glEnableVertexAttribArray(GLuint index) { COUNT_GL_CALL(); }
+  void glFinish(void) { COUNT_GL_CALL(); }
+  void glFlush(void) { COUNT_GL_CALL(); }
+  void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) { COUNT_GL_CALL(); }
+  void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) { COUNT_GL_CALL(); }
+  void glLinkProgram(GLuint program) { COUNT_GL_CALL(); }
+  void glPixelStorei(GLenum pname, GLint param) { COUNT_GL_CALL(); }
+  void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) { COUNT_GL_CALL(); }
+  void glScissor(GLint x, GLint y, GLsizei width, GLsizei height) { COUNT_GL_CALL(); }
+  void glShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length) { COUNT_GL_CALL(); }
+  void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels) { COUNT_GL_CALL(); }
+  void glTexParameteri(GLenum target, GLenum pname, GLint param) { COUNT_GL_CALL(); }
+  void glUniform1ui(GLint location, GLuint v0) { COUNT_GL_CALL(); }
+  void glUniform2f(GLint location, GLfloat v0, GLfloat v1) { COUNT_GL_CALL(); }
+  void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { COUNT_GL_CALL(); }
+  void glUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { COUNT_GL_CALL(); }
+  void glUseProgram(GLuint program) { COUNT_GL_CALL(); }
+  void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) { COUNT_GL_CALL(); }
+  void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) { COUNT_GL_CALL(); }
+
+  GLuint glCreateShader(GLenum type)
+  {
+    COUNT_GL_CALL();
+    return nextName++;
+  }
+
+  GLuint glCreateProgram(void)
+  {
+    COUNT_GL_CALL();
+    return nextName++;
+  }
+
+  void glGenBuffers(GLsizei n, GLuint *buffers)
+  {
+    COUNT_GL_CALL();
+    for (int i = 0; i < n; i++)
+      buffers[i] = nextName++;
+  }
+
+  void glGenFramebuffers(GLsizei n, GLuint *framebuffers)
+  {
+    COUNT_GL_CALL();
+    for (int i = 0; i < n; i++)
+      framebuffers[i] = nextName++;
+  }
+
+  void glGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+  {
+    COUNT_GL_CALL();
+    for (int i = 0; i < n; i++)
+      renderbuffers[i] = nextName++;
+  }
+
+  void glGenTextures(GLsizei n, GLuint *textures)
+  {
+    COUNT_GL_CALL();
+    for (int i = 0; i < n; i++)
+      textures[i] = nextName++;
+  }
+
+  GLint glGetAttribLocation(GLuint program, const GLchar *name)
+  {
+    COUNT_GL_CALL();
+    return 0;
+  }
+
+  GLint glGetUniformLocation(GLuint program, const GLchar *name)
+  {
+    COUNT_GL_CALL();
+    return nextName++;
+  }
+
+  void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+  {
+    COUNT_GL_CALL();
+    // RGBA / UNSIGNED_BYTE or, from the picking target, RGBA_INTEGER / UNSIGNED_INT
+    memset(pixels, 0, (size_t)width * height * (type == GL_UNSIGNED_INT ? 16 : 4));
+  }
+}
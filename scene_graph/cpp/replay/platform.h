@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Counters kept by the native platform while the scene runs
+struct glCallCounter
+{
+  const char *name;
+  uint64_t calls;
+};
+
+// One counter per GL function called so far, in first call order
+const glCallCounter *gl_call_counters(int *count);
+uint64_t gl_call_total();
+
+uint64_t allocation_count();
+uint64_t allocation_bytes();
+
+// Starts all counters from zero
+void reset_counters();
@@ -0,0 +1,130 @@
+// Native replay driver: runs a trace recorded with startRecording/stopRecording through the scene
+// code at full speed, on a null GL that only counts calls, and reports per-frame CPU time.
+//
+//   g++ -O2 -std=c++1z -pthread -Icpp/replay cpp/replay/replay.cpp -o replay
+//   ./replay session.trace
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <vector>
+#include "../webgl.cpp"
+#include "../commands.cpp"
+#include "../trace.cpp"
+#include "platform.cpp"
+
+// Canvas size of the scene_graph app, used when the trace starts after init
+#define REPLAY_DEFAULT_WIDTH 500
+#define REPLAY_DEFAULT_HEIGHT 500
+
+static bool read_trace(const char *path, std::vector<uint32_t> &words)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  words.resize(size / sizeof(uint32_t));
+  size_t read = fread(words.data(), sizeof(uint32_t), words.size(), file);
+  fclose(file);
+  return read == words.size();
+}
+
+static double percentile(const std::vector<double> &sorted, double fraction)
+{
+  if (sorted.empty())
+    return 0;
+  size_t rank = (size_t)(fraction * sorted.size());
+  return sorted[rank < sorted.size() ? rank : sorted.size() - 1];
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <trace>\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<uint32_t> words;
+  if (!read_trace(argv[1], words))
+  {
+    fprintf(stderr, "can't read %s\n", argv[1]);
+    return 1;
+  }
+  int position = trace_begin(words.data(), words.size());
+  if (position < 0)
+  {
+    fprintf(stderr, "%s is not a version %d to %d trace\n", argv[1], TRACE_MIN_VERSION, TRACE_VERSION);
+    return 1;
+  }
+
+  // The scene logs every frame, keep that out of the report and the timings
+  fflush(stdout);
+  int console = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+
+  if (position < (int)words.size() && words[position] != TRACE_INIT)
+    webgl_init(REPLAY_DEFAULT_WIDTH, REPLAY_DEFAULT_HEIGHT);
+
+  // Records that redraw are frames, the others are timed on their own
+  std::vector<double> frameTimes;
+  frameTimes.reserve(words.size() / 3);
+  int otherCalls = 0;
+  double otherTime = 0;
+  reset_counters();
+  uint32_t traceTime = 0;
+  while (position < (int)words.size())
+  {
+    bool draws = trace_draws(words[position]);
+    double start = emscripten_get_now();
+    position = trace_replay(words.data(), words.size(), position, &traceTime);
+    if (position < 0)
+      break;
+    double time = emscripten_get_now() - start;
+    if (draws)
+      frameTimes.push_back(time);
+    else
+    {
+      otherCalls++;
+      otherTime += time;
+    }
+  }
+  uint64_t glCalls = gl_call_total();
+  uint64_t allocations = allocation_count();
+  uint64_t allocatedBytes = allocation_bytes();
+
+  fflush(stdout);
+  dup2(console, STDOUT_FILENO);
+  close(null);
+  close(console);
+
+  if (position < 0)
+    printf("[REPLAY] trace is truncated or corrupt after %d frames\n", (int)frameTimes.size());
+
+  int frames = frameTimes.size();
+  double total = 0;
+  for (double time : frameTimes)
+    total += time;
+  std::vector<double> sorted = frameTimes;
+  std::sort(sorted.begin(), sorted.end());
+
+  printf("[REPLAY] %d frames, %.1f s recorded, %.3f ms replayed\n", frames, traceTime / 1e6, total);
+  printf("[REPLAY] frame CPU ms  mean %.4f  p50 %.4f  p90 %.4f  p99 %.4f  max %.4f\n",
+         frames ? total / frames : 0, percentile(sorted, 0.5), percentile(sorted, 0.9), percentile(sorted, 0.99), sorted.empty() ? 0 : sorted.back());
+  printf("[REPLAY] %d calls that don't redraw, %.3f ms\n", otherCalls, otherTime);
+  printf("[REPLAY] GL calls      %llu, %.1f per frame\n", (unsigned long long)glCalls, frames ? (double)glCalls / frames : 0);
+  printf("[REPLAY] allocations   %llu (%llu bytes), %.2f per frame\n", (unsigned long long)allocations, (unsigned long long)allocatedBytes, frames ? (double)allocations / frames : 0);
+
+  int counterCount;
+  const glCallCounter *counters = gl_call_counters(&counterCount);
+  std::vector<glCallCounter> byCalls(counters, counters + counterCount);
+  std::sort(byCalls.begin(), byCalls.end(), [](const glCallCounter &a, const glCallCounter &b) { return a.calls > b.calls; });
+  for (const glCallCounter &counter : byCalls)
+    if (counter.calls > 0)
+      printf("[REPLAY]   %-26s %llu\n", counter.name, (unsigned long long)counter.calls);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "raster.h"
+
+// Copy-on-write snapshots of the scene's objects, taken and restored by ID through take_snapshot and
+// co. in webgl.h. A snapshot shares its chunks with the scene and with the other snapshots, see
+// chunked_array.h, and is read only.
+struct sceneSnapshot;
+
+// The snapshot behind an ID, NULL for an unknown one. Holding it keeps the snapshot readable after
+// release_snapshot, a worker takes it on the main thread and reads it while the scene is edited.
+std::shared_ptr<const sceneSnapshot> find_snapshot(uint32_t id);
+
+// Buffers of one snapshot_render caller
+struct snapshotRender
+{
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> order;
+  std::vector<uint64_t> keysScratch;
+  std::vector<uint32_t> orderScratch;
+  std::vector<rasterDraw> draws;
+  rasterScratch scratch;
+  // width * height RGBA and, when asked for, draw IDs
+  std::vector<uint8_t> color;
+  std::vector<uint32_t> ids;
+  int width = 0;
+  int height = 0;
+};
+
+// The canvas pass of scene on the CPU, like render_software, with u_resolution resolutionX x
+// resolutionY. Reads nothing but scene and writes nothing but out, so any thread can render a
+// snapshot it holds while the main thread keeps editing.
+void snapshot_render(const sceneSnapshot &scene, int width, int height, float resolutionX, float resolutionY, int threads, bool ids, snapshotRender &out);
@@ -0,0 +1,221 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include <emscripten.h>
+#include "trace.h"
+#include "commands.h"
+#include "webgl.h"
+
+static std::vector<uint32_t> traceWords;
+static bool recording = false;
+static double recordingStart = 0;
+
+// Number of argument words following type and time, TRACE_APPLY_COMMANDS adds its payload
+static const int traceArguments[] = {
+    0, // unused
+    2, // TRACE_INIT
+    2, // TRACE_UPDATE_TRANSLATION
+    1, // TRACE_UPDATE_ROTATION
+    2, // TRACE_UPDATE_SCALE
+    2, // TRACE_UPDATE_MOUSE
+    1, // TRACE_APPLY_COMMANDS
+    1, // TRACE_CREATE_OBJECTS
+    1, // TRACE_ANIMATE
+    1, // TRACE_TAKE_SNAPSHOT
+    1, // TRACE_RESTORE_SNAPSHOT
+    1, // TRACE_RELEASE_SNAPSHOT
+    1, // TRACE_SET_PARTIAL_REDRAW
+    4, // TRACE_RENDER_SOFTWARE
+    4, // TRACE_PICK_REGION
+    5, // TRACE_RENDER_SNAPSHOT
+};
+
+// Whether replaying a record redraws the canvas. Picking redraws only when objects changed since
+// the last frame and software renders don't touch the canvas.
+static const bool traceDraws[] = {
+    false, // unused
+    true,  // TRACE_INIT
+    true,  // TRACE_UPDATE_TRANSLATION
+    true,  // TRACE_UPDATE_ROTATION
+    true,  // TRACE_UPDATE_SCALE
+    true,  // TRACE_UPDATE_MOUSE
+    true,  // TRACE_APPLY_COMMANDS
+    false, // TRACE_CREATE_OBJECTS
+    true,  // TRACE_ANIMATE
+    false, // TRACE_TAKE_SNAPSHOT
+    true,  // TRACE_RESTORE_SNAPSHOT
+    false, // TRACE_RELEASE_SNAPSHOT
+    false, // TRACE_SET_PARTIAL_REDRAW
+    false, // TRACE_RENDER_SOFTWARE
+    false, // TRACE_PICK_REGION
+    false, // TRACE_RENDER_SNAPSHOT
+};
+
+// Recorded snapshot ID -> the one the replay took in its place
+static std::unordered_map<uint32_t, uint32_t> replayedSnapshots;
+
+void trace_start()
+{
+  traceWords.clear();
+  traceWords.push_back(TRACE_MAGIC);
+  traceWords.push_back(TRACE_VERSION);
+  recording = true;
+  recordingStart = emscripten_get_now();
+}
+
+void trace_stop()
+{
+  recording = false;
+}
+
+int trace_recording()
+{
+  return recording;
+}
+
+static void record_header(uint32_t type)
+{
+  traceWords.push_back(type);
+  traceWords.push_back((uint32_t)((emscripten_get_now() - recordingStart) * 1000));
+}
+
+void trace_record(uint32_t type, int32_t a, int32_t b)
+{
+  const int32_t args[] = {a, b, 0, 0};
+  if (type < TRACE_TYPE_END && traceArguments[type] <= 2)
+    trace_record_args(type, args);
+}
+
+void trace_record_args(uint32_t type, const int32_t *args)
+{
+  if (!recording || type < TRACE_INIT || type == TRACE_APPLY_COMMANDS || type >= TRACE_TYPE_END)
+    return;
+  record_header(type);
+  traceWords.insert(traceWords.end(), args, args + traceArguments[type]);
+}
+
+void trace_record_commands(const uint32_t *words, int length)
+{
+  if (!recording || length < 0)
+    return;
+  int wordCount = length / sizeof(uint32_t);
+  if (wordCount > (int)(COMMAND_BUFFER_SIZE / sizeof(uint32_t)))
+    wordCount = COMMAND_BUFFER_SIZE / sizeof(uint32_t);
+  record_header(TRACE_APPLY_COMMANDS);
+  traceWords.push_back(wordCount * sizeof(uint32_t));
+  traceWords.insert(traceWords.end(), words, words + wordCount);
+}
+
+const uint32_t *trace_data()
+{
+  return traceWords.data();
+}
+
+int trace_size()
+{
+  return traceWords.size() * sizeof(uint32_t);
+}
+
+int trace_draws(uint32_t type)
+{
+  return type < TRACE_TYPE_END && traceDraws[type];
+}
+
+int trace_begin(const uint32_t *words, int wordCount)
+{
+  if (wordCount < TRACE_HEADER_WORDS || words[0] != TRACE_MAGIC || words[1] < TRACE_MIN_VERSION || words[1] > TRACE_VERSION)
+    return -1;
+  return TRACE_HEADER_WORDS;
+}
+
+int trace_replay(const uint32_t *words, int wordCount, int position, uint32_t *time)
+{
+  if (position < 0 || position + 2 > wordCount)
+    return -1;
+  uint32_t type = words[position];
+  if (type < TRACE_INIT || type >= TRACE_TYPE_END)
+    return -1;
+  int next = position + 2 + traceArguments[type];
+  if (next > wordCount)
+    return -1;
+
+  *time = words[position + 1];
+  const int32_t *args = (const int32_t *)(words + position + 2);
+  switch (type)
+  {
+  case TRACE_INIT:
+    webgl_init(args[0], args[1]);
+    break;
+  case TRACE_UPDATE_TRANSLATION:
+    update_translation(args[0], args[1]);
+    break;
+  case TRACE_UPDATE_ROTATION:
+    update_rotation(args[0]);
+    break;
+  case TRACE_UPDATE_SCALE:
+    update_scale(args[0], args[1]);
+    break;
+  case TRACE_UPDATE_MOUSE:
+    update_mouse(args[0], args[1]);
+    break;
+  case TRACE_APPLY_COMMANDS:
+  {
+    int length = args[0];
+    int commandWords = length / sizeof(uint32_t);
+    if (length < 0 || commandWords > (int)(COMMAND_BUFFER_SIZE / sizeof(uint32_t)) || next + commandWords > wordCount)
+      return -1;
+    memcpy(command_buffer(), words + next, commandWords * sizeof(uint32_t));
+    apply_commands(length);
+    next += commandWords;
+    break;
+  }
+  case TRACE_CREATE_OBJECTS:
+    create_objects(args[0]);
+    break;
+  case TRACE_ANIMATE:
+  {
+    float delta;
+    memcpy(&delta, args, sizeof(delta));
+    update_animations(delta);
+    break;
+  }
+  case TRACE_TAKE_SNAPSHOT:
+    replayedSnapshots[args[0]] = take_snapshot();
+    break;
+  case TRACE_RESTORE_SNAPSHOT:
+  {
+    auto found = replayedSnapshots.find(args[0]);
+    if (found != replayedSnapshots.end() && restore_snapshot(found->second))
+      draw_scene();
+    break;
+  }
+  case TRACE_RELEASE_SNAPSHOT:
+  {
+    auto found = replayedSnapshots.find(args[0]);
+    if (found != replayedSnapshots.end())
+    {
+      release_snapshot(found->second);
+      replayedSnapshots.erase(found);
+    }
+    break;
+  }
+  case TRACE_SET_PARTIAL_REDRAW:
+    set_partial_redraw(args[0]);
+    break;
+  case TRACE_RENDER_SOFTWARE:
+    render_software(args[0], args[1], args[2], args[3]);
+    break;
+  case TRACE_PICK_REGION:
+    pick_region(args[0], args[1], args[2], args[3]);
+    break;
+  case TRACE_RENDER_SNAPSHOT:
+  {
+    auto found = replayedSnapshots.find(args[0]);
+    if (found != replayedSnapshots.end())
+      render_snapshot(found->second, args[1], args[2], args[3], args[4]);
+    break;
+  }
+  }
+  return next;
+}
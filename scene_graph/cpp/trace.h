@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+
+// Trace layout: a header of TRACE_MAGIC and TRACE_VERSION, then one record per exported call.
+// All fields are 32-bit little endian words:
+//   type, time (microseconds since recording started, wraps after 71 minutes), arguments...
+//   TRACE_INIT                width, height
+//   TRACE_UPDATE_TRANSLATION  x, y
+//   TRACE_UPDATE_ROTATION     angle
+//   TRACE_UPDATE_SCALE        x, y
+//   TRACE_UPDATE_MOUSE        x, y
+//   TRACE_APPLY_COMMANDS      length (bytes), then the command words
+//   TRACE_CREATE_OBJECTS      count
+//   TRACE_ANIMATE             delta (milliseconds, float32)
+//   TRACE_TAKE_SNAPSHOT       snapshot ID
+//   TRACE_RESTORE_SNAPSHOT    snapshot ID
+//   TRACE_RELEASE_SNAPSHOT    snapshot ID
+//   TRACE_SET_PARTIAL_REDRAW  enabled
+//   TRACE_RENDER_SOFTWARE     width, height, threads, ids
+//   TRACE_PICK_REGION         x1, y1, x2, y2
+//   TRACE_RENDER_SNAPSHOT     snapshot ID, width, height, threads, ids
+// Handles are allocated deterministically, replaying the creates hands out the recorded ones again.
+// Snapshot IDs are not, the replay maps the recorded IDs to its own. Snapshots taken before the
+// recording started are unknown to the replay, their restores and renders do nothing.
+#define TRACE_MAGIC 0x52544753 // "SGTR"
+#define TRACE_VERSION 6
+// Older traces lack the record types added since and replay as they are
+#define TRACE_MIN_VERSION 2
+#define TRACE_HEADER_WORDS 2
+
+enum traceType
+{
+  TRACE_INIT = 1,
+  TRACE_UPDATE_TRANSLATION = 2,
+  TRACE_UPDATE_ROTATION = 3,
+  TRACE_UPDATE_SCALE = 4,
+  TRACE_UPDATE_MOUSE = 5,
+  TRACE_APPLY_COMMANDS = 6,
+  TRACE_CREATE_OBJECTS = 7,
+  TRACE_ANIMATE = 8,
+  TRACE_TAKE_SNAPSHOT = 9,
+  TRACE_RESTORE_SNAPSHOT = 10,
+  TRACE_RELEASE_SNAPSHOT = 11,
+  TRACE_SET_PARTIAL_REDRAW = 12,
+  TRACE_RENDER_SOFTWARE = 13,
+  TRACE_PICK_REGION = 14,
+  TRACE_RENDER_SNAPSHOT = 15,
+  // One past the last type
+  TRACE_TYPE_END
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Starts a new trace, dropping the previous one
+  void trace_start();
+  void trace_stop();
+  int trace_recording();
+
+  // Appends a call while recording. Unused arguments are ignored.
+  void trace_record(uint32_t type, int32_t a, int32_t b);
+  // For calls with more than two arguments, args holds as many as the type has
+  void trace_record_args(uint32_t type, const int32_t *args);
+  void trace_record_commands(const uint32_t *words, int length);
+
+  // The trace so far, valid until the next trace_start or record
+  const uint32_t *trace_data();
+  int trace_size();
+
+  // Whether a record of type redraws the canvas when replayed, which makes it a frame
+  int trace_draws(uint32_t type);
+
+  // Checks the header, returns the position of the first record or -1
+  int trace_begin(const uint32_t *words, int wordCount);
+
+  // Replays the record at position through the same functions the exports call. Returns the
+  // position of the next record, or -1 at a truncated or unknown record. time receives its timestamp.
+  int trace_replay(const uint32_t *words, int wordCount, int position, uint32_t *time);
+
+#ifdef __cplusplus
+}
+#endif
@@ -45,7 +45,7 @@ void matrix_multiply(float mat1[9],
   res[5] = b10 * a02 + b11 * a12 + b12 * a22;
   res[6] = b20 * a00 + b21 * a10 + b22 * a20;
   res[7] = b20 * a01 + b21 * a11 + b22 * a21;
-  res[9] = b20 * a02 + b21 * a12 + b22 * a22;
+  res[8] = b20 * a02 + b21 * a12 + b22 * a22;
 }
 
 void matrix_identity(float res[9])
@@ -1,18 +1,34 @@
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <emscripten.h>
 #include <emscripten/html5.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <unordered_map>
 #include "webgl.h"
+#include "snapshot.h"
 #include "utils.cpp"
+#include "draw_order.cpp"
+#include "raster.cpp"
+#include "damage.cpp"
+#include "picking.cpp"
+#include "object_store.cpp"
+#include "animation.cpp"
+#include "../../common/cpp/memory_accounting.cpp"
+
+#define INITIAL_OBJECTS_COUNT 3
+#define RECTANGLE_MESH 0
+#define NO_MESH ((GLuint)-1)
 
 static EMSCRIPTEN_WEBGL_CONTEXT_HANDLE glContext;
 static int canvasHeight;
 static int canvasWidth;
 static GLuint renderBuffer;
 static GLuint frameBuffer;
+// WebGL 2 picks into an R32UI target, WebGL 1 into RGBA8 with 24-bit IDs
+static bool integerPicking;
 static GLuint objectProgram;
 static GLuint objectVertexShader;
 static GLuint objectFragmentShader;
@@ -20,31 +36,40 @@ static GLuint pickingProgram;
 static GLuint pickingTexture;
 static GLuint pickingVertexShader;
 static GLuint pickingFragmentShader;
-static GLint positionLocation;
-static GLint resolutionLocation;
-static GLint colorLocation;
-static GLint matrixLocation;
-static GLint idLocation;
+
+// Uniform and attribute locations, looked up per program as they needn't agree between programs
+struct programLocations
+{
+  GLint position;
+  GLint resolution;
+  GLint matrix;
+  GLint color;
+  GLint id;
+};
+static programLocations objectLocations;
+static programLocations pickingLocations;
 static GLuint positionBuffer;
-int oldPickNdx = -1;
+// GPU bytes of the position buffer's last upload and of the picking color and depth targets
+static int64_t positionBytes = 0;
+static int64_t pickingBytes = 0;
+// Object under the mouse and its color before the highlight
+objectHandle highlighted = HANDLE_NONE;
 GLfloat oldPickColor[4] = {0, 0, 0, 0};
 GLfloat translation[2] = {200, 200};
 GLfloat rotation[2] = {0, 1};
 GLfloat scale[2] = {100, 100};
 GLfloat mouse[2] = {-1, -1};
 
-struct objectUniforms
+struct transformComponent
 {
-  GLfloat u_color[4];
-  GLfloat u_matrix[9];
-  GLfloat u_id[4];
   GLfloat translation[2];
   GLfloat rotation[2];
   GLfloat scale[2];
 };
-struct object
+
+struct colorComponent
 {
-  objectUniforms uniforms;
+  GLfloat rgba[4];
 };
 
 struct objectBufferInfo
@@ -72,15 +97,61 @@ objectBufferInfo rectangleBufferInfo = {
     .usage = GL_STATIC_DRAW,
 };
 
-struct objectToDraw
+// How an object is drawn
+struct meshComponent
 {
   GLuint programInfo;
-  objectBufferInfo bufferInfo;
-  objectUniforms *uniforms;
+  objectBufferInfo *bufferInfo;
+  GLuint mesh;
+  GLuint texture;
+  GLuint layer;
+  GLfloat depth;
+  // Creation order, ties between equal sort keys are drawn in it
+  uint32_t sequence;
 };
 
-object objects[3];
-objectToDraw objectsToDraw[3];
+// Objects are addressed by generational handle, their components live in sparse sets indexed by
+// the handle's slot. Every object has one of each. The pools are chunked so snapshots share them,
+// read them with read, get copies a shared chunk.
+static handleTable objectHandles;
+static componentPool<transformComponent, chunkedArray> transforms;
+static componentPool<colorComponent, chunkedArray> colors;
+static componentPool<meshComponent, chunkedArray> meshes;
+// Draw ID in the picking target, slot + 1
+static componentPool<GLuint, chunkedArray> pickIds;
+// The first object webgl_init creates, the one update_translation and co. move
+static objectHandle primaryObject = HANDLE_NONE;
+// Handles from the last create_objects
+static std::vector<objectHandle> createdObjects;
+// meshComponent::sequence of the next object
+static uint32_t nextSequence = 0;
+
+// Keyframe curves by channel and the clock they run on, in milliseconds
+static animationCurves animations[ANIMATION_CHANNELS] = {
+    {.components = animationComponents[ANIMATE_TRANSLATION]},
+    {.components = animationComponents[ANIMATE_ROTATION]},
+    {.components = animationComponents[ANIMATE_SCALE]},
+    {.components = animationComponents[ANIMATE_COLOR]},
+};
+static double animationClock = 0;
+static std::vector<float> animationSines;
+static std::vector<float> animationCosines;
+
+// Per-frame draw order as slots, rebuilt from the sort keys before each pass
+static std::vector<uint64_t> drawKeys;
+static std::vector<uint32_t> drawOrder;
+static std::vector<uint64_t> drawKeysScratch;
+static std::vector<uint32_t> drawOrderScratch;
+int drawCount = 0;
+
+// Screen bounds of each slot's object as last drawn. Changed objects are queued and turned into
+// damage, the union of their old and new bounds, when the next frame starts.
+static std::vector<screenRect> objectBounds;
+static std::vector<uint8_t> objectDamaged;
+static std::vector<uint32_t> damagedObjects;
+static damageList damage = {.count = 0, .full = true};
+// Off to redraw every frame in full, e.g. to compare in benchmarks
+static bool partialRedraw = true;
 
 static GLuint
 compile_shader(GLenum shaderType, const char *src)
@@ -108,8 +179,27 @@ void clear_screen(float r, float g, float b, float a)
   glClear(GL_COLOR_BUFFER_BIT);
 }
 
+static const programLocations &locations_for(GLuint program)
+{
+  return program == pickingProgram ? pickingLocations : objectLocations;
+}
+
+static programLocations find_locations(GLuint program)
+{
+  return {
+      .position = glGetAttribLocation(program, "a_position"),
+      .resolution = glGetUniformLocation(program, "u_resolution"),
+      .matrix = glGetUniformLocation(program, "u_matrix"),
+      .color = glGetUniformLocation(program, "u_color"),
+      .id = glGetUniformLocation(program, "u_id"),
+  };
+}
+
 void setBufferAndAttributes(GLuint program, objectBufferInfo objectBuffer)
 {
+  const programLocations &locations = locations_for(program);
+  GLint positionLocation = locations.position;
+
   // Load the vertex data
   glEnableVertexAttribArray(positionLocation);
 
@@ -119,34 +209,105 @@ void setBufferAndAttributes(GLuint program, objectBufferInfo objectBuffer)
   glVertexAttribPointer(
       positionLocation, 2, GL_FLOAT, false, 0, 0);
 
-  glUniform2f(resolutionLocation, canvasWidth, canvasHeight);
+  glUniform2f(locations.resolution, canvasWidth, canvasHeight);
   glBufferData(
       GL_ARRAY_BUFFER,
       objectBuffer.numElements,
       objectBuffer.vertices,
       objectBuffer.usage);
+  memory_gpu_resize(MEMORY_SCENE, positionBytes, objectBuffer.numElements);
 }
 
-void setUniforms(GLuint program, objectUniforms uniforms)
+// u_matrix of an object: translation * rotation * scale
+void object_matrix(const transformComponent &transform, float matrix[9])
 {
-  glUniform4f(colorLocation, uniforms.u_color[0], uniforms.u_color[1], uniforms.u_color[2], uniforms.u_color[3]);
-  glUniform4f(idLocation, uniforms.u_id[0], uniforms.u_id[1], uniforms.u_id[2], uniforms.u_id[3]);
-
   // Set translation
-  float partial_matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
-  float matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
   float trans_matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
   float rot_matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
   float scale_matrix[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
-  matrix_translation(uniforms.translation[0], uniforms.translation[1], trans_matrix);
-  matrix_rotation(uniforms.rotation[0], uniforms.rotation[1], rot_matrix);
-  matrix_scaling(uniforms.scale[0], uniforms.scale[1], scale_matrix);
+  matrix_translation(transform.translation[0], transform.translation[1], trans_matrix);
+  matrix_rotation(transform.rotation[0], transform.rotation[1], rot_matrix);
+  matrix_scaling(transform.scale[0], transform.scale[1], scale_matrix);
 
   // Multiply the matrices.
   matrix_multiply(trans_matrix, rot_matrix, matrix);
   matrix_multiply(matrix, scale_matrix, matrix);
+}
 
-  glUniformMatrix3fv(matrixLocation, 1, false, matrix);
+void setUniforms(GLuint program, uint32_t slot)
+{
+  const programLocations &locations = locations_for(program);
+  if (program != pickingProgram)
+  {
+    const GLfloat *color = colors.read(slot).rgba;
+    glUniform4f(locations.color, color[0], color[1], color[2], color[3]);
+  }
+  else if (integerPicking)
+  {
+    glUniform1ui(locations.id, pickIds.read(slot));
+  }
+  else
+  {
+    float id[4];
+    pick_encode_rgba8(pickIds.read(slot), id);
+    glUniform4f(locations.id, id[0], id[1], id[2], id[3]);
+  }
+
+  float matrix[9];
+  object_matrix(transforms.read(slot), matrix);
+  glUniformMatrix3fv(locations.matrix, 1, false, matrix);
+}
+
+// Pixels the object's mesh can touch, padded by one for antialiasing
+static screenRect object_bounds(uint32_t slot)
+{
+  if (!transforms.has(slot) || !meshes.has(slot))
+    return {0, 0, 0, 0};
+
+  float matrix[9];
+  object_matrix(transforms.read(slot), matrix);
+  const objectBufferInfo &buffer = *meshes.read(slot).bufferInfo;
+  int vertexCount = buffer.numElements / (2 * sizeof(GLfloat));
+  float minX = 0, minY = 0, maxX = 0, maxY = 0;
+  for (int v = 0; v < vertexCount; v++)
+  {
+    float ox = buffer.vertices[v * 2];
+    float oy = buffer.vertices[v * 2 + 1];
+    float x = matrix[0] * ox + matrix[3] * oy + matrix[6];
+    float y = matrix[1] * ox + matrix[4] * oy + matrix[7];
+    minX = v == 0 || x < minX ? x : minX;
+    minY = v == 0 || y < minY ? y : minY;
+    maxX = v == 0 || x > maxX ? x : maxX;
+    maxY = v == 0 || y > maxY ? y : maxY;
+  }
+  // Far off the canvas, keep the rectangle in int range
+  const float limit = 1 << 24;
+  minX = minX < -limit ? -limit : minX > limit ? limit : minX;
+  minY = minY < -limit ? -limit : minY > limit ? limit : minY;
+  maxX = maxX < -limit ? -limit : maxX > limit ? limit : maxX;
+  maxY = maxY < -limit ? -limit : maxY > limit ? limit : maxY;
+  return {(int)floorf(minX) - 1, (int)floorf(minY) - 1, (int)ceilf(maxX) + 1, (int)ceilf(maxY) + 1};
+}
+
+// Queues the object in slot to have its old and new bounds redrawn
+static void mark_damaged(uint32_t slot)
+{
+  if (objectDamaged[slot])
+    return;
+  objectDamaged[slot] = true;
+  damagedObjects.push_back(slot);
+}
+
+static void collect_damage()
+{
+  for (uint32_t slot : damagedObjects)
+  {
+    screenRect bounds = object_bounds(slot);
+    damage_add(damage, rect_union(objectBounds[slot], bounds), canvasWidth, canvasHeight);
+    objectBounds[slot] = bounds;
+    objectDamaged[slot] = false;
+  }
+  damagedObjects.clear();
 }
 
 //Shaders
@@ -179,17 +340,33 @@ static const char fragment_shader_2d[] =
     " gl_FragColor = u_color;"
     "}";
 
+// vertex_shader_2d for the WebGL 2 picking pass, it has to match the fragment shader's version
 static const char pick_vertex_shader[] =
-    "attribute vec4 a_position;"
+    "#version 300 es\n"
+    "in vec2 a_position;"
 
-    "uniform mat4 u_matrix;"
+    "uniform vec2 u_resolution;"
+    "uniform mat3 u_matrix;"
 
     "void main() {"
-    // Multiply the position by the matrix.
-    "gl_Position = u_matrix * a_position;"
+    "vec2 position = (u_matrix * vec3(a_position, 1)).xy;"
+    "vec2 clipSpace = position / u_resolution * 2.0 - 1.0;"
+    "gl_Position = vec4(clipSpace * vec2(1, -1), 0, 1);"
     "}";
 
+// Exact 32-bit draw IDs into the R32UI target
 static const char pick_fragment_shader[] =
+    "#version 300 es\n"
+    "precision highp float;"
+    "uniform highp uint u_id;"
+    "out highp uint id;"
+    "void main()"
+    "{"
+    "id = u_id;"
+    "}";
+
+// The WebGL 1 fallback writes the ID as a color, multiples of 1 / 255 survive even mediump
+static const char pick_rgba8_fragment_shader[] =
     "precision mediump float;"
     "uniform vec4 u_id;"
     "void main()"
@@ -197,6 +374,78 @@ static const char pick_fragment_shader[] =
     "gl_FragColor = u_id;"
     "}";
 
+objectHandle create_object()
+{
+  objectHandle handle = handle_create(objectHandles);
+  if (handle == HANDLE_NONE)
+    return HANDLE_NONE;
+  uint32_t slot = handle_slot(handle);
+  if (slot >= objectBounds.size())
+  {
+    objectBounds.resize(slot + 1, {0, 0, 0, 0});
+    objectDamaged.resize(slot + 1, false);
+  }
+
+  colors.insert(slot, {
+                          .rgba = {static_cast<GLfloat>(rand() % 255 / 255.0), static_cast<GLfloat>(rand() % 255 / 255.0), static_cast<GLfloat>(rand() % 255 / 255.0), 1},
+                      });
+  transforms.insert(slot, {
+                              .translation = {static_cast<GLfloat>(rand() % 400), static_cast<GLfloat>(rand() % 400)},
+                              .rotation = {0, 1},
+                              .scale = {static_cast<GLfloat>(rand() % 300), static_cast<GLfloat>(rand() % 300)},
+                          });
+  meshes.insert(slot, {
+                          .programInfo = objectProgram,
+                          .bufferInfo = &rectangleBufferInfo,
+                          .mesh = RECTANGLE_MESH,
+                          .texture = 0,
+                          .layer = 0,
+                          .depth = 0,
+                          .sequence = nextSequence++,
+                      });
+  pickIds.insert(slot, slot + 1);
+  mark_damaged(slot);
+  return handle;
+}
+
+int create_objects(int count)
+{
+  createdObjects.clear();
+  for (int n = 0; n < count; n++)
+  {
+    objectHandle handle = create_object();
+    if (handle == HANDLE_NONE)
+      break;
+    createdObjects.push_back(handle);
+  }
+  return createdObjects.size();
+}
+
+uint32_t *created_objects()
+{
+  return createdObjects.data();
+}
+
+void destroy_object(uint32_t handle)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+
+  // Its old bounds get redrawn without it
+  mark_damaged(slot);
+
+  transforms.remove(slot);
+  colors.remove(slot);
+  meshes.remove(slot);
+  pickIds.remove(slot);
+  for (animationCurves &curves : animations)
+    animation_remove(curves, slot);
+  handle_destroy(objectHandles, handle);
+  if (highlighted == handle)
+    highlighted = HANDLE_NONE;
+}
+
 void webgl_init(int width, int height)
 {
   printf("WEB_GL_INIT\n");
@@ -212,15 +461,23 @@ void webgl_init(int width, int height)
   attrs.depth = 1;
   attrs.stencil = 1;
   attrs.antialias = 1;
+  // Frames only redraw the damaged part of the canvas, the rest has to survive compositing
+  attrs.preserveDrawingBuffer = 1;
   attrs.majorVersion = 3;
   attrs.minorVersion = 0;
 #if MAX_WEBGL_VERSION >= 2
   attrs.majorVersion = 2;
 #endif
 
-  // Create Context
+  // Create Context, WebGL 1 when 2 isn't there
   glContext = emscripten_webgl_create_context("#scene", &attrs);
+  if (!glContext && attrs.majorVersion >= 2)
+  {
+    attrs.majorVersion = 1;
+    glContext = emscripten_webgl_create_context("#scene", &attrs);
+  }
   assert(glContext);
+  integerPicking = attrs.majorVersion >= 2;
 
   emscripten_webgl_make_context_current(glContext);
 
@@ -230,32 +487,40 @@ void webgl_init(int width, int height)
   objectProgram = create_program(objectVertexShader, objectFragmentShader);
 
   // Picking Program
-  pickingVertexShader = compile_shader(GL_VERTEX_SHADER, pick_vertex_shader);
-  pickingFragmentShader = compile_shader(GL_FRAGMENT_SHADER, pick_fragment_shader);
+  pickingVertexShader = compile_shader(GL_VERTEX_SHADER, integerPicking ? pick_vertex_shader : vertex_shader_2d);
+  pickingFragmentShader = compile_shader(GL_FRAGMENT_SHADER, integerPicking ? pick_fragment_shader : pick_rgba8_fragment_shader);
   pickingProgram = create_program(pickingVertexShader, pickingFragmentShader);
 
-  positionLocation = glGetAttribLocation(objectProgram, "a_position");
-  resolutionLocation = glGetUniformLocation(objectProgram, "u_resolution");
-  colorLocation = glGetUniformLocation(objectProgram, "u_color");
-  matrixLocation = glGetUniformLocation(
-      objectProgram, "u_matrix");
-  idLocation = glGetUniformLocation(
-      pickingProgram, "u_id");
+  objectLocations = find_locations(objectProgram);
+  pickingLocations = find_locations(pickingProgram);
 
   glGenBuffers(1, &positionBuffer);
   glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
 
   glGenTextures(1, &pickingTexture);
   glBindTexture(GL_TEXTURE_2D, pickingTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-               canvasWidth, canvasHeight, 0,
-               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-
-  // set the filtering so we don't need mips
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  if (integerPicking)
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI,
+                 canvasWidth, canvasHeight, 0,
+                 GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+  else
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
+                 canvasWidth, canvasHeight, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  // set the filtering so we don't need mips, integer textures only take nearest
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+  // Same depth test as the canvas, so overlapping objects resolve the same way in both passes
+  glGenRenderbuffers(1, &renderBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, canvasWidth, canvasHeight);
+  // 4 bytes of color either way and 2 of depth per pixel
+  memory_gpu_resize(MEMORY_SCENE, pickingBytes, (int64_t)canvasWidth * canvasHeight * 6);
+
   // Create and bind the framebuffer
   glGenFramebuffers(1, &frameBuffer);
   glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
@@ -263,55 +528,197 @@ void webgl_init(int width, int height)
   // attach the texture as the first color attachment
   glFramebufferTexture2D(
       GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pickingTexture, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBuffer);
 
-  for (int i = 0; i < 3; i++)
+  for (int i = 0; i < INITIAL_OBJECTS_COUNT; i++)
   {
-    int id = i + 1;
-    int r = (i & 0x000000FF) >> 0;
-    int g = (i & 0x0000FF00) >> 8;
-    int b = (i & 0x00FF0000) >> 16;
-    objects[i] = {
-        .uniforms = {
-            .u_color = {static_cast<GLfloat>(rand() % 255 / 255.0), static_cast<GLfloat>(rand() % 255 / 255.0), static_cast<GLfloat>(rand() % 255 / 255.0), 1},
-            .u_matrix = {1, 0, 0, 0, 1, 0, 0, 0, 1},
-            .u_id = {
-                r / 255.0f,
-                g / 255.0f,
-                b / 255.0f,
-                1.0f,
-            },
-            .translation = {static_cast<GLfloat>(rand() % 400), static_cast<GLfloat>(rand() % 400)},
-            .rotation = {0, 1},
-            .scale = {static_cast<GLfloat>(rand() % 300), static_cast<GLfloat>(rand() % 300)},
-        },
-    };
-    objectsToDraw[i] = {
-        .programInfo = objectProgram,
-        .bufferInfo = rectangleBufferInfo,
-        .uniforms = &objects[i].uniforms,
-    };
+    objectHandle handle = create_object();
+    if (i == 0)
+      primaryObject = handle;
   }
 
   draw_scene();
 }
 
-void draw_objects(GLuint overrideProgram = NULL)
+// Dense indices of the meshes in creation order. Removing from the pool moves its last mesh into
+// the hole, the sort keys would draw that one out of turn among its equals otherwise.
+static void creation_order(const componentPool<meshComponent, chunkedArray> &pool, uint64_t *keys, uint32_t *order, uint64_t *keysScratch, uint32_t *orderScratch)
 {
+  uint32_t count = pool.size();
+  bool sorted = true;
+  for (uint32_t n = 0; n < count; n++)
+  {
+    keys[n] = pool.values[n].sequence;
+    order[n] = n;
+    sorted = sorted && (n == 0 || keys[n] > keys[n - 1]);
+  }
+  if (!sorted)
+    radix_sort_keys(keys, order, keysScratch, orderScratch, count);
+}
 
-  for (int i = 0; i < 3; i++)
+// Walks the packed meshes in creation order, equal keys keep it
+void sort_draw_list(GLuint overrideProgram)
+{
+  drawCount = meshes.size();
+  if (drawKeys.size() < (size_t)drawCount)
+  {
+    drawKeys.resize(drawCount);
+    drawOrder.resize(drawCount);
+    drawKeysScratch.resize(drawCount);
+    drawOrderScratch.resize(drawCount);
+  }
+  creation_order(meshes, drawKeys.data(), drawOrder.data(), drawKeysScratch.data(), drawOrderScratch.data());
+  for (int n = 0; n < drawCount; n++)
   {
-    GLuint program = objectsToDraw[i].programInfo;
-    if (overrideProgram)
+    const meshComponent &draw = meshes.values[drawOrder[n]];
+    uint32_t slot = meshes.slots[drawOrder[n]];
+    GLuint program = overrideProgram ? overrideProgram : draw.programInfo;
+    int translucent = colors.read(slot).rgba[3] < 1.0f;
+    drawKeys[n] = make_sort_key(draw.layer, translucent, draw.depth, program, draw.texture, draw.mesh);
+    drawOrder[n] = slot;
+  }
+  radix_sort_keys(drawKeys.data(), drawOrder.data(), drawKeysScratch.data(), drawOrderScratch.data(), drawCount);
+}
+
+// Draws the sorted list, with clip only the objects that touch it
+void draw_objects(GLuint overrideProgram, const screenRect *clip)
+{
+  // Draws come out grouped by program, texture and mesh, only rebind when they change
+  GLuint currentProgram = 0;
+  GLuint currentTexture = 0;
+  GLuint currentMesh = NO_MESH;
+  for (int n = 0; n < drawCount; n++)
+  {
+    uint32_t slot = drawOrder[n];
+    if (clip && !rect_intersects(objectBounds[slot], *clip))
+      continue;
+    const meshComponent &draw = meshes.read(slot);
+    GLuint program = overrideProgram ? overrideProgram : draw.programInfo;
+    if (program != currentProgram)
+    {
+      glUseProgram(program);
+      currentProgram = program;
+      currentMesh = NO_MESH;
+    }
+    if (draw.texture != currentTexture)
     {
-      program = overrideProgram;
+      glBindTexture(GL_TEXTURE_2D, draw.texture);
+      currentTexture = draw.texture;
     }
-    glUseProgram(program);
-    setBufferAndAttributes(program, objectsToDraw[i].bufferInfo);
-    setUniforms(program, *(objectsToDraw[i].uniforms));
+    if (draw.mesh != currentMesh)
+    {
+      setBufferAndAttributes(program, *draw.bufferInfo);
+      currentMesh = draw.mesh;
+    }
+    setUniforms(program, slot);
     glDrawArrays(GL_TRIANGLES, 0, 6);
   };
 }
 
+// Clears color and depth of the bound framebuffer, glClear is undefined on the integer picking target
+static void clear_target(GLuint overrideProgram)
+{
+  if (overrideProgram == pickingProgram && integerPicking)
+  {
+    static const GLuint background[4] = {PICK_NONE, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, background);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    return;
+  }
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Clears and redraws the damaged rectangles of the bound framebuffer, or all of it when full
+void redraw_damage(GLuint overrideProgram, bool full)
+{
+  sort_draw_list(overrideProgram);
+  if (full)
+  {
+    clear_target(overrideProgram);
+    draw_objects(overrideProgram, NULL);
+    return;
+  }
+
+  // Drawing in the same order under the scissor gives the same pixels as a full redraw
+  glEnable(GL_SCISSOR_TEST);
+  for (int r = 0; r < damage.count; r++)
+  {
+    const screenRect &rect = damage.rects[r];
+    glScissor(rect.x1, canvasHeight - rect.y2, rect.x2 - rect.x1, rect.y2 - rect.y1);
+    clear_target(overrideProgram);
+    draw_objects(overrideProgram, &rect);
+  }
+  glDisable(GL_SCISSOR_TEST);
+}
+
+static bool needs_full_redraw()
+{
+  return !partialRedraw || damage.full || damage_area(damage) > DAMAGE_FULL_REDRAW_FRACTION * canvasWidth * canvasHeight;
+}
+
+// Picking target pixels of a canvas rectangle, y down, as draw IDs row by row from the bottom.
+// stride receives the words between pixels. The picking framebuffer has to be bound.
+static std::vector<uint32_t> pickPixels;
+static std::vector<uint8_t> pickBytes;
+static const uint32_t *read_pick_pixels(int x, int y, int width, int height, size_t *stride)
+{
+  size_t count = (size_t)width * height;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  if (integerPicking)
+  {
+    // RGBA_INTEGER is the read format every integer target supports
+    pickPixels.resize(count * 4);
+    glReadPixels(x, canvasHeight - y - height, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_INT, pickPixels.data());
+    if (stride)
+      *stride = 4;
+    return pickPixels.data();
+  }
+
+  pickBytes.resize(count * 4);
+  pickPixels.resize(count);
+  glReadPixels(x, canvasHeight - y - height, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pickBytes.data());
+  for (size_t n = 0; n < count; n++)
+    pickPixels[n] = pick_decode_rgba8(&pickBytes[n * 4]);
+  if (stride)
+    *stride = 1;
+  return pickPixels.data();
+}
+
+// Handles found by the last pick_region
+static std::vector<uint32_t> pickedNodes;
+
+int pick_region(int x1, int y1, int x2, int y2)
+{
+  pickedNodes.clear();
+  // The picking target has to show the current scene
+  if (!damagedObjects.empty())
+    draw_scene();
+
+  x1 = x1 < 0 ? 0 : x1;
+  y1 = y1 < 0 ? 0 : y1;
+  x2 = x2 > canvasWidth ? canvasWidth : x2;
+  y2 = y2 > canvasHeight ? canvasHeight : y2;
+  if (x1 >= x2 || y1 >= y2)
+    return 0;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+  size_t stride;
+  const uint32_t *pixels = read_pick_pixels(x1, y1, x2 - x1, y2 - y1, &stride);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  pick_collect_ids(pixels, x2 - x1, y2 - y1, stride, handle_slot_count(objectHandles) + 1, pickedNodes);
+
+  // Draw IDs to handles, the target was just redrawn so every ID is a live object's
+  for (uint32_t &id : pickedNodes)
+    id = handle_of(objectHandles, id - 1);
+  std::sort(pickedNodes.begin(), pickedNodes.end());
+  return pickedNodes.size();
+}
+
+uint32_t *picked_ids()
+{
+  return pickedNodes.data();
+}
+
 void draw_scene()
 {
   printf("DRAW SCENE\n");
@@ -324,46 +731,45 @@ void draw_scene()
   glEnable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
 
-  // Clear the canvas AND the depth buffer.
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  draw_objects(pickingProgram);
+  // Clear the canvas AND the depth buffer, only where something changed.
+  collect_damage();
+  redraw_damage(pickingProgram, needs_full_redraw());
 
   glFlush();
   glFinish();
 
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-  // ------ Figure out what pixel is under the mouse and read it
-
-  GLfloat pixelX = mouse[0];
-  GLfloat pixelY = canvasHeight - mouse[1] - 1;
-  unsigned char data[4];
-  glReadPixels(
-      pixelX,           // x
-      pixelY,           // y
-      1,                // width
-      1,                // height
-      GL_RGBA,          // format
-      GL_UNSIGNED_BYTE, // type
-      data);            // typed array to hold result
-  int id = data[0] + (data[1] * 256) + (data[2] * 256 * 256) - 1;
-  printf("%d, %i %i %i %i\n", id, data[0], data[1], data[2], data[3]);
-  // restore the object's color
-  if (oldPickNdx >= 0)
+  // ------ Figure out what object is under the mouse
+
+  uint32_t id = PICK_NONE;
+  if (mouse[0] >= 0 && mouse[0] < canvasWidth && mouse[1] >= 0 && mouse[1] < canvasHeight)
+    id = read_pick_pixels(mouse[0], mouse[1], 1, 1, NULL)[0];
+  printf("%u\n", id);
+  // restore the object's color, destroy_object drops the highlight so it is still alive
+  objectHandle previousHighlight = highlighted;
+  if (highlighted != HANDLE_NONE)
   {
-    *(objects[oldPickNdx].uniforms.u_color) = *oldPickColor;
-    oldPickNdx = -1;
+    memcpy(colors.get(handle_slot(highlighted)).rgba, oldPickColor, sizeof(oldPickColor));
+    highlighted = HANDLE_NONE;
   }
 
   // highlight object under mouse
-  if (id > 0)
+  objectHandle picked = id != PICK_NONE ? handle_of(objectHandles, id - 1) : HANDLE_NONE;
+  if (picked != HANDLE_NONE)
+  {
+    highlighted = picked;
+    GLfloat *color = colors.get(handle_slot(picked)).rgba;
+    memcpy(oldPickColor, color, sizeof(oldPickColor));
+    const GLfloat selectedColor[4] = {1, 1, 1, 1};
+    memcpy(color, selectedColor, sizeof(selectedColor));
+  }
+
+  // Only a change of the highlighted object has to be redrawn
+  if (highlighted != previousHighlight)
   {
-    int pickNdx = id - 1;
-    oldPickNdx = pickNdx;
-    *oldPickColor = *(objects[pickNdx].uniforms.u_color);
-    GLfloat selectedColor[4] = {1, 1, 1, 1};
-    *(objects[oldPickNdx].uniforms.u_color) = *selectedColor;
+    if (previousHighlight != HANDLE_NONE)
+      mark_damaged(handle_slot(previousHighlight));
+    if (highlighted != HANDLE_NONE)
+      mark_damaged(handle_slot(highlighted));
   }
 
   // ------ Draw the objects to the canvas
@@ -371,34 +777,394 @@ void draw_scene()
   glBindFramebuffer(GL_FRAMEBUFFER, NULL);
   glViewport(0, 0, canvasWidth, canvasHeight);
 
-  draw_objects();
+  // Picks up the highlight change on top of what the picking pass redrew
+  collect_damage();
+  redraw_damage(0, needs_full_redraw());
+  damage_clear(damage);
+}
+
+void set_partial_redraw(int enabled)
+{
+  partialRedraw = enabled;
+  damage.full = true;
+}
+
+// What a snapshot keeps of the scene. Copying one is O(1), the copy shares every chunk.
+struct sceneSnapshot
+{
+  handleTable handles;
+  componentPool<transformComponent, chunkedArray> transforms;
+  componentPool<colorComponent, chunkedArray> colors;
+  componentPool<meshComponent, chunkedArray> meshes;
+  componentPool<GLuint, chunkedArray> pickIds;
+  // The highlighted object is white in colors, its own color is kept aside
+  objectHandle highlighted;
+  GLfloat highlightedColor[4];
+};
+
+// Snapshots by ID, IDs count up from 1
+static std::unordered_map<uint32_t, std::shared_ptr<const sceneSnapshot>> snapshots;
+static uint32_t nextSnapshot = 1;
+
+static void capture_scene(sceneSnapshot &out)
+{
+  out.handles = objectHandles;
+  out.transforms = transforms;
+  out.colors = colors;
+  out.meshes = meshes;
+  out.pickIds = pickIds;
+  out.highlighted = highlighted;
+  memcpy(out.highlightedColor, oldPickColor, sizeof(oldPickColor));
+}
+
+uint32_t take_snapshot()
+{
+  uint32_t id = nextSnapshot++;
+  if (nextSnapshot == 0)
+    nextSnapshot = 1;
+  std::shared_ptr<sceneSnapshot> snapshot = std::make_shared<sceneSnapshot>();
+  capture_scene(*snapshot);
+  snapshots[id] = snapshot;
+  return id;
+}
+
+std::shared_ptr<const sceneSnapshot> find_snapshot(uint32_t id)
+{
+  auto found = snapshots.find(id);
+  return found != snapshots.end() ? found->second : NULL;
+}
+
+// Queues the objects of the chunks where pool and replacement differ, in both. Only those can
+// look different once the replacement is in.
+template <typename T>
+static void mark_changed_chunks(const componentPool<T, chunkedArray> &pool, const componentPool<T, chunkedArray> &replacement)
+{
+  size_t chunks = std::max(pool.values.chunk_count(), replacement.values.chunk_count());
+  for (size_t chunk = 0; chunk < chunks; chunk++)
+  {
+    // Removing the last value leaves its chunk as it was, the ends have to match too
+    size_t first = chunk * CHUNK_SIZE;
+    size_t poolEnd = std::min<size_t>(first + CHUNK_SIZE, pool.size());
+    size_t replacementEnd = std::min<size_t>(first + CHUNK_SIZE, replacement.size());
+    if (poolEnd == replacementEnd && pool.values.shares_chunk(replacement.values, chunk) && pool.slots.shares_chunk(replacement.slots, chunk))
+      continue;
+    for (size_t n = first; n < poolEnd; n++)
+      mark_damaged(pool.slots[n]);
+    for (size_t n = first; n < replacementEnd; n++)
+      mark_damaged(replacement.slots[n]);
+  }
+}
+
+int restore_snapshot(uint32_t id)
+{
+  std::shared_ptr<const sceneSnapshot> snapshot = find_snapshot(id);
+  if (!snapshot)
+    return 0;
+
+  // Undoing a few edits only redraws what they touched
+  uint32_t slotCount = handle_slot_count(snapshot->handles);
+  if (slotCount > objectBounds.size())
+  {
+    objectBounds.resize(slotCount, {0, 0, 0, 0});
+    objectDamaged.resize(slotCount, false);
+  }
+  mark_changed_chunks(transforms, snapshot->transforms);
+  mark_changed_chunks(colors, snapshot->colors);
+  mark_changed_chunks(meshes, snapshot->meshes);
+  mark_changed_chunks(pickIds, snapshot->pickIds);
+  if (highlighted != snapshot->highlighted)
+  {
+    if (highlighted != HANDLE_NONE)
+      mark_damaged(handle_slot(highlighted));
+    if (snapshot->highlighted != HANDLE_NONE)
+      mark_damaged(handle_slot(snapshot->highlighted));
+  }
+
+  // Objects the snapshot brings back keep their tracks, the rest would animate whatever has the slot now
+  handleTable previousHandles = objectHandles;
+  handle_restore(objectHandles, snapshot->handles);
+  for (animationCurves &curves : animations)
+    for (uint32_t n = curves.tracks.size(); n-- > 0;)
+    {
+      uint32_t slot = curves.tracks.slots[n];
+      if (handle_of(objectHandles, slot) != handle_of(previousHandles, slot))
+        animation_remove(curves, slot);
+    }
+  transforms = snapshot->transforms;
+  colors = snapshot->colors;
+  meshes = snapshot->meshes;
+  pickIds = snapshot->pickIds;
+  highlighted = snapshot->highlighted;
+  memcpy(oldPickColor, snapshot->highlightedColor, sizeof(oldPickColor));
+
+  return 1;
+}
+
+void release_snapshot(uint32_t id)
+{
+  snapshots.erase(id);
+}
+
+void snapshot_render(const sceneSnapshot &scene, int width, int height, float resolutionX, float resolutionY, int threads, bool ids, snapshotRender &out)
+{
+  // In the order sort_draw_list puts the canvas pass
+  uint32_t count = scene.meshes.size();
+  out.keys.resize(count);
+  out.order.resize(count);
+  out.keysScratch.resize(count);
+  out.orderScratch.resize(count);
+  creation_order(scene.meshes, out.keys.data(), out.order.data(), out.keysScratch.data(), out.orderScratch.data());
+  for (uint32_t n = 0; n < count; n++)
+  {
+    const meshComponent &draw = scene.meshes.values[out.order[n]];
+    uint32_t slot = scene.meshes.slots[out.order[n]];
+    int translucent = scene.colors.read(slot).rgba[3] < 1.0f;
+    out.keys[n] = make_sort_key(draw.layer, translucent, draw.depth, draw.programInfo, draw.texture, draw.mesh);
+    out.order[n] = slot;
+  }
+  radix_sort_keys(out.keys.data(), out.order.data(), out.keysScratch.data(), out.orderScratch.data(), count);
+
+  out.draws.resize(count);
+  for (uint32_t n = 0; n < count; n++)
+  {
+    uint32_t slot = out.order[n];
+    const GLfloat *color = scene.colors.read(slot).rgba;
+    rasterDraw &draw = out.draws[n];
+    draw.vertices = scene.meshes.read(slot).bufferInfo->vertices;
+    draw.vertexCount = 6;
+    object_matrix(scene.transforms.read(slot), draw.matrix);
+    for (int c = 0; c < 4; c++)
+    {
+      float value = color[c];
+      value = value < 0 ? 0 : value > 1 ? 1 : value;
+      draw.color[c] = (uint8_t)lroundf(value * 255);
+    }
+    draw.id = scene.pickIds.read(slot);
+  }
+
+  out.width = width;
+  out.height = height;
+  out.color.resize((size_t)width * height * 4);
+  out.ids.resize(ids ? (size_t)width * height : 0);
+  rasterTarget target = {width, height, out.color.data(), ids ? out.ids.data() : NULL};
+  // The canvas pass runs with the depth test on and every draw at depth 0, so the first draw wins
+  const uint8_t clear[4] = {0, 0, 0, 0};
+  raster_draws(out.draws.data(), count, resolutionX, resolutionY, clear, true, threads, target, out.scratch);
+}
+
+// Software render target of render_software and render_snapshot
+static snapshotRender softwareRender;
+static std::vector<uint8_t> softwarePngBuffer;
+
+static uint8_t *render_scene_software(const sceneSnapshot &scene, int width, int height, int threads, int ids)
+{
+  if (width <= 0 || height <= 0)
+    return NULL;
+  // Headless there is no canvas, u_resolution is then the target itself
+  float resolutionX = canvasWidth > 0 ? canvasWidth : width;
+  float resolutionY = canvasHeight > 0 ? canvasHeight : height;
+  snapshot_render(scene, width, height, resolutionX, resolutionY, threads, ids, softwareRender);
+  return softwareRender.color.data();
+}
+
+uint8_t *render_software(int width, int height, int threads, int ids)
+{
+  // Nothing is edited while the capture shares the scene's chunks, so none are copied
+  sceneSnapshot scene;
+  capture_scene(scene);
+  return render_scene_software(scene, width, height, threads, ids);
+}
+
+uint8_t *render_snapshot(uint32_t id, int width, int height, int threads, int ids)
+{
+  std::shared_ptr<const sceneSnapshot> snapshot = find_snapshot(id);
+  return snapshot ? render_scene_software(*snapshot, width, height, threads, ids) : NULL;
+}
+
+uint32_t *software_ids()
+{
+  return softwareRender.ids.empty() ? NULL : softwareRender.ids.data();
+}
+
+uint8_t *software_png()
+{
+  raster_encode_png(softwareRender.color.data(), softwareRender.width, softwareRender.height, softwarePngBuffer);
+  return softwarePngBuffer.data();
+}
+
+int software_png_size()
+{
+  return softwarePngBuffer.size();
+}
+
+void release_scene_caches()
+{
+  softwareRender = snapshotRender();
+  std::vector<uint8_t>().swap(softwarePngBuffer);
+  std::vector<uint32_t>().swap(pickPixels);
+  std::vector<uint8_t>().swap(pickBytes);
+}
+
+void set_translation(uint32_t handle, float x, float y)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+  transformComponent &transform = transforms.get(slot);
+  transform.translation[0] = x;
+  transform.translation[1] = y;
+  mark_damaged(slot);
+}
+
+void set_rotation(uint32_t handle, float angle)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+  transformComponent &transform = transforms.get(slot);
+  transform.rotation[0] = sin(angle * PI / 180.0);
+  transform.rotation[1] = cos(angle * PI / 180.0);
+  mark_damaged(slot);
+}
+
+void set_scale(uint32_t handle, float x, float y)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+  transformComponent &transform = transforms.get(slot);
+  transform.scale[0] = x;
+  transform.scale[1] = y;
+  mark_damaged(slot);
+}
+
+void set_color(uint32_t handle, float r, float g, float b, float a)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+  // The highlighted object shows its new color once the mouse leaves it, draw_scene restores it then
+  if (handle == highlighted)
+  {
+    GLfloat color[4] = {r, g, b, a};
+    memcpy(oldPickColor, color, sizeof(oldPickColor));
+    return;
+  }
+  GLfloat *color = colors.get(slot).rgba;
+  color[0] = r;
+  color[1] = g;
+  color[2] = b;
+  color[3] = a;
+  mark_damaged(slot);
+}
+
+int animate_object(uint32_t handle, int channel, const float *keys, int keyCount, int loop)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE || channel < 0 || channel >= ANIMATION_CHANNELS)
+    return 0;
+  return animation_set(animations[channel], slot, keys, keyCount, animationClock, loop);
+}
+
+void stop_animation(uint32_t handle, int channel)
+{
+  uint32_t slot = handle_resolve(objectHandles, handle);
+  if (slot == SLOT_NONE)
+    return;
+  for (int c = 0; c < ANIMATION_CHANNELS; c++)
+    if (channel < 0 || channel == c)
+      animation_remove(animations[c], slot);
+}
+
+int advance_animations(float deltaMs)
+{
+  animationClock += deltaMs;
+  int animated = 0;
+  for (int channel = 0; channel < ANIMATION_CHANNELS; channel++)
+  {
+    animationCurves &curves = animations[channel];
+    uint32_t count = curves.tracks.size();
+    if (count == 0)
+      continue;
+
+    // Every track at once, then scattered into the pools
+    animation_evaluate(curves, animationClock);
+    const float *values = curves.output.data();
+    const uint32_t *slots = curves.tracks.slots.data();
+    switch (channel)
+    {
+    case ANIMATE_TRANSLATION:
+      for (uint32_t n = 0; n < count; n++)
+        memcpy(transforms.get(slots[n]).translation, values + n * 2, 2 * sizeof(GLfloat));
+      break;
+    case ANIMATE_ROTATION:
+      animationSines.resize(count);
+      animationCosines.resize(count);
+      animation_sincos(values, animationSines.data(), animationCosines.data(), count);
+      for (uint32_t n = 0; n < count; n++)
+      {
+        transformComponent &transform = transforms.get(slots[n]);
+        transform.rotation[0] = animationSines[n];
+        transform.rotation[1] = animationCosines[n];
+      }
+      break;
+    case ANIMATE_SCALE:
+      for (uint32_t n = 0; n < count; n++)
+        memcpy(transforms.get(slots[n]).scale, values + n * 2, 2 * sizeof(GLfloat));
+      break;
+    case ANIMATE_COLOR:
+    {
+      // The highlighted object shows its new color once the mouse leaves it
+      uint32_t highlightedSlot = highlighted != HANDLE_NONE ? handle_slot(highlighted) : SLOT_NONE;
+      for (uint32_t n = 0; n < count; n++)
+        memcpy(slots[n] == highlightedSlot ? oldPickColor : colors.get(slots[n]).rgba, values + n * 4, 4 * sizeof(GLfloat));
+      break;
+    }
+    }
+    for (uint32_t n = 0; n < count; n++)
+      mark_damaged(slots[n]);
+
+    animated += count;
+    animation_retire(curves, animationClock);
+  }
+  return animated;
+}
+
+int update_animations(float deltaMs)
+{
+  int animated = advance_animations(deltaMs);
+  if (animated > 0)
+    draw_scene();
+  return animated;
+}
+
+void set_mouse(int x, int y)
+{
+  mouse[0] = x;
+  mouse[1] = y;
 }
 
 void update_translation(int x, int y)
 {
-  objects[0].uniforms.translation[0] = x;
-  objects[0].uniforms.translation[1] = y;
+  set_translation(primaryObject, x, y);
   draw_scene();
 }
 
 void update_rotation(int angle)
 {
-  objects[0].uniforms.rotation[0] = sin(angle * PI / 180.0);
-  objects[0].uniforms.rotation[1] = cos(angle * PI / 180.0);
+  set_rotation(primaryObject, angle);
   draw_scene();
 }
 
 void update_scale(int x, int y)
 {
-  objects[0].uniforms.scale[0] = x;
-  objects[0].uniforms.scale[1] = y;
+  set_scale(primaryObject, x, y);
   draw_scene();
 }
 
 void update_mouse(int x, int y)
 {
-  mouse[0] = x;
-  mouse[1] = y;
+  set_mouse(x, y);
   draw_scene();
 }
 
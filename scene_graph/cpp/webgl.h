@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -12,9 +13,70 @@ extern "C"
 
   void draw_scene();
 
+  // Objects are addressed by generational handles, see object_store.h. Creating, destroying and
+  // the setters only update state and leave drawing to the caller, stale handles are ignored.
+  // create_object returns 0 when the store is full.
+  uint32_t create_object();
+  void destroy_object(uint32_t handle);
+  void set_translation(uint32_t handle, float x, float y);
+  void set_rotation(uint32_t handle, float angle);
+  void set_scale(uint32_t handle, float x, float y);
+  void set_color(uint32_t handle, float r, float g, float b, float a);
+  void set_mouse(int x, int y);
+
+  // Keyframe animation, see animation.h for the channels and the key layout. The curve starts at
+  // the current animation clock and replaces the object's previous one on the channel. animate_object
+  // returns 0 for a stale handle or an invalid curve, stop_animation takes -1 for every channel.
+  int animate_object(uint32_t handle, int channel, const float *keys, int keyCount, int loop);
+  void stop_animation(uint32_t handle, int channel);
+  // Advances the animation clock and writes every animated value, returns how many tracks ran.
+  // update_animations redraws when there were any.
+  int advance_animations(float deltaMs);
+  int update_animations(float deltaMs);
+
+  // Creates up to count objects, returns how many. created_objects has their handles until the next call.
+  int create_objects(int count);
+  uint32_t *created_objects();
+
+  // Update the first object webgl_init created (or the mouse) and redraw.
   void update_translation(int x, int y);
   void update_rotation(int angle);
   void update_scale(int x, int y);
+  void update_mouse(int x, int y);
+
+  // Handles of the distinct objects visible in the canvas rectangle [x1, x2) x [y1, y2), y down, from one readback
+  // of the picking target. Returns their count, picked_ids has them in ascending order until the next call.
+  int pick_region(int x1, int y1, int x2, int y2);
+  uint32_t *picked_ids();
+
+  // Frames redraw only the damaged rectangles of the canvas by default, off redraws everything
+  void set_partial_redraw(int enabled);
+
+  // Renders the canvas pass on the CPU into a width x height RGBA buffer, no GL context needed.
+  // With ids the draw ID (handle slot + 1, 0 for background) of every pixel is kept too.
+  uint8_t *render_software(int width, int height, int threads, int ids);
+  // Id buffer of the last render_software, NULL when it was not asked for
+  uint32_t *software_ids();
+  // Encodes the last render_software as PNG, valid until the next call
+  uint8_t *software_png();
+  int software_png_size();
+
+  // Copy-on-write snapshots of the objects for undo and background work, see snapshot.h.
+  // take_snapshot is O(1) and returns the snapshot's ID, never 0. Edits after it copy only the
+  // chunks they touch, release_snapshot frees the chunks no one else shares.
+  uint32_t take_snapshot();
+  // Makes a snapshot the scene again and keeps it, 0 for an unknown ID. Only the chunks that differ
+  // are damaged and drawing is left to the caller. Handles of objects the snapshot does not have go
+  // stale for good, and their animations stop. The objects it brings back keep theirs.
+  int restore_snapshot(uint32_t snapshot);
+  void release_snapshot(uint32_t snapshot);
+  // render_software of a snapshot, into the same target. NULL for an unknown ID.
+  uint8_t *render_snapshot(uint32_t snapshot, int width, int height, int threads, int ids);
+
+  // Frees the software render target, its PNG and the picking readback, which invalidates the
+  // pointers render_software, software_ids and software_png returned. The scene's evictor when it
+  // goes over its memory budget, everything is allocated again on next use.
+  void release_scene_caches();
 
 #ifdef __cplusplus
 }
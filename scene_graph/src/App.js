@@ -11,6 +11,8 @@ function App() {
   const [position, setPosition] = useState([200, 200]);
   const [rotation, setRotation] = useState(0);
   const [scale, setScale] = useState([100, 100]);
+  const [selection, setSelection] = useState([]);
+  const dragStart = useRef(null);
 
   const width = scale[0];
   const height = scale[1];
@@ -123,20 +125,44 @@ function App() {
     );
   };
 
-  const handleCanvasClick = (e) => {
-    const canvas = canvasRef && canvasRef.current;
-    if (canvas) {
-      const rect = canvas.getBoundingClientRect();
-      const mouseX = e.clientX - rect.left;
-      const mouseY = e.clientY - rect.top;
-      console.log(mouseX, mouseY);
-      window.Module.ccall(
-        "updateMouse",
-        null,
-        ["number", "number"],
-        [mouseX, mouseY]
-      );
+  const canvasPoint = (e) => {
+    const rect = canvasRef.current.getBoundingClientRect();
+    return [Math.round(e.clientX - rect.left), Math.round(e.clientY - rect.top)];
+  };
+
+  const handleCanvasMouseDown = (e) => {
+    dragStart.current = canvasPoint(e);
+  };
+
+  // A click picks the object under the mouse, a drag selects everything
+  // visible in the marquee
+  const handleCanvasMouseUp = (e) => {
+    const start = dragStart.current;
+    dragStart.current = null;
+    if (!start || !canvasRef.current) {
+      return;
+    }
+    const [x, y] = canvasPoint(e);
+    if (Math.abs(x - start[0]) < 3 && Math.abs(y - start[1]) < 3) {
+      window.Module.ccall("updateMouse", null, ["number", "number"], [x, y]);
+      return;
     }
+    const count = window.Module.ccall(
+      "pickRegion",
+      "number",
+      ["number", "number", "number", "number"],
+      [
+        Math.min(x, start[0]),
+        Math.min(y, start[1]),
+        Math.max(x, start[0]) + 1,
+        Math.max(y, start[1]) + 1,
+      ]
+    );
+    const pointer = window.Module.ccall("pickedIds", "number", [], []);
+    const ids = Array.from(
+      window.Module.HEAPU32.subarray(pointer >> 2, (pointer >> 2) + count)
+    );
+    setSelection(ids);
   };
 
   if (!wasmLoaded) {
@@ -146,7 +172,12 @@ function App() {
   return (
     <div className="App">
       <div className="content">
-        <canvas id="scene" ref={canvasRef} onClick={handleCanvasClick} />
+        <canvas
+          id="scene"
+          ref={canvasRef}
+          onMouseDown={handleCanvasMouseDown}
+          onMouseUp={handleCanvasMouseUp}
+        />
         <div className="controls">
           <TextField
             type="number"
@@ -185,6 +216,7 @@ function App() {
             value={rotation}
             onChange={handleRotationChange}
           />
+          <p>{selection.length} selected</p>
         </div>
       </div>
     </div>
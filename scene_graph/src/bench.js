@@ -0,0 +1,78 @@
+import { CommandBuffer } from "./commandBuffer";
+
+// Moves count nodes once through the per-call API and once through a single
+// command batch. Call from the console: benchCommandBuffer(500)
+export function benchCommandBuffer(count = 500, runs = 10) {
+  const Module = window.Module;
+  const commands = new CommandBuffer(Module);
+
+  const ids = commands.createNodes(count);
+
+  let start = performance.now();
+  for (let run = 0; run < runs; run++) {
+    for (let id = 0; id < count; id++) {
+      Module.ccall(
+        "updateTranslation",
+        null,
+        ["number", "number"],
+        [(id + run) % 400, (id * 7 + run) % 400]
+      );
+    }
+  }
+  const perCallTime = performance.now() - start;
+
+  start = performance.now();
+  for (let run = 0; run < runs; run++) {
+    for (let id = 0; id < count; id++) {
+      commands.setTranslation(ids[id], (id + run) % 400, (id * 7 + run) % 400);
+    }
+    commands.flush();
+  }
+  const batchTime = performance.now() - start;
+
+  const ops = count * runs;
+  const result = {
+    count,
+    perCallOpsPerSecond: Math.round((ops / perCallTime) * 1000),
+    batchOpsPerSecond: Math.round((ops / batchTime) * 1000),
+  };
+  console.log("[BENCH] command buffer", result);
+  return result;
+}
+
+// Moves one small node across a scene of count large static ones, once redrawing
+// only the damaged rectangles and once redrawing every frame in full.
+// Call from the console: benchPartialRedraw(4000)
+export function benchPartialRedraw(count = 4000, frames = 100) {
+  const Module = window.Module;
+  const commands = new CommandBuffer(Module);
+
+  const [moving] = commands.createNodes(count);
+  commands.setScale(moving, 10, 10);
+  commands.flush();
+
+  const time = (partial) => {
+    Module.ccall("setPartialRedraw", null, ["number"], [partial ? 1 : 0]);
+    // The first frame after switching is a full redraw
+    commands.setTranslation(moving, 0, 0);
+    commands.flush();
+
+    const start = performance.now();
+    for (let frame = 0; frame < frames; frame++) {
+      commands.setTranslation(moving, (frame * 4) % 480, (frame * 3) % 480);
+      commands.flush();
+    }
+    return (performance.now() - start) / frames;
+  };
+
+  const fullFrameTime = time(false);
+  const partialFrameTime = time(true);
+
+  const result = {
+    count,
+    fullFrameMs: fullFrameTime.toFixed(3),
+    partialFrameMs: partialFrameTime.toFixed(3),
+  };
+  console.log("[BENCH] partial redraw", result);
+  return result;
+}
@@ -0,0 +1,171 @@
+// Mirrors the opcodes in cpp/commands.h
+export const CMD_END = 0;
+export const CMD_SET_TRANSLATION = 1;
+export const CMD_SET_ROTATION = 2;
+export const CMD_SET_SCALE = 3;
+export const CMD_SET_TRANSFORM = 4;
+export const CMD_SET_COLOR = 5;
+// 6 was CMD_ADD_NODE, nodes are created with createNodes below
+export const CMD_REMOVE_NODE = 7;
+export const CMD_POINTER_MOVE = 8;
+export const CMD_ANIMATE = 9;
+export const CMD_STOP_ANIMATION = 10;
+
+// Animation channels and easings, see cpp/animation.h
+export const ANIMATE_TRANSLATION = 0;
+export const ANIMATE_ROTATION = 1;
+export const ANIMATE_SCALE = 2;
+export const ANIMATE_COLOR = 3;
+export const EASE_LINEAR = 0;
+export const EASE_CUBIC = 1;
+
+// Largest fixed size command is CMD_SET_TRANSFORM: opcode + 6 arguments
+const MAX_COMMAND_WORDS = 7;
+
+// Packs commands into the module's shared command region, flush() applies them
+// with a single call into WASM and a single redraw.
+export class CommandBuffer {
+  constructor(module = window.Module) {
+    this.module = module;
+    this.pointer = module.ccall("commandBuffer", "number", [], []);
+    this.capacity = module.ccall("commandBufferSize", "number", [], []) >> 2;
+    this.length = 0;
+    this.heap = undefined;
+    this.bindViews();
+  }
+
+  bindViews() {
+    // Growing the WASM memory detaches the previous ArrayBuffer
+    const buffer = this.module.HEAPU32.buffer;
+    if (this.heap !== buffer) {
+      this.heap = buffer;
+      this.ints = new Int32Array(buffer, this.pointer, this.capacity);
+      this.floats = new Float32Array(buffer, this.pointer, this.capacity);
+    }
+  }
+
+  reserve(words = MAX_COMMAND_WORDS) {
+    if (this.length + words > this.capacity) {
+      this.flush();
+    }
+    this.bindViews();
+  }
+
+  setTranslation(id, x, y) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_SET_TRANSLATION;
+    this.ints[i + 1] = id;
+    this.floats[i + 2] = x;
+    this.floats[i + 3] = y;
+    this.length += 4;
+  }
+
+  setRotation(id, angle) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_SET_ROTATION;
+    this.ints[i + 1] = id;
+    this.floats[i + 2] = angle;
+    this.length += 3;
+  }
+
+  setScale(id, x, y) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_SET_SCALE;
+    this.ints[i + 1] = id;
+    this.floats[i + 2] = x;
+    this.floats[i + 3] = y;
+    this.length += 4;
+  }
+
+  setTransform(id, x, y, angle, scaleX, scaleY) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_SET_TRANSFORM;
+    this.ints[i + 1] = id;
+    this.floats[i + 2] = x;
+    this.floats[i + 3] = y;
+    this.floats[i + 4] = angle;
+    this.floats[i + 5] = scaleX;
+    this.floats[i + 6] = scaleY;
+    this.length += 7;
+  }
+
+  setColor(id, r, g, b, a) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_SET_COLOR;
+    this.ints[i + 1] = id;
+    this.floats[i + 2] = r;
+    this.floats[i + 3] = g;
+    this.floats[i + 4] = b;
+    this.floats[i + 5] = a;
+    this.length += 6;
+  }
+
+  // Creates count nodes right away and returns their handles, the ids the
+  // commands take. Pending commands are applied first to keep the order.
+  createNodes(count) {
+    this.flush();
+    const created = this.module.ccall("createNodes", "number", ["number"], [count]);
+    const pointer = this.module.ccall("createdNodes", "number", [], []);
+    return Array.from(
+      this.module.HEAPU32.subarray(pointer >> 2, (pointer >> 2) + created)
+    );
+  }
+
+  removeNode(id) {
+    this.reserve();
+    this.ints[this.length] = CMD_REMOVE_NODE;
+    this.ints[this.length + 1] = id;
+    this.length += 2;
+  }
+
+  // keys is flat: time (ms from now), easing and the channel's values for
+  // each key, e.g. [0, EASE_CUBIC, 0, 1000, EASE_LINEAR, 360] for rotation.
+  animate(id, channel, keys, loop = false) {
+    const stride = 2 + [2, 1, 2, 4][channel];
+    this.reserve(5 + keys.length);
+    const i = this.length;
+    this.ints[i] = CMD_ANIMATE;
+    this.ints[i + 1] = id;
+    this.ints[i + 2] = channel;
+    this.ints[i + 3] = loop ? 1 : 0;
+    this.ints[i + 4] = keys.length / stride;
+    this.floats.set(keys, i + 5);
+    this.length += 5 + keys.length;
+  }
+
+  stopAnimation(id, channel = -1) {
+    this.reserve();
+    this.ints[this.length] = CMD_STOP_ANIMATION;
+    this.ints[this.length + 1] = id;
+    this.ints[this.length + 2] = channel;
+    this.length += 3;
+  }
+
+  pointerMove(x, y) {
+    this.reserve();
+    const i = this.length;
+    this.ints[i] = CMD_POINTER_MOVE;
+    this.floats[i + 1] = x;
+    this.floats[i + 2] = y;
+    this.length += 3;
+  }
+
+  flush() {
+    if (this.length === 0) {
+      return 0;
+    }
+    const applied = this.module.ccall(
+      "applyCommands",
+      "number",
+      ["number"],
+      [this.length << 2]
+    );
+    this.length = 0;
+    return applied;
+  }
+}
@@ -0,0 +1,67 @@
+// Undo and redo over scene snapshots, see take_snapshot in cpp/webgl.h. A snapshot is O(1) and
+// shares everything the following edits leave alone, so a long history only holds the chunks the
+// edits touched.
+export class UndoHistory {
+  // Pending commands are flushed before each snapshot and restore
+  constructor(commands = null, limit = 1000, module = window.Module) {
+    this.module = module;
+    this.commands = commands;
+    this.limit = limit;
+    // Snapshot IDs, the last of past is the scene as it is
+    this.past = [];
+    this.future = [];
+    this.record();
+  }
+
+  flush() {
+    if (this.commands) {
+      this.commands.flush();
+    }
+  }
+
+  release(snapshot) {
+    this.module.ccall("releaseSnapshot", null, ["number"], [snapshot]);
+  }
+
+  restore(snapshot) {
+    this.module.ccall("restoreSnapshot", "number", ["number"], [snapshot]);
+  }
+
+  // After every edit that can be undone, drops the redo steps and the steps past the limit
+  record() {
+    this.flush();
+    this.past.push(this.module.ccall("takeSnapshot", "number", [], []));
+    this.future.forEach((snapshot) => this.release(snapshot));
+    this.future = [];
+    while (this.past.length > this.limit + 1) {
+      this.release(this.past.shift());
+    }
+  }
+
+  undo() {
+    if (this.past.length < 2) {
+      return false;
+    }
+    this.flush();
+    this.future.push(this.past.pop());
+    this.restore(this.past[this.past.length - 1]);
+    return true;
+  }
+
+  redo() {
+    if (this.future.length === 0) {
+      return false;
+    }
+    this.flush();
+    const snapshot = this.future.pop();
+    this.past.push(snapshot);
+    this.restore(snapshot);
+    return true;
+  }
+
+  clear() {
+    this.past.concat(this.future).forEach((snapshot) => this.release(snapshot));
+    this.past = [];
+    this.future = [];
+  }
+}
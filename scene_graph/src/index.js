@@ -3,6 +3,10 @@ import ReactDOM from 'react-dom';
 import './index.css';
 import App from './App';
 import * as serviceWorker from './serviceWorker';
+import { benchCommandBuffer, benchPartialRedraw } from './bench';
+import { startTrace, saveTrace } from './trace';
+import { memoryStatistics, setMemoryBudget } from './memory';
+import { UndoHistory } from './history';
 
 ReactDOM.render(
   <React.StrictMode>
@@ -15,3 +19,13 @@ ReactDOM.render(
 // unregister() to register() below. Note this comes with some pitfalls.
 // Learn more about service workers: https://bit.ly/CRA-PWA
 serviceWorker.unregister();
+
+if (process.env.NODE_ENV !== 'production') {
+  window.benchCommandBuffer = benchCommandBuffer;
+  window.benchPartialRedraw = benchPartialRedraw;
+  window.startTrace = startTrace;
+  window.saveTrace = saveTrace;
+  window.memoryStatistics = memoryStatistics;
+  window.setMemoryBudget = setMemoryBudget;
+  window.UndoHistory = UndoHistory;
+}
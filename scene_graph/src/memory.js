@@ -0,0 +1,43 @@
+// memorySubsystem values, see common/cpp/memory_accounting.h
+export const MEMORY_UNTAGGED = 0;
+export const MEMORY_SCENE = 1;
+export const MEMORY_TEXTURES = 2;
+export const MEMORY_FILTER = 3;
+export const MEMORY_PATHFINDING = 4;
+
+const SUBSYSTEMS = ["untagged", "scene", "textures", "filter", "pathfinding"];
+
+// Heap and GPU bytes of the scene module by subsystem, from the console: memoryStatistics().scene
+export function memoryStatistics() {
+  const Module = window.Module;
+  const size = Module.ccall("memoryStatisticsSize", "number", [], []);
+  const out = Module._malloc(size);
+  Module.ccall("memoryStatistics", null, ["number"], [out]);
+  const values = Module.HEAPF64.slice(out >> 3, (out + size) >> 3);
+  Module._free(out);
+
+  const counters = (offset) => ({
+    current: values[offset],
+    peak: values[offset + 1],
+    allocations: values[offset + 2],
+    frees: values[offset + 3],
+    churn: values[offset + 4],
+  });
+  const stats = { heapSize: values[0], heapInUse: values[1] };
+  SUBSYSTEMS.forEach((name, n) => {
+    const offset = 2 + n * 12;
+    stats[name] = {
+      heap: counters(offset),
+      gpu: counters(offset + 5),
+      budget: values[offset + 10],
+      evictions: values[offset + 11],
+    };
+  });
+  return stats;
+}
+
+// Soft budget in bytes, 0 for none. Over it the scene frees its software render target and
+// picking readback after the next frame.
+export function setMemoryBudget(bytes) {
+  window.Module.ccall("setMemoryBudget", null, ["number", "number"], [MEMORY_SCENE, bytes]);
+}
@@ -0,0 +1,22 @@
+// Records the WASM calls of a session into a trace for the native replay driver
+// (scene_graph/cpp/replay). From the console: startTrace(), use the app, then saveTrace().
+export function startTrace() {
+  window.Module.ccall("startRecording", null, [], []);
+}
+
+export function saveTrace(name = "session.trace") {
+  const Module = window.Module;
+  Module.ccall("stopRecording", null, [], []);
+  const pointer = Module.ccall("recordingData", "number", [], []);
+  const size = Module.ccall("recordingSize", "number", [], []);
+  const blob = new Blob([Module.HEAPU8.slice(pointer, pointer + size)], {
+    type: "application/octet-stream",
+  });
+
+  const link = document.createElement("a");
+  link.href = URL.createObjectURL(blob);
+  link.download = name;
+  link.click();
+  URL.revokeObjectURL(link.href);
+  return size;
+}
@@ -4,7 +4,13 @@
 #include <emscripten/html5.h>
 #include <string.h>
 #include <assert.h>
+#include <vector>
+#include "EdgeStatistics.h"
+#include "EdgePyramid.h"
+#include "EdgeBatch.h"
+#include "EdgeKernels.h"
 #include "Context.h"
+#include "../../common/cpp/memory_accounting.h"
 
 //Utils
 static GLuint compile_shader(GLenum shaderType, const char *src)
@@ -58,46 +64,10 @@ static const char texture_load_fragment_source[] =
     "  gl_FragColor = texture2D( texture, v_texCoord );   "
     "}                                ";
 
-static const char edge_detect_fragment_source[] =
-    "precision mediump float;                            "
-    "varying vec2 v_texCoord;                            "
-    "uniform sampler2D texture;                        "
-    "uniform float width;  "
-    "uniform float height;  "
-    "void main()                                         "
-    "{                                                   "
-    "  vec4 pixel = texture2D(texture, v_texCoord);              "
-    "  vec4 n[9];"
-
-    "  float w = 1.0 / width;"
-    "  float h = 1.0 / height;"
-
-    "  n[0] = texture2D(texture, v_texCoord + vec2(0.0, 0.0) );"
-    "  n[1] = texture2D(texture, v_texCoord + vec2(w, 0.0) );"
-    "  n[2] = texture2D(texture, v_texCoord + vec2(2.0*w, 0.0) );"
-    "  n[3] = texture2D(texture, v_texCoord + vec2(0.0*w, h) );"
-    "  n[4] = texture2D(texture, v_texCoord + vec2(w, h) );"
-    "  n[5] = texture2D(texture, v_texCoord + vec2(2.0*w, h) );"
-    "  n[6] = texture2D(texture, v_texCoord + vec2(0.0, 2.0*h) );"
-    "  n[7] = texture2D(texture, v_texCoord + vec2(w, 2.0*h) );"
-    "  n[8] = texture2D(texture, v_texCoord + vec2(2.0*w, 2.0*h) );"
-
-    "  vec4 sobel_x = n[2] + (2.0*n[5]) + n[8] - (n[0] + (2.0*n[3]) + n[6]);"
-    "  vec4 sobel_y = n[0] + (2.0*n[1]) + n[2] - (n[6] + (2.0*n[7]) + n[8]);"
-
-    "  float avg_x = (sobel_x.r + sobel_x.g + sobel_x.b) / 3.0;"
-    "  float avg_y = (sobel_y.r + sobel_y.g + sobel_y.b) / 3.0;"
-
-    "  sobel_x.r = avg_x;"
-    "  sobel_x.g = avg_x;"
-    "  sobel_x.b = avg_x;"
-    "  sobel_y.r = avg_y;"
-    "  sobel_y.g = avg_y;"
-    "  sobel_y.b = avg_y;"
-
-    "  vec3 sobel = vec3(sqrt((sobel_x.rgb * sobel_x.rgb) + (sobel_y.rgb * sobel_y.rgb)));"
-    "  gl_FragColor = vec4( sobel, 1.0 );   "
-    "}                                                   ";
+// Vertex data of texture bounds
+static const GLfloat quad_vertices[] = {-1.0, 1.0, 0.0, 0.0, 0.0, -1.0, -1.0, 0.0, 0.0, 1.0,
+                                        1.0, -1.0, 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 1.0, 0.0};
+static const GLushort quad_indices[] = {0, 1, 2, 0, 2, 3};
 
 Context::Context(int w, int h, char *id)
 {
@@ -106,7 +76,8 @@ Context::Context(int w, int h, char *id)
 
   // double dpr = emscripten_get_device_pixel_ratio();
   // emscripten_set_element_css_size(id, width / dpr, height / dpr);
-  // emscripten_set_canvas_element_size(id, width, height);
+  // Streamed images only know their size once decoding started
+  emscripten_set_canvas_element_size(id, width, height);
 
   // Context configurations
   // EmscriptenWebGLContextAttributes attrs;
@@ -134,72 +105,215 @@ Context::Context(int w, int h, char *id)
   emscripten_webgl_make_context_current(context);
   assert(context);
 
+  // Render targets for the statistics reduction
+  floatTargets = emscripten_webgl_enable_extension(context, "EXT_color_buffer_float");
+
+  memoryScope scope(MEMORY_FILTER);
+
   // Compile shaders
   vertexShader = compile_shader(GL_VERTEX_SHADER, vertex_source);
-  fragmentShader = compile_shader(GL_FRAGMENT_SHADER, edge_detect_fragment_source);
+  buildFilter();
+
+  glGenBuffers(1, &vertexObject);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexObject);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
+
+  glGenBuffers(1, &indexObject);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexObject);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_indices), quad_indices, GL_STATIC_DRAW);
+  memory_gpu_allocate(MEMORY_FILTER, sizeof(quad_vertices) + sizeof(quad_indices));
+
+  memory_add_evictor(MEMORY_FILTER, evict_context_caches, this);
+}
+
+void Context::buildFilter(void)
+{
+  const edgeKernelVariant &variant = edgeKernelVariants[edgeKernel];
+  bool separable = variant.horizontalSource && floatTargets;
+
+  glDeleteProgram(programObject);
+  glDeleteShader(fragmentShader);
+  glDeleteProgram(horizontalProgram);
+  glDeleteShader(horizontalShader);
+  horizontalProgram = horizontalShader = 0;
 
   // Build program
+  fragmentShader = compile_shader(GL_FRAGMENT_SHADER, separable ? variant.verticalSource : variant.source);
   programObject = create_program(vertexShader, fragmentShader);
 
   glBindAttribLocation(programObject, 0, "position");
 
   glLinkProgram(programObject);
   glValidateProgram(programObject);
+
+  if (separable)
+  {
+    horizontalShader = compile_shader(GL_FRAGMENT_SHADER, variant.horizontalSource);
+    horizontalProgram = create_program(vertexShader, horizontalShader);
+    glBindAttribLocation(horizontalProgram, 0, "position");
+    glLinkProgram(horizontalProgram);
+  }
 }
 
 Context::~Context(void)
 {
+  memory_remove_evictor(MEMORY_FILTER, evict_context_caches, this);
+  emscripten_webgl_make_context_current(context);
+  statsOut = nullptr;
+  releaseCaches();
+
+  // Destroying the context frees these too, but only once the browser collects it
+  glDeleteTextures(1, &texture);
+  memory_gpu_resize(MEMORY_TEXTURES, textureBytes, 0);
+  glDeleteBuffers(1, &vertexObject);
+  glDeleteBuffers(1, &indexObject);
+  memory_gpu_free(MEMORY_FILTER, sizeof(quad_vertices) + sizeof(quad_indices));
+  glDeleteProgram(programObject);
+  glDeleteProgram(horizontalProgram);
+  glDeleteShader(fragmentShader);
+  glDeleteShader(horizontalShader);
+  glDeleteShader(vertexShader);
   emscripten_webgl_destroy_context(context);
 }
 
+void Context::releaseCaches(void)
+{
+  emscripten_webgl_make_context_current(context);
+  delete pyramid;
+  delete batch;
+  pyramid = nullptr;
+  batch = nullptr;
+
+  glDeleteTextures(1, &passTexture);
+  glDeleteFramebuffers(1, &passFramebuffer);
+  passTexture = passFramebuffer = 0;
+  memory_gpu_resize(MEMORY_FILTER, passBytes, 0);
+
+  // A pending reduction still reads these
+  if (statsOut)
+    return;
+  delete reducer;
+  reducer = nullptr;
+  glDeleteTextures(1, &filterTexture);
+  glDeleteFramebuffers(1, &filterFramebuffer);
+  filterTexture = filterFramebuffer = 0;
+  memory_gpu_resize(MEMORY_FILTER, filterBytes, 0);
+}
+
+void Context::evict_context_caches(void *owner, int64_t excess)
+{
+  printf("[WASM] Filter memory %lld bytes over budget, releasing caches\n", (long long)excess);
+  ((Context *)owner)->releaseCaches();
+}
+
 void Context::run(uint8_t *buffer)
 {
+  beginTexture();
+  uploadRows(0, height, buffer);
+  draw();
+}
+
+void Context::beginTexture(void)
+{
+  memoryScope scope(MEMORY_TEXTURES);
+  emscripten_webgl_make_context_current(context);
+  if (texture)
+    glDeleteTextures(1, &texture);
+  if (pyramid)
+    pyramid->invalidate();
+
+  // Generate a texture object
+  glGenTextures(1, &texture);
+
+  // Bind it
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  // Storage only, the image comes in through uploadRows
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  memory_gpu_resize(MEMORY_TEXTURES, textureBytes, (int64_t)width * height * 4);
+}
+
+void Context::uploadRows(int y, int count, const uint8_t *rgba)
+{
+  emscripten_webgl_make_context_current(context);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, count, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+  if (pyramid)
+    pyramid->invalidate();
+}
 
+void Context::draw(void)
+{
   // Make the context current and use the program
   emscripten_webgl_make_context_current(context);
-  glUseProgram(programObject);
+  drawFilter(0);
+}
+
+void Context::drawFilter(GLuint framebuffer)
+{
+  memoryScope scope(MEMORY_FILTER);
+  if (edgeScales && !pyramid)
+  {
+    pyramid = new EdgePyramid(width, height);
+    if (!pyramid->valid)
+      printf("[WASM] Edge pyramid unavailable, using the plain filter\n");
+  }
+  if (edgeScales && pyramid->valid)
+  {
+    pyramid->draw(texture, edgeScales, framebuffer);
+    return;
+  }
+
+  if (!horizontalProgram)
+  {
+    drawPass(programObject, texture, framebuffer);
+    return;
+  }
+
+  // Rows first into the float target, then down the columns into framebuffer
+  if (!passFramebuffer)
+  {
+    glGenTextures(1, &passTexture);
+    glBindTexture(GL_TEXTURE_2D, passTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32F, width, height);
+    memory_gpu_resize(MEMORY_FILTER, passBytes, (int64_t)width * height * 8);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &passFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, passFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, passTexture, 0);
+  }
+  drawPass(horizontalProgram, texture, passFramebuffer);
+  drawPass(programObject, passTexture, framebuffer);
+}
 
-  GLuint texId;
-  GLuint vertexObject;
-  GLuint indexObject;
+void Context::drawPass(GLuint program, GLuint source, GLuint framebuffer)
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glUseProgram(program);
 
   // Get the attribute/sampler locations
-  GLint positionLoc = glGetAttribLocation(programObject, "position");
-  GLint texCoordLoc = glGetAttribLocation(programObject, "texCoord");
-  GLint textureLoc = glGetUniformLocation(programObject, "texture");
+  GLint positionLoc = glGetAttribLocation(program, "position");
+  GLint texCoordLoc = glGetAttribLocation(program, "texCoord");
+  GLint textureLoc = glGetUniformLocation(program, "texture");
 
   // For "ERROR :GL_INVALID_OPERATION : glUniform1i: wrong uniform function for type"
   // https://www.khronos.org/registry/OpenGL-Refpages/es3.0/html/glUniform.xhtml
-  float widthUniform = glGetUniformLocation(programObject, "width");
-  float heightUniform = glGetUniformLocation(programObject, "height");
+  float widthUniform = glGetUniformLocation(program, "width");
+  float heightUniform = glGetUniformLocation(program, "height");
   glUniform1f(widthUniform, (float)width);
   glUniform1f(heightUniform, (float)height);
 
-  // Generate a texture object
-  glGenTextures(1, &texId);
   glUniform1i(textureLoc, 0);
-
-  // Bind it
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texId);
-
-  // Load the texture from the image buffer
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, source);
 
-  // Vertex data of texture bounds
-  GLfloat vVertices[] = {-1.0, 1.0, 0.0, 0.0, 0.0, -1.0, -1.0, 0.0, 0.0, 1.0,
-                         1.0, -1.0, 0.0, 1.0, 1.0, 1.0, 1.0, 0.0, 1.0, 0.0};
-  GLushort indices[] = {0, 1, 2, 0, 2, 3};
-
-  glGenBuffers(1, &vertexObject);
   glBindBuffer(GL_ARRAY_BUFFER, vertexObject);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vVertices), vVertices, GL_STATIC_DRAW);
-
-  glGenBuffers(1, &indexObject);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexObject);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
   // Set the viewport
   glViewport(0, 0, width, height);
@@ -214,4 +328,119 @@ void Context::run(uint8_t *buffer)
 
   // Draw
   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-}
\ No newline at end of file
+
+  glDisableVertexAttribArray(positionLoc);
+  glDisableVertexAttribArray(texCoordLoc);
+}
+
+void Context::readLevels(std::vector<uint8_t> &levels)
+{
+  std::vector<uint8_t> pixels((size_t)width * height * 4);
+  glBindFramebuffer(GL_FRAMEBUFFER, filterFramebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  // Every channel holds the magnitude, keep red and flip to the image's row order
+  levels.resize((size_t)width * height);
+  for (int y = 0; y < height; y++)
+  {
+    const uint8_t *row = &pixels[(size_t)(height - 1 - y) * width * 4];
+    for (int x = 0; x < width; x++)
+      levels[(size_t)y * width + x] = row[x * 4];
+  }
+}
+
+int Context::requestStatistics(edgeStats *out, int mode)
+{
+  memoryScope scope(MEMORY_FILTER);
+  emscripten_webgl_make_context_current(context);
+  statsOut = nullptr;
+
+  if (!filterFramebuffer)
+  {
+    glGenTextures(1, &filterTexture);
+    glBindTexture(GL_TEXTURE_2D, filterTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    memory_gpu_resize(MEMORY_FILTER, filterBytes, (int64_t)width * height * 4);
+    glGenFramebuffers(1, &filterFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, filterFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, filterTexture, 0);
+  }
+  drawFilter(filterFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (!reducer && floatTargets)
+  {
+    reducer = new EdgeReducer(width, height);
+    if (!reducer->valid)
+      printf("[WASM] Float render targets unusable, statistics fall back to full readback\n");
+  }
+  bool gpu = reducer && reducer->valid;
+
+  if (mode != STATS_GPU || !gpu)
+  {
+    std::vector<uint8_t> levels;
+    readLevels(levels);
+    edge_stats_cpu(levels.data(), width, height, edgeThreshold, strongThreshold, mode == STATS_VERIFY && gpu ? statsExpected : *out);
+    if (mode != STATS_VERIFY || !gpu)
+      return STATS_READY;
+  }
+
+  reducer->reduce(filterTexture, edgeThreshold, strongThreshold);
+  glViewport(0, 0, width, height);
+  statsOut = out;
+  statsMode = mode;
+  return pollStatistics();
+}
+
+int Context::pollStatistics(void)
+{
+  if (!statsOut)
+    return STATS_ERROR;
+
+  emscripten_webgl_make_context_current(context);
+  int status = reducer->poll(*statsOut);
+  if (status == STATS_READY && statsMode == STATS_VERIFY && edge_stats_compare(statsExpected, *statsOut))
+    printf("[WASM] Statistics match the CPU reference\n");
+  if (status != STATS_PENDING)
+    statsOut = nullptr;
+  return status;
+}
+
+void Context::setStatisticsThresholds(int edge, int strong)
+{
+  edgeThreshold = edge;
+  strongThreshold = strong;
+}
+
+void Context::setEdgeScales(int mask)
+{
+  edgeScales = mask;
+}
+
+void Context::setEdgeKernel(int variant)
+{
+  if (variant < 0 || variant >= edgeKernelVariantCount || variant == edgeKernel)
+    return;
+  memoryScope scope(MEMORY_FILTER);
+  emscripten_webgl_make_context_current(context);
+  edgeKernel = variant;
+  buildFilter();
+}
+
+int Context::processBatch(const uint8_t *pixels, const int32_t *sizes, int count, uint8_t *output, atlasRegion *regions)
+{
+  memoryScope scope(MEMORY_FILTER);
+  emscripten_webgl_make_context_current(context);
+  if (!batch)
+    batch = new EdgeBatch();
+  if (!batch->valid)
+    return -1;
+
+  int layers = batch->process(pixels, sizes, count, output, regions);
+  glViewport(0, 0, width, height);
+  return layers;
+}
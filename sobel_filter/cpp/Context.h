@@ -5,15 +5,89 @@ public:
 
   ~Context(void);
 
+  // Uploads a width x height RGBA image and runs the filter on it
   void run(uint8_t *buffer);
 
+  // The same in steps: allocate the texture, upload rows as they arrive, then run the filter
+  void beginTexture(void);
+  void uploadRows(int y, int count, const uint8_t *rgba);
+  void draw(void);
+
+  // Computes edgeStats of the current image into out, which has to stay allocated until the result
+  // is in. Returns a statsStatus, after STATS_PENDING pollStatistics says when out is filled.
+  int requestStatistics(edgeStats *out, int mode);
+  int pollStatistics(void);
+  void setStatisticsThresholds(int edge, int strong);
+
+  // Runs the filter on the Gaussian pyramid levels in mask (bit n for level n, each half the size of
+  // the one before) and combines them, 0 for the plain full-resolution filter
+  void setEdgeScales(int mask);
+
+  // Picks the plain filter from edgeKernelVariants. Separable variants render in two passes when
+  // float targets are there and fall back to their single-pass source otherwise.
+  void setEdgeKernel(int variant);
+
+  // Filters many images at once on a packed atlas, see EdgeBatch::process. Independent of the
+  // context's own image and size.
+  int processBatch(const uint8_t *pixels, const int32_t *sizes, int count, uint8_t *output, atlasRegion *regions);
+
+  // Full-frame readback of the last statistics render as output levels, first row at the top
+  void readLevels(std::vector<uint8_t> &levels);
+
+  // Frees the pyramid, the batch atlas and the offscreen targets, which are all made again when next
+  // needed. The statistics targets stay while a reduction is pending. Runs as the filter's evictor
+  // when it goes over its memory budget.
+  void releaseCaches(void);
+
 private:
+  static void evict_context_caches(void *owner, int64_t excess);
+
+  // Renders the filter into framebuffer
+  void drawFilter(GLuint framebuffer);
+
+  // Builds the programs of edgeKernel
+  void buildFilter(void);
+
+  // One full-screen pass of program over source into framebuffer
+  void drawPass(GLuint program, GLuint source, GLuint framebuffer);
+
   int width;
   int height;
 
-  GLuint programObject;
-  GLuint vertexShader;
-  GLuint fragmentShader;
+  GLuint texture = 0;
+  int64_t textureBytes = 0;
+
+  // Full-screen quad shared by every pass
+  GLuint vertexObject = 0;
+  GLuint indexObject = 0;
+
+  int edgeScales = 0;
+  EdgePyramid *pyramid = nullptr;
+  EdgeBatch *batch = nullptr;
+
+  // Offscreen copy of the filter output for the statistics
+  GLuint filterTexture = 0;
+  GLuint filterFramebuffer = 0;
+  int64_t filterBytes = 0;
+  bool floatTargets = false;
+  EdgeReducer *reducer = nullptr;
+  edgeStats *statsOut = nullptr;
+  edgeStats statsExpected;
+  int statsMode = STATS_GPU;
+  int edgeThreshold = STATS_EDGE_THRESHOLD;
+  int strongThreshold = STATS_STRONG_THRESHOLD;
+
+  GLuint programObject = 0;
+  GLuint vertexShader = 0;
+  GLuint fragmentShader = 0;
+
+  // First pass of a separable kernel and its float target
+  int edgeKernel = 0;
+  GLuint horizontalProgram = 0;
+  GLuint horizontalShader = 0;
+  GLuint passTexture = 0;
+  GLuint passFramebuffer = 0;
+  int64_t passBytes = 0;
 
   EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context;
 };
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "EdgeBatch.h"
+#include "../../common/cpp/memory_accounting.h"
+
+//Shaders
+// A quad per instance over the image's region of the layer
+static const char batch_vertex_source[] =
+    "#version 300 es\n"
+    "layout(location = 0) in ivec4 rect;\n"
+    "uniform float layerSize;\n"
+    "flat out ivec4 region;\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "  vec2 p = (vec2(rect.xy) + corner * vec2(rect.zw)) / layerSize;\n"
+    "  gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+    "  region = rect;\n"
+    "}\n";
+
+// The default Sobel 3x3 filter on texels, wrapping within the region
+static const char batch_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "precision highp sampler2DArray;\n"
+    "uniform sampler2DArray atlas;\n"
+    "uniform int layer;\n"
+    "flat in ivec4 region;\n"
+    "out vec4 color;\n"
+    "vec4 tap(ivec2 p, int i, int j)\n"
+    "{\n"
+    "  ivec2 q = p + ivec2(i, j);\n"
+    "  q -= region.zw * ivec2(greaterThanEqual(q, region.zw));\n"
+    "  return texelFetch(atlas, ivec3(region.xy + q, layer), 0);\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy) - region.xy;\n"
+    "  vec4 n[9];\n"
+    "  n[0] = tap(p, 0, 0);\n"
+    "  n[1] = tap(p, 1, 0);\n"
+    "  n[2] = tap(p, 2, 0);\n"
+    "  n[3] = tap(p, 0, 1);\n"
+    "  n[4] = tap(p, 1, 1);\n"
+    "  n[5] = tap(p, 2, 1);\n"
+    "  n[6] = tap(p, 0, 2);\n"
+    "  n[7] = tap(p, 1, 2);\n"
+    "  n[8] = tap(p, 2, 2);\n"
+    "  vec4 sobel_x = n[2] + (2.0*n[5]) + n[8] - (n[0] + (2.0*n[3]) + n[6]);\n"
+    "  vec4 sobel_y = n[0] + (2.0*n[1]) + n[2] - (n[6] + (2.0*n[7]) + n[8]);\n"
+    "  float avg_x = (sobel_x.r + sobel_x.g + sobel_x.b) / 3.0;\n"
+    "  float avg_y = (sobel_y.r + sobel_y.g + sobel_y.b) / 3.0;\n"
+    "  sobel_x.r = avg_x;\n"
+    "  sobel_x.g = avg_x;\n"
+    "  sobel_x.b = avg_x;\n"
+    "  sobel_y.r = avg_y;\n"
+    "  sobel_y.g = avg_y;\n"
+    "  sobel_y.b = avg_y;\n"
+    "  vec3 sobel = vec3(sqrt((sobel_x.rgb * sobel_x.rgb) + (sobel_y.rgb * sobel_y.rgb)));\n"
+    "  color = vec4(sobel, 1.0);\n"
+    "}\n";
+
+//Utils
+static GLuint compile_batch_shader(GLenum shaderType, const char *src)
+{
+  GLuint shader = glCreateShader(shaderType);
+  glShaderSource(shader, 1, &src, NULL);
+  glCompileShader(shader);
+
+  GLint compiled;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled)
+  {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("[WASM] Batch shader: %s\n", log);
+  }
+  return shader;
+}
+
+int atlas_pack(const int32_t *sizes, int count, int layerSize, atlasRegion *regions)
+{
+  std::vector<int> order(count);
+  for (int i = 0; i < count; i++)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sizes[a * 2 + 1] > sizes[b * 2 + 1]; });
+
+  int layer = 0, x = 0, y = 0, shelfHeight = 0;
+  for (int i : order)
+  {
+    int width = sizes[i * 2], height = sizes[i * 2 + 1];
+    if (width > layerSize || height > layerSize)
+      return -1;
+
+    // Next shelf, then next layer
+    if (x + width > layerSize)
+    {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+    if (y + height > layerSize)
+    {
+      layer++;
+      x = y = 0;
+    }
+
+    regions[i] = {layer, x, y, width, height};
+    x += width;
+    shelfHeight = std::max(shelfHeight, height);
+  }
+  return count ? layer + 1 : 0;
+}
+
+EdgeBatch::EdgeBatch(void)
+{
+  GLint maxSize;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  layerSize = std::min(ATLAS_LAYER_SIZE, (int)maxSize);
+
+  vertexShader = compile_batch_shader(GL_VERTEX_SHADER, batch_vertex_source);
+  fragmentShader = compile_batch_shader(GL_FRAGMENT_SHADER, batch_fragment_source);
+  program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+  GLint linked;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  valid = linked;
+
+  // Per instance x, y, width and height
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+  glGenBuffers(1, &instanceBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  glEnableVertexAttribArray(0);
+  glVertexAttribIPointer(0, 4, GL_INT, 0, 0);
+  glVertexAttribDivisor(0, 1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer);
+  staging.resize((size_t)layerSize * layerSize * 4);
+}
+
+EdgeBatch::~EdgeBatch(void)
+{
+  glDeleteTextures(1, &atlas);
+  glDeleteTextures(1, &result);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteBuffers(1, &instanceBuffer);
+  memory_gpu_resize(MEMORY_FILTER, atlasBytes, 0);
+  memory_gpu_resize(MEMORY_FILTER, instanceBytes, 0);
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteProgram(program);
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+}
+
+void EdgeBatch::reserve(int layers)
+{
+  if (layers <= layerCount)
+    return;
+
+  glDeleteTextures(1, &atlas);
+  glDeleteTextures(1, &result);
+  GLuint *textures[2] = {&atlas, &result};
+  for (GLuint *texture : textures)
+  {
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, layerSize, layerSize, layers);
+  }
+  layerCount = layers;
+  memory_gpu_resize(MEMORY_FILTER, atlasBytes, (int64_t)layerSize * layerSize * 4 * layers * 2);
+}
+
+int EdgeBatch::process(const uint8_t *pixels, const int32_t *sizes, int count, uint8_t *output, atlasRegion *regions)
+{
+  packed.resize(count);
+  int layers = atlas_pack(sizes, count, layerSize, packed.data());
+  if (layers < 0)
+    return -1;
+  if (regions)
+    memcpy(regions, packed.data(), count * sizeof(atlasRegion));
+
+  // Where each image starts in pixels and output, and the images by layer
+  std::vector<size_t> offsets(count);
+  std::vector<int> byLayer(count);
+  std::vector<int> layerStart(layers + 1, 0);
+  size_t offset = 0;
+  for (int i = 0; i < count; i++)
+  {
+    offsets[i] = offset;
+    offset += (size_t)packed[i].width * packed[i].height * 4;
+    layerStart[packed[i].layer + 1]++;
+  }
+  for (int l = 0; l < layers; l++)
+    layerStart[l + 1] += layerStart[l];
+  std::vector<int> cursor(layerStart.begin(), layerStart.end() - 1);
+  for (int i = 0; i < count; i++)
+    byLayer[cursor[packed[i].layer]++] = i;
+
+  // Rows of each layer that hold images
+  std::vector<int> layerRows(layers, 0);
+  for (const atlasRegion &region : packed)
+    layerRows[region.layer] = std::max(layerRows[region.layer], region.y + region.height);
+
+  reserve(std::min(layers, ATLAS_MAX_LAYERS));
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  const size_t stride = (size_t)layerSize * 4;
+  for (int first = 0; first < layers; first += ATLAS_MAX_LAYERS)
+  {
+    int last = std::min(first + ATLAS_MAX_LAYERS, layers);
+
+    // One upload per layer
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+    for (int l = first; l < last; l++)
+    {
+      for (int n = layerStart[l]; n < layerStart[l + 1]; n++)
+      {
+        const atlasRegion &region = packed[byLayer[n]];
+        const uint8_t *image = pixels + offsets[byLayer[n]];
+        for (int y = 0; y < region.height; y++)
+          memcpy(&staging[(region.y + y) * stride + region.x * 4], image + (size_t)y * region.width * 4, region.width * 4);
+      }
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, l - first, layerSize, layerRows[l], 1, GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+    }
+
+    // One draw per layer
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "atlas"), 0);
+    glUniform1f(glGetUniformLocation(program, "layerSize"), (float)layerSize);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, layerSize, layerSize);
+    for (int l = first; l < last; l++)
+    {
+      instances.clear();
+      for (int n = layerStart[l]; n < layerStart[l + 1]; n++)
+      {
+        const atlasRegion &region = packed[byLayer[n]];
+        instances.insert(instances.end(), {region.x, region.y, region.width, region.height});
+      }
+      glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(int32_t), instances.data(), GL_STREAM_DRAW);
+      memory_gpu_resize(MEMORY_FILTER, instanceBytes, instances.size() * sizeof(int32_t));
+      glUniform1i(glGetUniformLocation(program, "layer"), l - first);
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, result, 0, l - first);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances.size() / 4);
+    }
+    glBindVertexArray(0);
+
+    // Read back and split into the images
+    for (int l = first; l < last; l++)
+    {
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, result, 0, l - first);
+      glReadPixels(0, 0, layerSize, layerRows[l], GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+      for (int n = layerStart[l]; n < layerStart[l + 1]; n++)
+      {
+        const atlasRegion &region = packed[byLayer[n]];
+        uint8_t *image = output + offsets[byLayer[n]];
+        for (int y = 0; y < region.height; y++)
+          memcpy(image + (size_t)y * region.width * 4, &staging[(region.y + y) * stride + region.x * 4], region.width * 4);
+      }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+  return layers;
+}
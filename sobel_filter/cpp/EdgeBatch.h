@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <GLES3/gl3.h>
+
+// Side of an atlas layer, smaller when the GL maximum texture size is
+#define ATLAS_LAYER_SIZE 1024
+
+// Layers filtered per round, larger batches take several
+#define ATLAS_MAX_LAYERS 4
+
+// Where an image went in the atlas
+struct atlasRegion
+{
+  int32_t layer;
+  int32_t x;
+  int32_t y;
+  int32_t width;
+  int32_t height;
+};
+
+// Shelf-packs count images, sizes holds width and height pairs, into layers of layerSize squared.
+// Tallest images go first. Returns the number of layers, or -1 if an image is larger than a layer.
+int atlas_pack(const int32_t *sizes, int count, int layerSize, atlasRegion *regions);
+
+// Runs the edge filter over many small images at once. They are packed into the layers of a 2D
+// array texture, each layer is uploaded with one call and filtered with one instanced draw of a
+// quad per image. The stencil wraps around within each image's own region like the single-image
+// filter's repeating texture does, so nothing bleeds between neighbours and no padding is needed.
+// Results are those of Context::run up to a level of float rounding. Needs WebGL 2.
+class EdgeBatch
+{
+public:
+  // The context has to be current
+  EdgeBatch(void);
+
+  ~EdgeBatch(void);
+
+  // False when the shaders didn't build
+  bool valid = false;
+
+  // Filters count RGBA images stored back to back in pixels, first row at the top, with sizes as for
+  // atlas_pack. output gets the results in the same layout, regions (may be null) where each image
+  // was in its round's atlas. Returns the number of layers used or -1 when an image doesn't fit one.
+  int process(const uint8_t *pixels, const int32_t *sizes, int count, uint8_t *output, atlasRegion *regions);
+
+private:
+  // Storage for layers layers, grown on demand
+  void reserve(int layers);
+
+  int layerSize;
+  int layerCount = 0;
+  GLuint atlas = 0;
+  GLuint result = 0;
+  // GPU bytes of both atlases and of the last instance upload
+  int64_t atlasBytes = 0;
+  int64_t instanceBytes = 0;
+  GLuint framebuffer = 0;
+
+  GLuint vertexShader = 0;
+  GLuint fragmentShader = 0;
+  GLuint program = 0;
+  GLuint vertexArray = 0;
+  GLuint instanceBuffer = 0;
+
+  // One layer's pixels on their way to and from the GPU
+  std::vector<uint8_t> staging;
+  std::vector<atlasRegion> packed;
+  std::vector<int32_t> instances;
+};
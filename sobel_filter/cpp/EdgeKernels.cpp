@@ -0,0 +1,17 @@
+#include "EdgeKernels.h"
+
+// The shaders are generated when this compiles, only the finished sources end up in the binary
+const edgeKernelVariant edgeKernelVariants[] = {
+    kernel_variant<sobel3Kernel, KERNEL_RGB>("Sobel 3x3"),
+    kernel_variant<sobel3Kernel, KERNEL_GRAY>("Sobel 3x3 gray"),
+    separable_kernel_variant<sobel3Kernel, KERNEL_GRAY>("Sobel 3x3 gray, separable"),
+    kernel_variant<sobel3Kernel, KERNEL_RED>("Sobel 3x3 red"),
+    kernel_variant<prewitt3Kernel, KERNEL_GRAY>("Prewitt 3x3 gray"),
+    separable_kernel_variant<prewitt3Kernel, KERNEL_GRAY>("Prewitt 3x3 gray, separable"),
+    kernel_variant<scharr3Kernel, KERNEL_GRAY>("Scharr 3x3 gray"),
+    separable_kernel_variant<scharr3Kernel, KERNEL_GRAY>("Scharr 3x3 gray, separable"),
+    kernel_variant<sobel5Kernel, KERNEL_GRAY>("Sobel 5x5 gray"),
+    separable_kernel_variant<sobel5Kernel, KERNEL_GRAY>("Sobel 5x5 gray, separable"),
+};
+
+const int edgeKernelVariantCount = sizeof(edgeKernelVariants) / sizeof(edgeKernelVariants[0]);
@@ -0,0 +1,540 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+// Largest kernel side the generator takes
+#define KERNEL_MAX_SIZE 7
+
+// Capacity of a generated shader source
+#define KERNEL_SOURCE_SIZE 4096
+
+// What a tap reads from the image
+enum kernelChannels
+{
+  // Convolves red, green and blue and averages the results, like the original shader
+  KERNEL_RGB = 0,
+  // Convolves the average of red, green and blue
+  KERNEL_GRAY = 1,
+  // Convolves red alone, for single-channel inputs
+  KERNEL_RED = 2,
+};
+
+// Gradient kernel pairs, weights row by row from the top left of the window. The window starts at
+// the output pixel and extends right and down, where the original 3x3 shader read it from.
+struct sobel3Kernel
+{
+  static constexpr const char *name = "Sobel 3x3";
+  static constexpr int size = 3;
+  static constexpr int x[9] = {-1, 0, 1, -2, 0, 2, -1, 0, 1};
+  static constexpr int y[9] = {1, 2, 1, 0, 0, 0, -1, -2, -1};
+};
+
+struct prewitt3Kernel
+{
+  static constexpr const char *name = "Prewitt 3x3";
+  static constexpr int size = 3;
+  static constexpr int x[9] = {-1, 0, 1, -1, 0, 1, -1, 0, 1};
+  static constexpr int y[9] = {1, 1, 1, 0, 0, 0, -1, -1, -1};
+};
+
+struct scharr3Kernel
+{
+  static constexpr const char *name = "Scharr 3x3";
+  static constexpr int size = 3;
+  static constexpr int x[9] = {-3, 0, 3, -10, 0, 10, -3, 0, 3};
+  static constexpr int y[9] = {3, 10, 3, 0, 0, 0, -3, -10, -3};
+};
+
+struct sobel5Kernel
+{
+  static constexpr const char *name = "Sobel 5x5";
+  static constexpr int size = 5;
+  static constexpr int x[25] = {-1, -2, 0, 2, 1,
+                                -4, -8, 0, 8, 4,
+                                -6, -12, 0, 12, 6,
+                                -4, -8, 0, 8, 4,
+                                -1, -2, 0, 2, 1};
+  static constexpr int y[25] = {1, 4, 6, 4, 1,
+                                2, 8, 12, 8, 2,
+                                0, 0, 0, 0, 0,
+                                -2, -8, -12, -8, -2,
+                                -1, -4, -6, -4, -1};
+};
+
+// ------ Compile-time text
+
+template <size_t N>
+struct kernelText
+{
+  char text[N] = {};
+  size_t length = 0;
+
+  constexpr void add(const char *s)
+  {
+    while (*s)
+      text[length++] = *s++;
+  }
+
+  constexpr void add(int value)
+  {
+    if (value < 0)
+    {
+      text[length++] = '-';
+      value = -value;
+    }
+    char digits[12] = {};
+    int count = 0;
+    do
+    {
+      digits[count++] = '0' + value % 10;
+      value /= 10;
+    } while (value);
+    while (count)
+      text[length++] = digits[--count];
+  }
+
+  // A GLSL float literal of an integer
+  constexpr void addFloat(int value)
+  {
+    add(value);
+    add(".0");
+  }
+};
+
+// ------ Kernel analysis
+
+// Sum of the positive weights, a full black to white step gives this response. Outputs are scaled
+// to the Sobel 3x3 one of 4 so the kernels are interchangeable.
+constexpr int kernel_gain(const int *weights, int size)
+{
+  int gain = 0;
+  for (int i = 0; i < size * size; i++)
+    gain += weights[i] > 0 ? weights[i] : 0;
+  return gain;
+}
+
+// weights as the outer product col x row of two integer vectors, when they are one
+struct kernelFactors
+{
+  bool separable = false;
+  int row[KERNEL_MAX_SIZE] = {};
+  int col[KERNEL_MAX_SIZE] = {};
+};
+
+constexpr int kernel_gcd(int a, int b)
+{
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  while (b)
+  {
+    int r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+constexpr kernelFactors kernel_factor(const int *weights, int size)
+{
+  kernelFactors factors;
+
+  int pivot = 0;
+  while (pivot < size * size && !weights[pivot])
+    pivot++;
+  if (pivot == size * size)
+    return factors;
+
+  // The pivot's row with common factors moved into the column
+  int pivotRow = pivot / size, pivotCol = pivot % size;
+  int divisor = 0;
+  for (int i = 0; i < size; i++)
+    divisor = kernel_gcd(divisor, weights[pivotRow * size + i]);
+  for (int i = 0; i < size; i++)
+    factors.row[i] = weights[pivotRow * size + i] / divisor;
+  for (int j = 0; j < size; j++)
+  {
+    if (weights[j * size + pivotCol] % factors.row[pivotCol])
+      return factors;
+    factors.col[j] = weights[j * size + pivotCol] / factors.row[pivotCol];
+  }
+  for (int j = 0; j < size; j++)
+    for (int i = 0; i < size; i++)
+      if (factors.col[j] * factors.row[i] != weights[j * size + i])
+        return factors;
+
+  factors.separable = true;
+  return factors;
+}
+
+template <typename K>
+constexpr bool kernel_separable(void)
+{
+  return kernel_factor(K::x, K::size).separable && kernel_factor(K::y, K::size).separable;
+}
+
+// ------ GLSL generation
+
+// Appends the weighted sum of the variables prefix0, prefix1... suffix, skipping zero weights and
+// folding ones into plain additions
+template <size_t N>
+constexpr void add_weighted_sum(kernelText<N> &text, const int *weights, int count, const char *prefix, const char *suffix, const char *zero)
+{
+  bool first = true;
+  for (int i = 0; i < count; i++)
+  {
+    int weight = weights[i];
+    if (!weight)
+      continue;
+    int magnitude = weight < 0 ? -weight : weight;
+    if (first)
+      text.add(weight < 0 ? "-" : "");
+    else
+      text.add(weight < 0 ? " - " : " + ");
+    if (magnitude != 1)
+    {
+      text.addFloat(magnitude);
+      text.add(" * ");
+    }
+    text.add(prefix);
+    text.add(i);
+    text.add(suffix);
+    first = false;
+  }
+  if (first)
+    text.add(zero);
+}
+
+// Declarations shared by every pass. Taps address texel centers from the quad's texture
+// coordinates, the texture's repeat wrap decides the borders.
+template <size_t N>
+constexpr void add_header(kernelText<N> &text, int channels)
+{
+  text.add("precision highp float;\n"
+           "varying vec2 v_texCoord;\n"
+           "uniform sampler2D texture;\n"
+           "uniform float width;\n"
+           "uniform float height;\n");
+  if (channels == KERNEL_GRAY)
+    text.add("float tap(vec2 p)\n"
+             "{\n"
+             "  vec4 c = texture2D(texture, p / vec2(width, height));\n"
+             "  return (c.r + c.g + c.b) / 3.0;\n"
+             "}\n");
+  else if (channels == KERNEL_RED)
+    text.add("float tap(vec2 p)\n"
+             "{\n"
+             "  return texture2D(texture, p / vec2(width, height)).r;\n"
+             "}\n");
+  else
+    text.add("vec4 tap(vec2 p)\n"
+             "{\n"
+             "  return texture2D(texture, p / vec2(width, height));\n"
+             "}\n");
+}
+
+// Writes magnitude, scaled by the kernel gain, as the output
+template <size_t N>
+constexpr void add_output(kernelText<N> &text, int gain)
+{
+  text.add("  float magnitude = sqrt(x * x + y * y)");
+  if (gain != 4)
+  {
+    text.add(" * 4.0 / ");
+    text.addFloat(gain);
+  }
+  text.add(";\n"
+           "  gl_FragColor = vec4(vec3(magnitude), 1.0);\n"
+           "}\n");
+}
+
+// Single pass over the whole window, output laid out like the canvas
+template <typename K, int C>
+constexpr kernelText<KERNEL_SOURCE_SIZE> kernel_shader(void)
+{
+  kernelText<KERNEL_SOURCE_SIZE> text;
+  add_header(text, C);
+  text.add("void main()\n"
+           "{\n"
+           "  vec2 p = v_texCoord * vec2(width, height);\n");
+
+  const char *type = C == KERNEL_RGB ? "vec4" : "float";
+  for (int i = 0; i < K::size * K::size; i++)
+  {
+    if (!K::x[i] && !K::y[i])
+      continue;
+    text.add("  ");
+    text.add(type);
+    text.add(" t");
+    text.add(i);
+    text.add(" = tap(p + vec2(");
+    text.addFloat(i % K::size);
+    text.add(", ");
+    text.addFloat(i / K::size);
+    text.add("));\n");
+  }
+
+  if (C == KERNEL_RGB)
+  {
+    text.add("  vec4 gx = ");
+    add_weighted_sum(text, K::x, K::size * K::size, "t", "", "vec4(0.0)");
+    text.add(";\n  vec4 gy = ");
+    add_weighted_sum(text, K::y, K::size * K::size, "t", "", "vec4(0.0)");
+    text.add(";\n"
+             "  float x = (gx.r + gx.g + gx.b) / 3.0;\n"
+             "  float y = (gy.r + gy.g + gy.b) / 3.0;\n");
+  }
+  else
+  {
+    text.add("  float x = ");
+    add_weighted_sum(text, K::x, K::size * K::size, "t", "", "0.0");
+    text.add(";\n  float y = ");
+    add_weighted_sum(text, K::y, K::size * K::size, "t", "", "0.0");
+    text.add(";\n");
+  }
+
+  add_output(text, kernel_gain(K::x, K::size));
+  return text;
+}
+
+// First separable pass: the row factors of x and y along each image row, into the red and green of
+// a float target with the image's first row at the bottom
+template <typename K, int C>
+constexpr kernelText<KERNEL_SOURCE_SIZE> kernel_horizontal_shader(void)
+{
+  static_assert(C != KERNEL_RGB, "separable passes convolve one channel");
+  constexpr kernelFactors fx = kernel_factor(K::x, K::size);
+  constexpr kernelFactors fy = kernel_factor(K::y, K::size);
+
+  kernelText<KERNEL_SOURCE_SIZE> text;
+  add_header(text, C);
+  text.add("void main()\n"
+           "{\n"
+           "  vec2 p = vec2(v_texCoord.x, 1.0 - v_texCoord.y) * vec2(width, height);\n");
+  for (int i = 0; i < K::size; i++)
+  {
+    if (!fx.row[i] && !fy.row[i])
+      continue;
+    text.add("  float t");
+    text.add(i);
+    text.add(" = tap(p + vec2(");
+    text.addFloat(i);
+    text.add(", 0.0));\n");
+  }
+  text.add("  gl_FragColor = vec4(");
+  add_weighted_sum(text, fx.row, K::size, "t", "", "0.0");
+  text.add(", ");
+  add_weighted_sum(text, fy.row, K::size, "t", "", "0.0");
+  text.add(", 0.0, 1.0);\n"
+           "}\n");
+  return text;
+}
+
+// Second separable pass: the column factors down the first pass' output, laid out like the canvas
+template <typename K, int C>
+constexpr kernelText<KERNEL_SOURCE_SIZE> kernel_vertical_shader(void)
+{
+  constexpr kernelFactors fx = kernel_factor(K::x, K::size);
+  constexpr kernelFactors fy = kernel_factor(K::y, K::size);
+
+  kernelText<KERNEL_SOURCE_SIZE> text;
+  add_header(text, KERNEL_RGB);
+  text.add("void main()\n"
+           "{\n"
+           "  vec2 p = v_texCoord * vec2(width, height);\n");
+  for (int j = 0; j < K::size; j++)
+  {
+    if (!fx.col[j] && !fy.col[j])
+      continue;
+    text.add("  vec2 t");
+    text.add(j);
+    text.add(" = tap(p + vec2(0.0, ");
+    text.addFloat(j);
+    text.add(")).rg;\n");
+  }
+  text.add("  float x = ");
+  add_weighted_sum(text, fx.col, K::size, "t", ".x", "0.0");
+  text.add(";\n  float y = ");
+  add_weighted_sum(text, fy.col, K::size, "t", ".y", "0.0");
+  text.add(";\n");
+  add_output(text, kernel_gain(K::x, K::size));
+  return text;
+}
+
+// ------ CPU kernels
+
+// Accumulates like the generated weighted sums: the first term, then the others added or subtracted
+// in order. Texels wrap around like the repeating texture.
+struct kernelImage
+{
+  const uint8_t *rgba;
+  int width;
+  int height;
+
+  void tap(int x, int y, int channels, float out[3]) const
+  {
+    const uint8_t *pixel = rgba + ((size_t)(y % height) * width + x % width) * 4;
+    if (channels == KERNEL_RGB)
+    {
+      for (int c = 0; c < 3; c++)
+        out[c] = pixel[c] / 255.0f;
+    }
+    else if (channels == KERNEL_GRAY)
+      out[0] = (pixel[0] / 255.0f + pixel[1] / 255.0f + pixel[2] / 255.0f) / 3.0f;
+    else
+      out[0] = pixel[0] / 255.0f;
+  }
+};
+
+static inline float kernel_accumulate(float sum, bool first, int weight, float value)
+{
+  int magnitude = weight < 0 ? -weight : weight;
+  float term = magnitude == 1 ? value : (float)magnitude * value;
+  if (first)
+    return weight < 0 ? -term : term;
+  return weight < 0 ? sum - term : sum + term;
+}
+
+static inline uint8_t kernel_level(float x, float y, int gain)
+{
+  float magnitude = sqrtf(x * x + y * y);
+  if (gain != 4)
+    magnitude = magnitude * 4.0f / (float)gain;
+  magnitude = magnitude > 1.0f ? 1.0f : magnitude;
+  return (uint8_t)(magnitude * 255.0f + 0.5f);
+}
+
+// What kernel_shader<K, C> renders, as output levels with the first row at the top
+template <typename K, int C>
+void kernel_levels_cpu(const uint8_t *rgba, int width, int height, uint8_t *levels)
+{
+  const kernelImage image = {rgba, width, height};
+  const int channels = C == KERNEL_RGB ? 3 : 1;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float gx[3] = {}, gy[3] = {};
+      bool firstX = true, firstY = true;
+      for (int i = 0; i < K::size * K::size; i++)
+      {
+        if (!K::x[i] && !K::y[i])
+          continue;
+        float t[3];
+        image.tap(x + i % K::size, y + i / K::size, C, t);
+        for (int c = 0; c < channels; c++)
+        {
+          if (K::x[i])
+            gx[c] = kernel_accumulate(gx[c], firstX, K::x[i], t[c]);
+          if (K::y[i])
+            gy[c] = kernel_accumulate(gy[c], firstY, K::y[i], t[c]);
+        }
+        firstX = firstX && !K::x[i];
+        firstY = firstY && !K::y[i];
+      }
+      float sumX = C == KERNEL_RGB ? (gx[0] + gx[1] + gx[2]) / 3.0f : gx[0];
+      float sumY = C == KERNEL_RGB ? (gy[0] + gy[1] + gy[2]) / 3.0f : gy[0];
+      levels[(size_t)y * width + x] = kernel_level(sumX, sumY, kernel_gain(K::x, K::size));
+    }
+  }
+}
+
+// What the two separable passes of K render
+template <typename K, int C>
+void kernel_levels_separable_cpu(const uint8_t *rgba, int width, int height, uint8_t *levels)
+{
+  constexpr kernelFactors fx = kernel_factor(K::x, K::size);
+  constexpr kernelFactors fy = kernel_factor(K::y, K::size);
+  const kernelImage image = {rgba, width, height};
+
+  // Red and green of the first pass, in float like the target
+  float *rows = new float[(size_t)width * height * 2];
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float a = 0.0f, b = 0.0f;
+      bool firstA = true, firstB = true;
+      for (int i = 0; i < K::size; i++)
+      {
+        if (!fx.row[i] && !fy.row[i])
+          continue;
+        float t[3];
+        image.tap(x + i, y, C, t);
+        if (fx.row[i])
+          a = kernel_accumulate(a, firstA, fx.row[i], t[0]);
+        if (fy.row[i])
+          b = kernel_accumulate(b, firstB, fy.row[i], t[0]);
+        firstA = firstA && !fx.row[i];
+        firstB = firstB && !fy.row[i];
+      }
+      rows[((size_t)y * width + x) * 2] = a;
+      rows[((size_t)y * width + x) * 2 + 1] = b;
+    }
+  }
+
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float sumX = 0.0f, sumY = 0.0f;
+      bool firstX = true, firstY = true;
+      for (int j = 0; j < K::size; j++)
+      {
+        const float *t = &rows[((size_t)((y + j) % height) * width + x) * 2];
+        if (fx.col[j])
+          sumX = kernel_accumulate(sumX, firstX, fx.col[j], t[0]);
+        if (fy.col[j])
+          sumY = kernel_accumulate(sumY, firstY, fy.col[j], t[1]);
+        firstX = firstX && !fx.col[j];
+        firstY = firstY && !fy.col[j];
+      }
+      levels[(size_t)y * width + x] = kernel_level(sumX, sumY, kernel_gain(K::x, K::size));
+    }
+  }
+  delete[] rows;
+}
+
+// ------ Variants
+
+// A generated filter. Separable ones carry both passes and the single-pass source as a fallback
+// for when float targets are missing.
+struct edgeKernelVariant
+{
+  const char *name;
+  const char *source;
+  const char *horizontalSource;
+  const char *verticalSource;
+  void (*cpu)(const uint8_t *rgba, int width, int height, uint8_t *levels);
+};
+
+template <typename K, int C>
+struct kernelSources
+{
+  static constexpr kernelText<KERNEL_SOURCE_SIZE> source = kernel_shader<K, C>();
+};
+
+template <typename K, int C>
+struct separableKernelSources
+{
+  static_assert(kernel_separable<K>(), "the kernel isn't separable");
+  static constexpr kernelText<KERNEL_SOURCE_SIZE> horizontal = kernel_horizontal_shader<K, C>();
+  static constexpr kernelText<KERNEL_SOURCE_SIZE> vertical = kernel_vertical_shader<K, C>();
+};
+
+template <typename K, int C>
+constexpr edgeKernelVariant kernel_variant(const char *name)
+{
+  return {name, kernelSources<K, C>::source.text, nullptr, nullptr, kernel_levels_cpu<K, C>};
+}
+
+template <typename K, int C>
+constexpr edgeKernelVariant separable_kernel_variant(const char *name)
+{
+  return {name, kernelSources<K, C>::source.text, separableKernelSources<K, C>::horizontal.text,
+          separableKernelSources<K, C>::vertical.text, kernel_levels_separable_cpu<K, C>};
+}
+
+// Compiled in variants, the first is the default and matches the original shader
+extern const edgeKernelVariant edgeKernelVariants[];
+extern const int edgeKernelVariantCount;
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include "EdgePyramid.h"
+#include "../../common/cpp/memory_accounting.h"
+
+//Shaders
+// One triangle covering the viewport
+static const char pyramid_vertex_source[] =
+    "#version 300 es\n"
+    "void main()\n"
+    "{\n"
+    "  gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Blurs with the [1 3 3 1] / 8 binomial kernel on both axes and halves. Each axis weighs texels
+// 2x-1..2x+2, that is two bilinear taps 0.75 texels either side of the output's center.
+static const char pyramid_downsample_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "uniform sampler2D source;\n"
+    "uniform vec2 sourceSize;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 center = gl_FragCoord.xy * 2.0;\n"
+    "  color = 0.25 * (texture(source, (center + vec2(-0.75, -0.75)) / sourceSize) +\n"
+    "                  texture(source, (center + vec2(0.75, -0.75)) / sourceSize) +\n"
+    "                  texture(source, (center + vec2(-0.75, 0.75)) / sourceSize) +\n"
+    "                  texture(source, (center + vec2(0.75, 0.75)) / sourceSize));\n"
+    "}\n";
+
+// The Sobel magnitude of the default filter, centered on the texel so every level lines
+// up with the image, and clamped at the borders
+static const char pyramid_edge_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "uniform sampler2D source;\n"
+    "out vec4 color;\n"
+    "float gray(ivec2 p)\n"
+    "{\n"
+    "  ivec2 size = textureSize(source, 0);\n"
+    "  vec3 c = texelFetch(source, clamp(p, ivec2(0), size - 1), 0).rgb;\n"
+    "  return (c.r + c.g + c.b) / 3.0;\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "  float n0 = gray(p + ivec2(-1, -1));\n"
+    "  float n1 = gray(p + ivec2(0, -1));\n"
+    "  float n2 = gray(p + ivec2(1, -1));\n"
+    "  float n3 = gray(p + ivec2(-1, 0));\n"
+    "  float n5 = gray(p + ivec2(1, 0));\n"
+    "  float n6 = gray(p + ivec2(-1, 1));\n"
+    "  float n7 = gray(p + ivec2(0, 1));\n"
+    "  float n8 = gray(p + ivec2(1, 1));\n"
+    "  float sobelX = n2 + (2.0 * n5) + n8 - (n0 + (2.0 * n3) + n6);\n"
+    "  float sobelY = n0 + (2.0 * n1) + n2 - (n6 + (2.0 * n7) + n8);\n"
+    "  color = vec4(vec3(sqrt(sobelX * sobelX + sobelY * sobelY)), 1.0);\n"
+    "}\n";
+
+// Samples one level's edges at the output pixel, flipped to the canvas' bottom-up rows
+static const char pyramid_upsample_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "uniform sampler2D edges;\n"
+    "uniform vec2 size;\n"
+    "uniform float scale;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "  vec2 pixel = vec2(gl_FragCoord.x, size.y - gl_FragCoord.y);\n"
+    "  color = texture(edges, pixel / scale / vec2(textureSize(edges, 0)));\n"
+    "}\n";
+
+//Utils
+static GLuint compile_pyramid_shader(GLenum shaderType, const char *src)
+{
+  GLuint shader = glCreateShader(shaderType);
+  glShaderSource(shader, 1, &src, NULL);
+  glCompileShader(shader);
+
+  GLint compiled;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled)
+  {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("[WASM] Pyramid shader: %s\n", log);
+  }
+  return shader;
+}
+
+static GLuint link_pyramid_program(GLuint vertexShader, GLuint fragmentShader)
+{
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+
+  GLint linked;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  return linked ? program : 0;
+}
+
+static GLuint create_pyramid_texture(int width, int height, GLuint *framebuffer)
+{
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+  memory_gpu_allocate(MEMORY_FILTER, (int64_t)width * height * 4);
+
+  glGenFramebuffers(1, framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+  return texture;
+}
+
+EdgePyramid::EdgePyramid(int w, int h)
+{
+  width = w;
+  height = h;
+
+  // Odd sizes round up, the last row and column then blur against the clamped border
+  for (int n = 0; n < PYRAMID_MAX_LEVELS; n++)
+  {
+    levelWidth[n] = n ? (levelWidth[n - 1] + 1) / 2 : width;
+    levelHeight[n] = n ? (levelHeight[n - 1] + 1) / 2 : height;
+  }
+
+  vertexShader = compile_pyramid_shader(GL_VERTEX_SHADER, pyramid_vertex_source);
+  downsampleShader = compile_pyramid_shader(GL_FRAGMENT_SHADER, pyramid_downsample_fragment_source);
+  edgeShader = compile_pyramid_shader(GL_FRAGMENT_SHADER, pyramid_edge_fragment_source);
+  upsampleShader = compile_pyramid_shader(GL_FRAGMENT_SHADER, pyramid_upsample_fragment_source);
+  downsampleProgram = link_pyramid_program(vertexShader, downsampleShader);
+  edgeProgram = link_pyramid_program(vertexShader, edgeShader);
+  upsampleProgram = link_pyramid_program(vertexShader, upsampleShader);
+  valid = downsampleProgram && edgeProgram && upsampleProgram;
+
+  glGenVertexArrays(1, &vertexArray);
+
+  glGenSamplers(1, &linearSampler);
+  glSamplerParameteri(linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+EdgePyramid::~EdgePyramid(void)
+{
+  for (int n = 0; n < PYRAMID_MAX_LEVELS; n++)
+  {
+    int64_t levelBytes = (int64_t)levelWidth[n] * levelHeight[n] * 4;
+    if (levels[n])
+      memory_gpu_free(MEMORY_FILTER, levelBytes);
+    if (edges[n])
+      memory_gpu_free(MEMORY_FILTER, levelBytes);
+    glDeleteTextures(1, &levels[n]);
+    glDeleteTextures(1, &edges[n]);
+    glDeleteFramebuffers(1, &framebuffers[n]);
+    glDeleteFramebuffers(1, &edgeFramebuffers[n]);
+  }
+  glDeleteSamplers(1, &linearSampler);
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteProgram(downsampleProgram);
+  glDeleteProgram(edgeProgram);
+  glDeleteProgram(upsampleProgram);
+  glDeleteShader(vertexShader);
+  glDeleteShader(downsampleShader);
+  glDeleteShader(edgeShader);
+  glDeleteShader(upsampleShader);
+}
+
+void EdgePyramid::invalidate(void)
+{
+  built = 0;
+}
+
+void EdgePyramid::build(GLuint source, int last)
+{
+  if (built == 0)
+    built = 1;
+  if (last < built)
+    return;
+
+  glUseProgram(downsampleProgram);
+  glUniform1i(glGetUniformLocation(downsampleProgram, "source"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindSampler(0, linearSampler);
+  for (int n = built; n <= last; n++)
+  {
+    if (!levels[n])
+      levels[n] = create_pyramid_texture(levelWidth[n], levelHeight[n], &framebuffers[n]);
+
+    glBindTexture(GL_TEXTURE_2D, n == 1 ? source : levels[n - 1]);
+    glUniform2f(glGetUniformLocation(downsampleProgram, "sourceSize"), (float)levelWidth[n - 1], (float)levelHeight[n - 1]);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[n]);
+    glViewport(0, 0, levelWidth[n], levelHeight[n]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  glBindSampler(0, 0);
+  built = last + 1;
+}
+
+void EdgePyramid::draw(GLuint source, int mask, GLuint framebuffer)
+{
+  mask &= (1 << PYRAMID_MAX_LEVELS) - 1;
+  int last = 0;
+  for (int n = 0; n < PYRAMID_MAX_LEVELS; n++)
+    last = mask & (1 << n) ? n : last;
+
+  glBindVertexArray(vertexArray);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  build(source, last);
+
+  // Edges at each selected level's own resolution
+  glUseProgram(edgeProgram);
+  glUniform1i(glGetUniformLocation(edgeProgram, "source"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  for (int n = 0; n <= last; n++)
+  {
+    if (!(mask & (1 << n)))
+      continue;
+    if (!edges[n])
+      edges[n] = create_pyramid_texture(levelWidth[n], levelHeight[n], &edgeFramebuffers[n]);
+
+    glBindTexture(GL_TEXTURE_2D, n ? levels[n] : source);
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[n]);
+    glViewport(0, 0, levelWidth[n], levelHeight[n]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  // Upsample into the target, the strongest edge of any scale wins
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, width, height);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glEnable(GL_BLEND);
+  glBlendEquation(GL_MAX);
+
+  glUseProgram(upsampleProgram);
+  glUniform1i(glGetUniformLocation(upsampleProgram, "edges"), 0);
+  glUniform2f(glGetUniformLocation(upsampleProgram, "size"), (float)width, (float)height);
+  glBindSampler(0, linearSampler);
+  for (int n = 0; n <= last; n++)
+  {
+    if (!(mask & (1 << n)))
+      continue;
+    glBindTexture(GL_TEXTURE_2D, edges[n]);
+    glUniform1f(glGetUniformLocation(upsampleProgram, "scale"), (float)(1 << n));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  glBindSampler(0, 0);
+  glBlendEquation(GL_FUNC_ADD);
+  glDisable(GL_BLEND);
+  glBindVertexArray(0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <GLES3/gl3.h>
+
+// Levels of the Gaussian pyramid, level 0 is the image and each level halves the one before
+#define PYRAMID_MAX_LEVELS 5
+
+// Multi-scale edge filter. The image is blurred and halved into a Gaussian pyramid, the edge filter
+// runs on the selected levels at their own resolution and the results are upsampled and combined
+// by taking the strongest edge of any scale. Levels above the coarsest selected one aren't built,
+// so a coarse-only result costs a quarter of the filter work per level skipped. Needs WebGL 2.
+class EdgePyramid
+{
+public:
+  // Sized for a width x height image, the context has to be current
+  EdgePyramid(int width, int height);
+
+  ~EdgePyramid(void);
+
+  // False when the shaders didn't build
+  bool valid = false;
+
+  // Drops the built levels, the image changed
+  void invalidate(void);
+
+  // Renders the edges at the levels in mask (bit n for level n) into framebuffer, laid out like the
+  // canvas. source is the image, first row at the top. Levels are built once and kept until invalidate.
+  void draw(GLuint source, int mask, GLuint framebuffer);
+
+private:
+  // Builds the levels up to last that aren't yet
+  void build(GLuint source, int last);
+
+  int width;
+  int height;
+  int levelWidth[PYRAMID_MAX_LEVELS];
+  int levelHeight[PYRAMID_MAX_LEVELS];
+  // Level 0 is the source, so only [1, PYRAMID_MAX_LEVELS) of levels are used
+  GLuint levels[PYRAMID_MAX_LEVELS] = {};
+  GLuint edges[PYRAMID_MAX_LEVELS] = {};
+  GLuint framebuffers[PYRAMID_MAX_LEVELS] = {};
+  GLuint edgeFramebuffers[PYRAMID_MAX_LEVELS] = {};
+  int built = 0;
+
+  GLuint vertexShader = 0;
+  GLuint downsampleShader = 0;
+  GLuint edgeShader = 0;
+  GLuint upsampleShader = 0;
+  GLuint downsampleProgram = 0;
+  GLuint edgeProgram = 0;
+  GLuint upsampleProgram = 0;
+  GLuint vertexArray = 0;
+  // Bilinear and clamped whatever the textures say, the source is set up for the plain filter
+  GLuint linearSampler = 0;
+};
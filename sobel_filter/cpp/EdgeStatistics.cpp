@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "EdgeStatistics.h"
+#include "EdgeKernels.h"
+#include "../../common/cpp/memory_accounting.h"
+
+// glGetBufferSubData is WebGL 2's way to read a buffer, there is no glMapBufferRange for reading
+extern "C" void glGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void *data);
+
+// Bounds value of texels without strong pixels, larger than any coordinate and exact in a float
+#define STATS_NO_BOUNDS 16777216.0f
+
+// Smallest side of the pixel block the gather pass sums per texel. Larger blocks mean fewer texels
+// for the 2x2 passes to halve, which cost more per texel than the gather does per pixel.
+#define STATS_GATHER_SIZE 8
+
+static_assert(STATS_HISTOGRAM_BINS == 8, "the shaders write the histogram to two RGBA targets");
+
+//Shaders
+// One triangle covering the viewport
+static const char stats_vertex_source[] =
+    "#version 300 es\n"
+    "void main()\n"
+    "{\n"
+    "  gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Sums the features of the source pixels that fall in each texel of the first level
+static const char stats_gather_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "uniform highp sampler2D source;\n"
+    "uniform ivec2 size;\n"
+    "uniform ivec2 cells;\n"
+    "uniform int edgeThreshold;\n"
+    "uniform int strongThreshold;\n"
+    "layout(location = 0) out vec4 counts;\n"
+    "layout(location = 1) out vec4 bounds;\n"
+    "layout(location = 2) out vec4 histogramLow;\n"
+    "layout(location = 3) out vec4 histogramHigh;\n"
+    "void main()\n"
+    "{\n"
+    "  ivec2 cell = ivec2(gl_FragCoord.xy);\n"
+    "  ivec2 first = cell * size / cells;\n"
+    "  ivec2 last = (cell + 1) * size / cells;\n"
+    "  counts = vec4(0.0);\n"
+    "  bounds = vec4(16777216.0);\n"
+    "  histogramLow = vec4(0.0);\n"
+    "  histogramHigh = vec4(0.0);\n"
+    "  for (int y = first.y; y < last.y; y++)\n"
+    "  {\n"
+    // The source has the image's first row at the bottom
+    "    int row = size.y - 1 - y;\n"
+    "    for (int x = first.x; x < last.x; x++)\n"
+    "    {\n"
+    "      int level = int(texelFetch(source, ivec2(x, row), 0).r * 255.0 + 0.5);\n"
+    "      counts.z += 1.0;\n"
+    "      if (level >= edgeThreshold)\n"
+    "        counts.x += 1.0;\n"
+    "      if (level >= strongThreshold)\n"
+    "      {\n"
+    "        counts.y += 1.0;\n"
+    "        bounds = min(bounds, vec4(float(x), float(y), float(-x - 1), float(-y - 1)));\n"
+    "      }\n"
+    "      int bin = level / 32;\n"
+    "      if (bin < 4)\n"
+    "        histogramLow[bin] += 1.0;\n"
+    "      else\n"
+    "        histogramHigh[bin - 4] += 1.0;\n"
+    "    }\n"
+    "  }\n"
+    "}\n";
+
+// Halves the previous level, sums except for the bounds which are (x1, y1, -x2, -y2) and take the min
+static const char stats_reduce_fragment_source[] =
+    "#version 300 es\n"
+    "precision highp float;\n"
+    "precision highp int;\n"
+    "uniform highp sampler2D previousCounts;\n"
+    "uniform highp sampler2D previousBounds;\n"
+    "uniform highp sampler2D previousHistogramLow;\n"
+    "uniform highp sampler2D previousHistogramHigh;\n"
+    "layout(location = 0) out vec4 counts;\n"
+    "layout(location = 1) out vec4 bounds;\n"
+    "layout(location = 2) out vec4 histogramLow;\n"
+    "layout(location = 3) out vec4 histogramHigh;\n"
+    "void main()\n"
+    "{\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy) * 2;\n"
+    "  ivec2 dx = ivec2(1, 0);\n"
+    "  ivec2 dy = ivec2(0, 1);\n"
+    "  counts = texelFetch(previousCounts, p, 0) + texelFetch(previousCounts, p + dx, 0) +\n"
+    "           texelFetch(previousCounts, p + dy, 0) + texelFetch(previousCounts, p + dx + dy, 0);\n"
+    "  bounds = min(min(texelFetch(previousBounds, p, 0), texelFetch(previousBounds, p + dx, 0)),\n"
+    "               min(texelFetch(previousBounds, p + dy, 0), texelFetch(previousBounds, p + dx + dy, 0)));\n"
+    "  histogramLow = texelFetch(previousHistogramLow, p, 0) + texelFetch(previousHistogramLow, p + dx, 0) +\n"
+    "                 texelFetch(previousHistogramLow, p + dy, 0) + texelFetch(previousHistogramLow, p + dx + dy, 0);\n"
+    "  histogramHigh = texelFetch(previousHistogramHigh, p, 0) + texelFetch(previousHistogramHigh, p + dx, 0) +\n"
+    "                  texelFetch(previousHistogramHigh, p + dy, 0) + texelFetch(previousHistogramHigh, p + dx + dy, 0);\n"
+    "}\n";
+
+//Utils
+static GLuint compile_stats_shader(GLenum shaderType, const char *src)
+{
+  GLuint shader = glCreateShader(shaderType);
+  glShaderSource(shader, 1, &src, NULL);
+  glCompileShader(shader);
+
+  GLint compiled;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (!compiled)
+  {
+    char log[512];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    printf("[WASM] Statistics shader: %s\n", log);
+  }
+  return shader;
+}
+
+static GLuint link_stats_program(GLuint vertexShader, GLuint fragmentShader)
+{
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertexShader);
+  glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+
+  GLint linked;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  return linked ? program : 0;
+}
+
+static GLuint create_stats_texture(int width, int height)
+{
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  // Float textures can't be filtered, the passes only use texelFetch
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, width, height);
+  return texture;
+}
+
+static void stats_reset(edgeStats &stats, int width, int height)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats.width = width;
+  stats.height = height;
+}
+
+// ------ CPU reference
+
+void sobel_levels_cpu(const uint8_t *rgba, int width, int height, uint8_t *levels)
+{
+  kernel_levels_cpu<sobel3Kernel, KERNEL_RGB>(rgba, width, height, levels);
+}
+
+void edge_stats_cpu(const uint8_t *levels, int width, int height, int edgeThreshold, int strongThreshold, edgeStats &stats)
+{
+  stats_reset(stats, width, height);
+  stats.strongX1 = width;
+  stats.strongY1 = height;
+
+  for (int row = 0; row < STATS_REGION_ROWS; row++)
+  {
+    for (int col = 0; col < STATS_REGION_COLS; col++)
+    {
+      int x1 = col * width / STATS_REGION_COLS, x2 = (col + 1) * width / STATS_REGION_COLS;
+      int y1 = row * height / STATS_REGION_ROWS, y2 = (row + 1) * height / STATS_REGION_ROWS;
+      uint32_t edges = 0;
+      for (int y = y1; y < y2; y++)
+      {
+        for (int x = x1; x < x2; x++)
+        {
+          int level = levels[(size_t)y * width + x];
+          stats.histogram[level * STATS_HISTOGRAM_BINS / 256]++;
+          if (level >= edgeThreshold)
+            edges++;
+          if (level >= strongThreshold)
+          {
+            stats.strongPixels++;
+            stats.strongX1 = x < stats.strongX1 ? x : stats.strongX1;
+            stats.strongY1 = y < stats.strongY1 ? y : stats.strongY1;
+            stats.strongX2 = x + 1 > stats.strongX2 ? x + 1 : stats.strongX2;
+            stats.strongY2 = y + 1 > stats.strongY2 ? y + 1 : stats.strongY2;
+          }
+        }
+      }
+      int pixels = (x2 - x1) * (y2 - y1);
+      stats.density[row * STATS_REGION_COLS + col] = pixels ? (float)edges / (float)pixels : 0.0f;
+      stats.edgePixels += edges;
+    }
+  }
+
+  if (!stats.strongPixels)
+    stats.strongX1 = stats.strongY1 = 0;
+}
+
+bool edge_stats_compare(const edgeStats &expected, const edgeStats &actual)
+{
+  bool equal = true;
+  auto check = [&](const char *field, int index, double a, double b) {
+    if (a == b)
+      return;
+    printf("[WASM] Statistics differ, %s[%d]: expected %g, got %g\n", field, index, a, b);
+    equal = false;
+  };
+
+  check("width", 0, expected.width, actual.width);
+  check("height", 0, expected.height, actual.height);
+  for (int i = 0; i < STATS_REGION_ROWS * STATS_REGION_COLS; i++)
+    check("density", i, expected.density[i], actual.density[i]);
+  for (int i = 0; i < STATS_HISTOGRAM_BINS; i++)
+    check("histogram", i, expected.histogram[i], actual.histogram[i]);
+  check("edgePixels", 0, expected.edgePixels, actual.edgePixels);
+  check("strongPixels", 0, expected.strongPixels, actual.strongPixels);
+  check("strongX1", 0, expected.strongX1, actual.strongX1);
+  check("strongY1", 0, expected.strongY1, actual.strongY1);
+  check("strongX2", 0, expected.strongX2, actual.strongX2);
+  check("strongY2", 0, expected.strongY2, actual.strongY2);
+  return equal;
+}
+
+// ------ GPU reduction
+
+EdgeReducer::EdgeReducer(int w, int h)
+{
+  width = w;
+  height = h;
+
+  // Cells per region side, the largest power of two that leaves every cell at least
+  // STATS_GATHER_SIZE pixels wide and high
+  int scale = 1;
+  while (STATS_REGION_COLS * scale * 2 * STATS_GATHER_SIZE <= width && STATS_REGION_ROWS * scale * 2 * STATS_GATHER_SIZE <= height)
+    scale *= 2;
+
+  for (; scale >= 1; scale /= 2)
+  {
+    level l;
+    l.width = STATS_REGION_COLS * scale;
+    l.height = STATS_REGION_ROWS * scale;
+    glGenFramebuffers(1, &l.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, l.framebuffer);
+    for (int i = 0; i < 4; i++)
+    {
+      l.textures[i] = create_stats_texture(l.width, l.height);
+      memory_gpu_allocate(MEMORY_FILTER, (int64_t)l.width * l.height * 16);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, l.textures[i], 0);
+    }
+    levels.push_back(l);
+  }
+
+  valid = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  vertexShader = compile_stats_shader(GL_VERTEX_SHADER, stats_vertex_source);
+  gatherShader = compile_stats_shader(GL_FRAGMENT_SHADER, stats_gather_fragment_source);
+  reduceShader = compile_stats_shader(GL_FRAGMENT_SHADER, stats_reduce_fragment_source);
+  gatherProgram = link_stats_program(vertexShader, gatherShader);
+  reduceProgram = link_stats_program(vertexShader, reduceShader);
+  valid = valid && gatherProgram && reduceProgram;
+
+  // The passes take no attributes, an empty vertex array keeps them clear of the filter's state
+  glGenVertexArrays(1, &vertexArray);
+
+  readback.resize(STATS_REGION_COLS * STATS_REGION_ROWS * 4 * 4);
+  glGenBuffers(1, &readBuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffer);
+  glBufferData(GL_PIXEL_PACK_BUFFER, readback.size() * sizeof(float), NULL, GL_STREAM_READ);
+  memory_gpu_allocate(MEMORY_FILTER, readback.size() * sizeof(float));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+EdgeReducer::~EdgeReducer(void)
+{
+  if (fence)
+    glDeleteSync(fence);
+  for (level &l : levels)
+  {
+    glDeleteFramebuffers(1, &l.framebuffer);
+    glDeleteTextures(4, l.textures);
+    memory_gpu_free(MEMORY_FILTER, (int64_t)l.width * l.height * 16 * 4);
+  }
+  glDeleteBuffers(1, &readBuffer);
+  memory_gpu_free(MEMORY_FILTER, readback.size() * sizeof(float));
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteProgram(gatherProgram);
+  glDeleteProgram(reduceProgram);
+  glDeleteShader(vertexShader);
+  glDeleteShader(gatherShader);
+  glDeleteShader(reduceShader);
+}
+
+void EdgeReducer::reduce(GLuint source, int edgeThreshold, int strongThreshold)
+{
+  static const GLenum drawBuffers[4] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+
+  glBindVertexArray(vertexArray);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+
+  // Gather into the first level
+  const level &first = levels[0];
+  glUseProgram(gatherProgram);
+  glUniform1i(glGetUniformLocation(gatherProgram, "source"), 0);
+  glUniform2i(glGetUniformLocation(gatherProgram, "size"), width, height);
+  glUniform2i(glGetUniformLocation(gatherProgram, "cells"), first.width, first.height);
+  glUniform1i(glGetUniformLocation(gatherProgram, "edgeThreshold"), edgeThreshold);
+  glUniform1i(glGetUniformLocation(gatherProgram, "strongThreshold"), strongThreshold);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, source);
+  glBindFramebuffer(GL_FRAMEBUFFER, first.framebuffer);
+  glDrawBuffers(4, drawBuffers);
+  glViewport(0, 0, first.width, first.height);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  // Halve down to one texel per region
+  glUseProgram(reduceProgram);
+  static const char *const previousNames[4] = {"previousCounts", "previousBounds", "previousHistogramLow", "previousHistogramHigh"};
+  for (int i = 0; i < 4; i++)
+    glUniform1i(glGetUniformLocation(reduceProgram, previousNames[i]), i);
+  for (size_t n = 1; n < levels.size(); n++)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(GL_TEXTURE_2D, levels[n - 1].textures[i]);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, levels[n].framebuffer);
+    glDrawBuffers(4, drawBuffers);
+    glViewport(0, 0, levels[n].width, levels[n].height);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  for (int i = 3; i >= 0; i--)
+  {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  // Read the regions into the pixel buffer, the copy finishes on the GPU's time
+  const level &last = levels.back();
+  size_t targetSize = (size_t)last.width * last.height * 4 * sizeof(float);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffer);
+  for (int i = 0; i < 4; i++)
+  {
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+    glReadPixels(0, 0, last.width, last.height, GL_RGBA, GL_FLOAT, (void *)(i * targetSize));
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+  if (fence)
+    glDeleteSync(fence);
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindVertexArray(0);
+}
+
+int EdgeReducer::poll(edgeStats &stats)
+{
+  if (!fence)
+    return STATS_ERROR;
+
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+    return STATS_PENDING;
+  glDeleteSync(fence);
+  fence = 0;
+  if (result == GL_WAIT_FAILED)
+    return STATS_ERROR;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readBuffer);
+  glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, readback.size() * sizeof(float), readback.data());
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  // One RGBA texel per region and target, rows from the top like the regions
+  const int regions = STATS_REGION_COLS * STATS_REGION_ROWS;
+  const float *counts = &readback[0];
+  const float *bounds = &readback[regions * 4];
+  const float *histogramLow = &readback[regions * 8];
+  const float *histogramHigh = &readback[regions * 12];
+
+  stats_reset(stats, width, height);
+  float x1 = STATS_NO_BOUNDS, y1 = STATS_NO_BOUNDS, x2 = STATS_NO_BOUNDS, y2 = STATS_NO_BOUNDS;
+  for (int r = 0; r < regions; r++)
+  {
+    const float *c = &counts[r * 4];
+    stats.density[r] = c[2] > 0.0f ? c[0] / c[2] : 0.0f;
+    stats.edgePixels += (uint32_t)c[0];
+    stats.strongPixels += (uint32_t)c[1];
+    for (int i = 0; i < 4; i++)
+    {
+      stats.histogram[i] += (uint32_t)histogramLow[r * 4 + i];
+      stats.histogram[i + 4] += (uint32_t)histogramHigh[r * 4 + i];
+    }
+    x1 = fminf(x1, bounds[r * 4]);
+    y1 = fminf(y1, bounds[r * 4 + 1]);
+    x2 = fminf(x2, bounds[r * 4 + 2]);
+    y2 = fminf(y2, bounds[r * 4 + 3]);
+  }
+
+  if (stats.strongPixels)
+  {
+    stats.strongX1 = (int32_t)x1;
+    stats.strongY1 = (int32_t)y1;
+    stats.strongX2 = (int32_t)-x2;
+    stats.strongY2 = (int32_t)-y2;
+  }
+  return STATS_READY;
+}
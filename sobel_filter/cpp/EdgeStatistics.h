@@ -0,0 +1,115 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <GLES3/gl3.h>
+
+// Edge density is reported for a fixed grid of regions over the image
+#define STATS_REGION_COLS 8
+#define STATS_REGION_ROWS 8
+
+// Bins of the gradient magnitude histogram, each covers 256 / STATS_HISTOGRAM_BINS output levels
+#define STATS_HISTOGRAM_BINS 8
+
+// Default thresholds, in output levels (0-255) of the filter
+#define STATS_EDGE_THRESHOLD 64
+#define STATS_STRONG_THRESHOLD 160
+
+enum statsMode
+{
+  // Reduced on the GPU, only the region totals are read back
+  STATS_GPU = 0,
+  // Full-frame glReadPixels and the CPU reference, synchronous and slow
+  STATS_FULL_READBACK = 1,
+  // STATS_GPU, checked against STATS_FULL_READBACK when the result arrives
+  STATS_VERIFY = 2,
+};
+
+enum statsStatus
+{
+  STATS_ERROR = -1,
+  STATS_PENDING = 0,
+  STATS_READY = 1,
+};
+
+// Summary of one filter output, written to a caller-provided heap buffer so it only holds ints and
+// floats. Pixel coordinates have their origin at the top left of the image.
+struct edgeStats
+{
+  int32_t width;
+  int32_t height;
+  // Share of each region's pixels at or above the edge threshold, row by row from the top left.
+  // Region (col, row) covers pixels [col * width / STATS_REGION_COLS, (col + 1) * width / STATS_REGION_COLS)
+  // and the same for rows.
+  float density[STATS_REGION_ROWS * STATS_REGION_COLS];
+  uint32_t histogram[STATS_HISTOGRAM_BINS];
+  uint32_t edgePixels;
+  uint32_t strongPixels;
+  // Bounding box of the pixels at or above the strong threshold, x2/y2 exclusive, all 0 when there are none
+  int32_t strongX1;
+  int32_t strongY1;
+  int32_t strongX2;
+  int32_t strongY2;
+};
+
+// ------ CPU reference
+
+// Output levels of the default Sobel 3x3 filter for width x height RGBA, one per pixel, first row at
+// the top. Follows the shader's sampling offsets, texture wrap and float math.
+void sobel_levels_cpu(const uint8_t *rgba, int width, int height, uint8_t *levels);
+
+// Statistics of width x height output levels, first row at the top
+void edge_stats_cpu(const uint8_t *levels, int width, int height, int edgeThreshold, int strongThreshold, edgeStats &stats);
+
+// Prints every field that differs, returns whether there were none
+bool edge_stats_compare(const edgeStats &expected, const edgeStats &actual);
+
+// ------ GPU reduction
+
+// Reduces the filter output to edgeStats on the GPU. A gather pass sums per-pixel features into a
+// grid of STATS_REGION_COLS x STATS_REGION_ROWS cells of 2^n x 2^n texels each, then 2x2 passes
+// halve it, mip style, until one texel per region is left. Those few texels are read into a pixel
+// buffer behind a fence, so the CPU never waits for the GPU. Needs WebGL 2 and EXT_color_buffer_float,
+// counts are kept in 32-bit floats and are exact up to 2^24 pixels per region.
+class EdgeReducer
+{
+public:
+  // Sized for a width x height filter output, the context has to be current
+  EdgeReducer(int width, int height);
+
+  ~EdgeReducer(void);
+
+  // False when the float render targets can't be used
+  bool valid = false;
+
+  // Runs the passes over source, the RGBA8 filter output laid out like the canvas (first row at the
+  // bottom), and starts reading back the result. Leaves framebuffer 0 bound.
+  void reduce(GLuint source, int edgeThreshold, int strongThreshold);
+
+  // STATS_PENDING until the last reduce has been read back, then fills stats and returns STATS_READY
+  int poll(edgeStats &stats);
+
+private:
+  struct level
+  {
+    int width;
+    int height;
+    GLuint framebuffer;
+    // Sums of (edge, strong, all) pixels, min of the strong bounds, histogram bins 0-3 and 4-7
+    GLuint textures[4];
+  };
+
+  int width;
+  int height;
+  std::vector<level> levels;
+
+  GLuint vertexShader = 0;
+  GLuint gatherShader = 0;
+  GLuint reduceShader = 0;
+  GLuint gatherProgram = 0;
+  GLuint reduceProgram = 0;
+  GLuint vertexArray = 0;
+
+  GLuint readBuffer = 0;
+  GLsync fence = 0;
+  std::vector<float> readback;
+};
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <string.h>
+#include "ImageDecoder.h"
+
+// ------ libpng progressive reader callbacks
+
+static void png_error_callback(png_structp png, png_const_charp message)
+{
+  ImageDecoder *decoder = (ImageDecoder *)png_get_error_ptr(png);
+  printf("[WASM] PNG error: %s\n", message);
+  longjmp(decoder->errorJump, 1);
+}
+
+static void png_warning_callback(png_structp png, png_const_charp message)
+{
+}
+
+static void png_info_callback(png_structp png, png_infop info)
+{
+  ImageDecoder *decoder = (ImageDecoder *)png_get_progressive_ptr(png);
+
+  // Every format comes out as 8-bit RGBA
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  png_set_filler(png, 0xff, PNG_FILLER_AFTER);
+  decoder->interlaced = png_set_interlace_handling(png) > 1;
+  png_read_update_info(png, info);
+
+  decoder->start(png_get_image_width(png, info), png_get_image_height(png, info));
+}
+
+static void png_row_callback(png_structp png, png_bytep row, png_uint_32 y, int pass)
+{
+  ImageDecoder *decoder = (ImageDecoder *)png_get_progressive_ptr(png);
+  if (!row)
+    return;
+  if (decoder->interlaced)
+    png_progressive_combine_row(png, &decoder->image[(size_t)y * decoder->width * 4], row);
+  else
+    decoder->addRow(y, row, 4);
+}
+
+static void png_end_callback(png_structp png, png_infop info)
+{
+  ImageDecoder *decoder = (ImageDecoder *)png_get_progressive_ptr(png);
+  if (decoder->interlaced)
+    for (int y = 0; y < decoder->height; y++)
+      decoder->addRow(y, &decoder->image[(size_t)y * decoder->width * 4], 4);
+  decoder->finish();
+}
+
+// ------ libjpeg suspending source: it returns to push when it runs out of bytes and picks up
+// where it stopped once the next ones arrive
+
+static void jpeg_init_source(j_decompress_ptr jpeg)
+{
+}
+
+static boolean jpeg_fill_input_buffer(j_decompress_ptr jpeg)
+{
+  return FALSE;
+}
+
+static void jpeg_skip_input_data(j_decompress_ptr jpeg, long count)
+{
+  ImageDecoder *decoder = (ImageDecoder *)jpeg->client_data;
+  jpeg_source_mgr *source = jpeg->src;
+  if (count <= 0)
+    return;
+  if ((size_t)count > source->bytes_in_buffer)
+  {
+    decoder->jpegSkip += count - source->bytes_in_buffer;
+    source->next_input_byte += source->bytes_in_buffer;
+    source->bytes_in_buffer = 0;
+  }
+  else
+  {
+    source->next_input_byte += count;
+    source->bytes_in_buffer -= count;
+  }
+}
+
+static void jpeg_term_source(j_decompress_ptr jpeg)
+{
+}
+
+static void jpeg_error_exit(j_common_ptr jpeg)
+{
+  char message[JMSG_LENGTH_MAX];
+  (*jpeg->err->format_message)(jpeg, message);
+  printf("[WASM] JPEG error: %s\n", message);
+  longjmp(((ImageDecoder *)jpeg->client_data)->errorJump, 1);
+}
+
+static void jpeg_output_message(j_common_ptr jpeg)
+{
+}
+
+// ------ ImageDecoder
+
+ImageDecoder::ImageDecoder(std::function<void(int width, int height)> header, std::function<void(int y, int count, const uint8_t *rgba)> rows)
+    : header(header), rows(rows)
+{
+}
+
+ImageDecoder::~ImageDecoder(void)
+{
+  if (png)
+    png_destroy_read_struct(&png, &pngInfo, NULL);
+  if (jpegCreated)
+    jpeg_destroy_decompress(&jpeg);
+}
+
+int ImageDecoder::push(const uint8_t *data, int size)
+{
+  if (status != IMAGE_NEED_DATA || size <= 0)
+    return status;
+
+  if (format == IMAGE_UNKNOWN)
+  {
+    // A PNG signature is 8 bytes, JPEG starts with an SOI marker
+    int take = 8 - (int)signature.size() < size ? 8 - (int)signature.size() : size;
+    signature.insert(signature.end(), data, data + take);
+    data += take;
+    size -= take;
+    if (signature.size() >= 3 && signature[0] == 0xff && signature[1] == 0xd8 && signature[2] == 0xff)
+      format = IMAGE_JPEG;
+    else if (signature.size() == 8 && png_sig_cmp(signature.data(), 0, 8) == 0)
+      format = IMAGE_PNG;
+    else if (signature.size() == 8)
+    {
+      printf("[WASM] Unknown image format\n");
+      status = IMAGE_ERROR;
+    }
+    if (format == IMAGE_UNKNOWN)
+      return status;
+
+    int result = format == IMAGE_PNG ? pushPng(signature.data(), signature.size()) : pushJpeg(signature.data(), signature.size());
+    signature.clear();
+    if (result != IMAGE_NEED_DATA || size == 0)
+      return result;
+  }
+
+  return format == IMAGE_PNG ? pushPng(data, size) : pushJpeg(data, size);
+}
+
+int ImageDecoder::pushPng(const uint8_t *data, int size)
+{
+  if (!png)
+  {
+    png = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, png_error_callback, png_warning_callback);
+    pngInfo = png ? png_create_info_struct(png) : nullptr;
+    if (!pngInfo)
+    {
+      status = IMAGE_ERROR;
+      return status;
+    }
+    png_set_progressive_read_fn(png, this, png_info_callback, png_row_callback, png_end_callback);
+  }
+
+  if (setjmp(errorJump))
+  {
+    status = IMAGE_ERROR;
+    return status;
+  }
+  png_process_data(png, pngInfo, (png_bytep)data, size);
+  return status;
+}
+
+int ImageDecoder::pushJpeg(const uint8_t *data, int size)
+{
+  if (setjmp(errorJump))
+  {
+    status = IMAGE_ERROR;
+    return status;
+  }
+
+  if (!jpegCreated)
+  {
+    jpeg.err = jpeg_std_error(&jpegError);
+    jpegError.error_exit = jpeg_error_exit;
+    jpegError.output_message = jpeg_output_message;
+    jpeg.client_data = this;
+    jpeg_create_decompress(&jpeg);
+    jpegCreated = true;
+
+    jpegSource.init_source = jpeg_init_source;
+    jpegSource.fill_input_buffer = jpeg_fill_input_buffer;
+    jpegSource.skip_input_data = jpeg_skip_input_data;
+    jpegSource.resync_to_restart = jpeg_resync_to_restart;
+    jpegSource.term_source = jpeg_term_source;
+    jpegSource.next_input_byte = nullptr;
+    jpegSource.bytes_in_buffer = 0;
+    jpeg.src = &jpegSource;
+  }
+
+  // Bytes a marker skip wanted beyond what had arrived
+  size_t skip = jpegSkip < (size_t)size ? jpegSkip : size;
+  data += skip;
+  size -= skip;
+  jpegSkip -= skip;
+
+  // Only the bytes libjpeg has not consumed are kept, usually a fraction of a chunk
+  size_t kept = jpegSource.bytes_in_buffer;
+  if (kept > 0)
+    memmove(jpegInput.data(), jpegSource.next_input_byte, kept);
+  jpegInput.resize(kept);
+  jpegInput.insert(jpegInput.end(), data, data + size);
+  jpegSource.next_input_byte = jpegInput.data();
+  jpegSource.bytes_in_buffer = jpegInput.size();
+
+  if (jpegStage == 0)
+  {
+    if (jpeg_read_header(&jpeg, TRUE) == JPEG_SUSPENDED)
+      return status;
+    jpeg.out_color_space = JCS_RGB;
+    jpegStage = 1;
+  }
+  if (jpegStage == 1)
+  {
+    if (!jpeg_start_decompress(&jpeg))
+      return status;
+    start(jpeg.output_width, jpeg.output_height);
+    jpegRow.resize((size_t)jpeg.output_width * jpeg.output_components);
+    jpegStage = 2;
+  }
+  if (jpegStage == 2)
+  {
+    while (jpeg.output_scanline < jpeg.output_height)
+    {
+      int y = jpeg.output_scanline;
+      JSAMPROW row = jpegRow.data();
+      if (jpeg_read_scanlines(&jpeg, &row, 1) != 1)
+        return status;
+      addRow(y, jpegRow.data(), jpeg.output_components);
+    }
+    jpegStage = 3;
+  }
+  if (jpegStage == 3)
+  {
+    if (!jpeg_finish_decompress(&jpeg))
+      return status;
+    finish();
+    jpegStage = 4;
+  }
+  return status;
+}
+
+void ImageDecoder::start(int imageWidth, int imageHeight)
+{
+  width = imageWidth;
+  height = imageHeight;
+  strip.resize((size_t)width * 4 * IMAGE_STRIP_ROWS);
+  if (interlaced)
+    image.assign((size_t)width * height * 4, 0);
+  header(width, height);
+}
+
+void ImageDecoder::addRow(int y, const uint8_t *pixels, int channels)
+{
+  if (stripCount == 0)
+    stripFirst = y;
+  uint8_t *out = &strip[(size_t)stripCount * width * 4];
+  if (channels == 4)
+    memcpy(out, pixels, (size_t)width * 4);
+  else
+    for (int x = 0; x < width; x++)
+    {
+      out[x * 4] = pixels[x * channels];
+      out[x * 4 + 1] = pixels[x * channels + 1];
+      out[x * 4 + 2] = pixels[x * channels + 2];
+      out[x * 4 + 3] = 0xff;
+    }
+  if (++stripCount == IMAGE_STRIP_ROWS)
+    flushStrip();
+}
+
+void ImageDecoder::flushStrip(void)
+{
+  if (stripCount > 0)
+    rows(stripFirst, stripCount, strip.data());
+  stripCount = 0;
+}
+
+void ImageDecoder::finish(void)
+{
+  flushStrip();
+  status = IMAGE_DONE;
+}
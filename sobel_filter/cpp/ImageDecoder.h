@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include <functional>
+#include <vector>
+#include <png.h>
+// The IJG jpeglib.h has no C++ guards of its own
+extern "C"
+{
+#include <jpeglib.h>
+}
+
+// Rows handed out per strip, the only full-width pixel storage the decoder keeps
+#define IMAGE_STRIP_ROWS 32
+
+enum imageStatus
+{
+  IMAGE_ERROR = -1,
+  IMAGE_NEED_DATA = 0,
+  IMAGE_DONE = 1,
+};
+
+enum imageFormat
+{
+  IMAGE_UNKNOWN,
+  IMAGE_PNG,
+  IMAGE_JPEG,
+};
+
+// Incremental PNG/JPEG decoder. Compressed bytes are pushed as they arrive and decoded RGBA rows come
+// out a strip at a time, top row first, so the whole image never sits in memory. Interlaced PNGs
+// are the exception, their passes have to be combined in a full image before rows can go out.
+class ImageDecoder
+{
+public:
+  // header runs once the size is known, rows with every strip
+  ImageDecoder(std::function<void(int width, int height)> header, std::function<void(int y, int count, const uint8_t *rgba)> rows);
+
+  ~ImageDecoder(void);
+
+  // Decodes what it can of the next size bytes. Returns IMAGE_NEED_DATA until every row went out,
+  // then IMAGE_DONE. After IMAGE_ERROR the decoder ignores further data.
+  int push(const uint8_t *data, int size);
+
+  int format = IMAGE_UNKNOWN;
+  int width = 0;
+  int height = 0;
+
+  // Used by the libpng and libjpeg callbacks
+  void start(int imageWidth, int imageHeight);
+  void addRow(int y, const uint8_t *pixels, int channels);
+  void finish(void);
+  jmp_buf errorJump;
+  bool interlaced = false;
+  std::vector<uint8_t> image;
+  size_t jpegSkip = 0;
+
+private:
+  int pushPng(const uint8_t *data, int size);
+  int pushJpeg(const uint8_t *data, int size);
+  void flushStrip(void);
+
+  std::function<void(int, int)> header;
+  std::function<void(int, int, const uint8_t *)> rows;
+  int status = IMAGE_NEED_DATA;
+
+  // First bytes, kept until the format is known
+  std::vector<uint8_t> signature;
+
+  png_structp png = nullptr;
+  png_infop pngInfo = nullptr;
+
+  jpeg_decompress_struct jpeg;
+  jpeg_error_mgr jpegError;
+  jpeg_source_mgr jpegSource;
+  bool jpegCreated = false;
+  int jpegStage = 0;
+  // Compressed bytes libjpeg has not consumed yet
+  std::vector<uint8_t> jpegInput;
+  std::vector<uint8_t> jpegRow;
+
+  std::vector<uint8_t> strip;
+  int stripFirst = 0;
+  int stripCount = 0;
+};
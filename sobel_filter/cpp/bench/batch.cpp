@@ -0,0 +1,148 @@
+// Native benchmark of the batch API against a context per image, on surfaceless EGL (Mesa's
+// llvmpipe does without a GPU). Every batch output has to be within a level of float rounding of
+// sobel_levels_cpu and of the per-image output.
+//
+//   g++ -O2 -std=c++1z -Icpp/bench cpp/bench/batch.cpp -lEGL -lGLESv2 -lpng -ljpeg -lz -o batch_bench
+//   ./batch_bench
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <GLES3/gl3.h>
+#include <emscripten.h>
+#include "platform.cpp"
+#include "../Context.cpp"
+#include "../EdgeStatistics.cpp"
+#include "../EdgePyramid.cpp"
+#include "../EdgeBatch.cpp"
+#include "../EdgeKernels.cpp"
+#include "../../../common/cpp/memory_accounting.cpp"
+
+// Throughput gain the batch API is meant to reach over a context per image. llvmpipe misses it from
+// 256x256 up, where shading the pixels on the CPU costs more than the per-image setup the batch saves.
+#define BATCH_TARGET_SPEEDUP 10
+
+static double now()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// count images with sides in [minSide, maxSide], back to back
+static void make_images(int count, int minSide, int maxSide, std::vector<int32_t> &sizes, std::vector<uint8_t> &pixels)
+{
+  sizes.clear();
+  pixels.clear();
+  for (int i = 0; i < count; i++)
+  {
+    int width = minSide + rand() % (maxSide - minSide + 1);
+    int height = minSide + rand() % (maxSide - minSide + 1);
+    sizes.push_back(width);
+    sizes.push_back(height);
+    for (int y = 0; y < height; y++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        bool inside = (x - width / 2) * (x - width / 2) + (y - height / 2) * (y - height / 2) < width * height / 8;
+        uint8_t shade = (inside ? 180 : 40) + rand() % 20;
+        pixels.insert(pixels.end(), {shade, (uint8_t)(shade / 2), (uint8_t)(x * 255 / width), 255});
+      }
+    }
+  }
+}
+
+// What ingestion does today: a context per image, upload, draw and read the canvas back
+static void process_single(const uint8_t *pixels, int width, int height, uint8_t *output)
+{
+  Context context(width, height, (char *)"#canvas");
+  context.run((uint8_t *)pixels);
+  std::vector<uint8_t> canvas((size_t)width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, canvas.data());
+  // The canvas has the first row at the bottom
+  for (int y = 0; y < height; y++)
+    memcpy(output + (size_t)y * width * 4, &canvas[(size_t)(height - 1 - y) * width * 4], width * 4);
+}
+
+int main(int argc, char **argv)
+{
+  const struct
+  {
+    int count;
+    int minSide;
+    int maxSide;
+  } sets[] = {{1000, 64, 64}, {500, 128, 128}, {100, 256, 256}, {40, 512, 512}, {500, 64, 512}};
+
+  // The batch runs on any context
+  Context host(1, 1, (char *)"#canvas");
+
+  int failed = 0;
+  for (auto &set : sets)
+  {
+    std::vector<int32_t> sizes;
+    std::vector<uint8_t> pixels;
+    make_images(set.count, set.minSide, set.maxSide, sizes, pixels);
+    std::vector<uint8_t> single(pixels.size()), batched(pixels.size());
+    std::vector<atlasRegion> regions(set.count);
+
+    double start = now();
+    size_t offset = 0;
+    for (int i = 0; i < set.count; i++)
+    {
+      process_single(&pixels[offset], sizes[i * 2], sizes[i * 2 + 1], &single[offset]);
+      offset += (size_t)sizes[i * 2] * sizes[i * 2 + 1] * 4;
+    }
+    double singleTime = now() - start;
+
+    // The first batch also builds the shaders and atlas
+    host.processBatch(pixels.data(), sizes.data(), set.count, batched.data(), regions.data());
+    const int runs = 3;
+    int layers = 0;
+    start = now();
+    for (int run = 0; run < runs; run++)
+      layers = host.processBatch(pixels.data(), sizes.data(), set.count, batched.data(), regions.data());
+    double batchTime = (now() - start) / runs;
+
+    int maxDifference = 0, maxReferenceDifference = 0;
+    offset = 0;
+    for (int i = 0; i < set.count; i++)
+    {
+      int pixelCount = sizes[i * 2] * sizes[i * 2 + 1];
+      std::vector<uint8_t> levels(pixelCount);
+      sobel_levels_cpu(&pixels[offset], sizes[i * 2], sizes[i * 2 + 1], levels.data());
+      for (int p = 0; p < pixelCount; p++)
+      {
+        const uint8_t *out = &batched[offset + p * 4];
+        for (int c = 0; c < 4; c++)
+        {
+          maxReferenceDifference = std::max(maxReferenceDifference, abs(out[c] - (c < 3 ? levels[p] : 255)));
+          maxDifference = std::max(maxDifference, abs(out[c] - single[offset + p * 4 + c]));
+        }
+      }
+      offset += (size_t)pixelCount * 4;
+    }
+    bool passed = maxReferenceDifference <= 1 && maxDifference <= 1;
+    failed += !passed;
+    printf("[BENCH] %d images of %d-%d px: %s, %d layers, at most %d off the CPU reference and %d off the per-image output\n", set.count,
+           set.minSide, set.maxSide, passed ? "ok" : "FAILED", layers, maxReferenceDifference, maxDifference);
+    printf("[BENCH]   context per image %8.0f images/s, batch %8.0f images/s, %.1fx%s\n", set.count / singleTime * 1000.0,
+           set.count / batchTime * 1000.0, singleTime / batchTime, singleTime / batchTime < BATCH_TARGET_SPEEDUP ? ", below the target" : "");
+  }
+
+  // Every per-image context is gone, only the host's quad and batch atlas should be left. Over a
+  // budget the host then frees its atlas.
+  memoryStats before, after;
+  memory_stats(before);
+  memory_set_budget(MEMORY_FILTER, 1);
+  int evictors = memory_enforce_budgets();
+  memory_stats(after);
+  const memoryCounters &textures = before.subsystems[MEMORY_TEXTURES].gpu;
+  const memoryCounters &filter = before.subsystems[MEMORY_FILTER].gpu;
+  bool released = textures.current == 0 && evictors == 1 && after.subsystems[MEMORY_FILTER].gpu.current == sizeof(quad_vertices) + sizeof(quad_indices);
+  failed += !released;
+  printf("[BENCH] GPU memory: textures %.0f bytes of %.1f MB churned, filter %.1f MB (peak %.1f MB, %.1f MB churned), %.0f bytes after eviction: %s\n",
+         textures.current, textures.churn / 1048576, filter.current / 1048576, filter.peak / 1048576, filter.churn / 1048576,
+         after.subsystems[MEMORY_FILTER].gpu.current, released ? "ok" : "FAILED");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+// Native benchmark of getting a compressed image into the filter's texture, the current way and
+// streamed through ImageDecoder. Reports end-to-end CPU time and peak heap of both.
+//
+//   g++ -O2 -std=c++1z cpp/bench/decode.cpp -lpng -ljpeg -lz -o decode_bench
+//   ./decode_bench image.png photo.jpg
+//
+// The current path is modelled on what the page does: the browser decodes the whole image,
+// getImageData copies it, ccallArrays copies that into the heap and glTexImage2D uploads it.
+// GL uploads are memcpys into a texture allocated up front and not counted as heap.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <chrono>
+#include <vector>
+#include "../ImageDecoder.cpp"
+
+// Bytes handed to pushImage per call, about what a fetch stream delivers
+#define BENCH_CHUNK_SIZE (64 * 1024)
+
+// ------ Heap accounting on top of glibc's allocator
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+static size_t heapCurrent = 0;
+static size_t heapPeak = 0;
+
+static void heap_add(void *pointer)
+{
+  if (!pointer)
+    return;
+  heapCurrent += malloc_usable_size(pointer);
+  heapPeak = heapCurrent > heapPeak ? heapCurrent : heapPeak;
+}
+
+extern "C" void *malloc(size_t size)
+{
+  void *pointer = __libc_malloc(size);
+  heap_add(pointer);
+  return pointer;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  void *pointer = __libc_calloc(count, size);
+  heap_add(pointer);
+  return pointer;
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+  if (pointer)
+    heapCurrent -= malloc_usable_size(pointer);
+  void *result = __libc_realloc(pointer, size);
+  heap_add(result);
+  return result;
+}
+
+extern "C" void free(void *pointer)
+{
+  if (pointer)
+    heapCurrent -= malloc_usable_size(pointer);
+  __libc_free(pointer);
+}
+
+static double now()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------ Current path
+
+// Whole image to RGBA, like the browser's decode into an <img> bitmap
+static uint8_t *decode_whole(const std::vector<uint8_t> &file, int &width, int &height)
+{
+  if (file.size() >= 8 && png_sig_cmp(file.data(), 0, 8) == 0)
+  {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&image, file.data(), file.size()))
+      return nullptr;
+    image.format = PNG_FORMAT_RGBA;
+    width = image.width;
+    height = image.height;
+    uint8_t *pixels = (uint8_t *)malloc(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, NULL, pixels, 0, NULL))
+    {
+      free(pixels);
+      return nullptr;
+    }
+    return pixels;
+  }
+
+  jpeg_decompress_struct jpeg;
+  jpeg_error_mgr error;
+  jpeg.err = jpeg_std_error(&error);
+  jpeg_create_decompress(&jpeg);
+  jpeg_mem_src(&jpeg, (unsigned char *)file.data(), file.size());
+  jpeg_read_header(&jpeg, TRUE);
+  jpeg.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&jpeg);
+  width = jpeg.output_width;
+  height = jpeg.output_height;
+  uint8_t *pixels = (uint8_t *)malloc((size_t)width * height * 4);
+  std::vector<uint8_t> row((size_t)width * 3);
+  while (jpeg.output_scanline < jpeg.output_height)
+  {
+    uint8_t *out = pixels + (size_t)jpeg.output_scanline * width * 4;
+    JSAMPROW rowPointer = row.data();
+    jpeg_read_scanlines(&jpeg, &rowPointer, 1);
+    for (int x = 0; x < width; x++)
+    {
+      out[x * 4] = row[x * 3];
+      out[x * 4 + 1] = row[x * 3 + 1];
+      out[x * 4 + 2] = row[x * 3 + 2];
+      out[x * 4 + 3] = 0xff;
+    }
+  }
+  jpeg_finish_decompress(&jpeg);
+  jpeg_destroy_decompress(&jpeg);
+  return pixels;
+}
+
+static bool current_path(const std::vector<uint8_t> &file, std::vector<uint8_t> &texture)
+{
+  int width, height;
+  uint8_t *bitmap = decode_whole(file, width, height);
+  if (!bitmap)
+    return false;
+  size_t size = (size_t)width * height * 4;
+  // getImageData
+  uint8_t *imageData = (uint8_t *)malloc(size);
+  memcpy(imageData, bitmap, size);
+  // ccallArrays into the heap
+  uint8_t *heap = (uint8_t *)malloc(size);
+  memcpy(heap, imageData, size);
+  // glTexImage2D
+  texture.resize(size);
+  memcpy(texture.data(), heap, size);
+  free(heap);
+  free(imageData);
+  free(bitmap);
+  return true;
+}
+
+// ------ Streamed path
+
+static bool streamed_path(const std::vector<uint8_t> &file, std::vector<uint8_t> &texture)
+{
+  int textureWidth = 0;
+  ImageDecoder *decoder = new ImageDecoder(
+      [&](int width, int height) {
+        textureWidth = width;
+        texture.resize((size_t)width * height * 4);
+      },
+      [&](int y, int count, const uint8_t *rgba) {
+        memcpy(&texture[(size_t)y * textureWidth * 4], rgba, (size_t)count * textureWidth * 4);
+      });
+
+  int status = IMAGE_NEED_DATA;
+  for (size_t offset = 0; offset < file.size() && status == IMAGE_NEED_DATA; offset += BENCH_CHUNK_SIZE)
+  {
+    // pushImage gets each chunk in its own heap buffer
+    size_t size = file.size() - offset < BENCH_CHUNK_SIZE ? file.size() - offset : BENCH_CHUNK_SIZE;
+    uint8_t *chunk = (uint8_t *)malloc(size);
+    memcpy(chunk, file.data() + offset, size);
+    status = decoder->push(chunk, size);
+    free(chunk);
+  }
+  delete decoder;
+  return status == IMAGE_DONE;
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> &file)
+{
+  FILE *handle = fopen(path, "rb");
+  if (!handle)
+    return false;
+  fseek(handle, 0, SEEK_END);
+  file.resize(ftell(handle));
+  fseek(handle, 0, SEEK_SET);
+  bool read = fread(file.data(), 1, file.size(), handle) == file.size();
+  fclose(handle);
+  return read;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <image.png|image.jpg>...\n", argv[0]);
+    return 1;
+  }
+
+  const int runs = 5;
+  for (int i = 1; i < argc; i++)
+  {
+    std::vector<uint8_t> file;
+    if (!read_file(argv[i], file))
+    {
+      fprintf(stderr, "can't read %s\n", argv[i]);
+      continue;
+    }
+
+    // The texture lives on the GPU, allocate it before measuring
+    std::vector<uint8_t> currentTexture, streamedTexture;
+    if (!current_path(file, currentTexture) || !streamed_path(file, streamedTexture))
+    {
+      printf("[BENCH] %s: decode failed\n", argv[i]);
+      continue;
+    }
+
+    double currentTime = 0, streamedTime = 0;
+    size_t currentPeak = 0, streamedPeak = 0;
+    for (int run = 0; run < runs; run++)
+    {
+      size_t base = heapCurrent;
+      heapPeak = base;
+      double start = now();
+      current_path(file, currentTexture);
+      currentTime += now() - start;
+      currentPeak = heapPeak - base;
+
+      base = heapCurrent;
+      heapPeak = base;
+      start = now();
+      streamed_path(file, streamedTexture);
+      streamedTime += now() - start;
+      streamedPeak = heapPeak - base;
+    }
+
+    printf("[BENCH] %s, %zu bytes compressed, %zu bytes RGBA\n", argv[i], file.size(), currentTexture.size());
+    printf("[BENCH]   current   %8.3f ms  peak heap %10zu bytes\n", currentTime / runs, currentPeak);
+    printf("[BENCH]   streamed  %8.3f ms  peak heap %10zu bytes  (%s)\n", streamedTime / runs, streamedPeak,
+           currentTexture == streamedTexture ? "identical" : "DIFFERENT");
+  }
+  return 0;
+}
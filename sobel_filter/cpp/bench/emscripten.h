@@ -0,0 +1,4 @@
+#pragma once
+// Native stand-in for emscripten.h, the contexts in emscripten/html5.h are EGL ones
+#define EMSCRIPTEN_KEEPALIVE __attribute__((used))
+#include <emscripten/html5.h>
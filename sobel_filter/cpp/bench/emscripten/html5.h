@@ -0,0 +1,42 @@
+#pragma once
+// Native stand-in for emscripten/html5.h, implemented on surfaceless EGL in platform.cpp
+
+typedef int EMSCRIPTEN_WEBGL_CONTEXT_HANDLE;
+typedef int EM_BOOL;
+typedef int EMSCRIPTEN_RESULT;
+
+typedef struct EmscriptenWebGLContextAttributes
+{
+  EM_BOOL alpha;
+  EM_BOOL depth;
+  EM_BOOL stencil;
+  EM_BOOL antialias;
+  EM_BOOL premultipliedAlpha;
+  EM_BOOL preserveDrawingBuffer;
+  int powerPreference;
+  EM_BOOL failIfMajorPerformanceCaveat;
+  int majorVersion;
+  int minorVersion;
+  EM_BOOL enableExtensionsByDefault;
+  EM_BOOL explicitSwapControl;
+  int proxyContextToMainThread;
+  EM_BOOL renderViaOffscreenBackBuffer;
+} EmscriptenWebGLContextAttributes;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  void emscripten_webgl_init_context_attributes(EmscriptenWebGLContextAttributes *attributes);
+  EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_create_context(const char *target, const EmscriptenWebGLContextAttributes *attributes);
+  EMSCRIPTEN_RESULT emscripten_webgl_make_context_current(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context);
+  EMSCRIPTEN_RESULT emscripten_webgl_destroy_context(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context);
+  EM_BOOL emscripten_webgl_enable_extension(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char *extension);
+  EMSCRIPTEN_RESULT emscripten_set_element_css_size(const char *target, double width, double height);
+  EMSCRIPTEN_RESULT emscripten_set_canvas_element_size(const char *target, int width, int height);
+  double emscripten_get_device_pixel_ratio(void);
+
+#ifdef __cplusplus
+}
+#endif
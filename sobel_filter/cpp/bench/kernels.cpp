@@ -0,0 +1,102 @@
+// Native benchmark and parity check of the generated edge kernels, on surfaceless EGL (Mesa's
+// llvmpipe does without a GPU). Every variant renders through Context and has to stay within a
+// level of float rounding of its generated CPU kernel.
+//
+//   g++ -O2 -std=c++1z -Icpp/bench cpp/bench/kernels.cpp -lEGL -lGLESv2 -lpng -ljpeg -lz -o kernels_bench
+//   ./kernels_bench [width height]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <GLES3/gl3.h>
+#include <emscripten.h>
+#include "platform.cpp"
+#include "../Context.cpp"
+#include "../EdgeStatistics.cpp"
+#include "../EdgePyramid.cpp"
+#include "../EdgeBatch.cpp"
+#include "../EdgeKernels.cpp"
+#include "../../../common/cpp/memory_accounting.cpp"
+
+static double now()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Soft shapes over noise, so every kernel has gradients of all strengths to round
+static void make_image(int width, int height, std::vector<uint8_t> &rgba)
+{
+  rgba.resize((size_t)width * height * 4);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      uint8_t *pixel = &rgba[((size_t)y * width + x) * 4];
+      int ring = ((x - width / 2) * (x - width / 2) + (y - height / 3) * (y - height / 3)) / 64;
+      pixel[0] = (uint8_t)(ring * 7 + rand() % 24);
+      pixel[1] = (uint8_t)(x * 255 / width);
+      pixel[2] = (uint8_t)((x / 16 + y / 16) % 2 ? 200 : 30 + rand() % 8);
+      pixel[3] = 255;
+    }
+  }
+}
+
+// The canvas as output levels, first row at the top
+static void read_canvas(int width, int height, std::vector<uint8_t> &levels)
+{
+  std::vector<uint8_t> canvas((size_t)width * height * 4);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, canvas.data());
+  levels.resize((size_t)width * height);
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      levels[(size_t)y * width + x] = canvas[((size_t)(height - 1 - y) * width + x) * 4];
+}
+
+int main(int argc, char **argv)
+{
+  int width = argc > 2 ? atoi(argv[1]) : 1920;
+  int height = argc > 2 ? atoi(argv[2]) : 1080;
+
+  std::vector<uint8_t> rgba, gpuLevels, cpuLevels((size_t)width * height);
+  make_image(width, height, rgba);
+  Context context(width, height, (char *)"#canvas");
+  context.run(rgba.data());
+
+  printf("[BENCH] %dx%d, %s float targets\n", width, height, emscripten_webgl_enable_extension(0, "EXT_color_buffer_float") ? "with" : "without");
+  int failed = 0;
+  for (int v = 0; v < edgeKernelVariantCount; v++)
+  {
+    const edgeKernelVariant &variant = edgeKernelVariants[v];
+    context.setEdgeKernel(v);
+    context.draw();
+    read_canvas(width, height, gpuLevels);
+
+    const int runs = 5;
+    double start = now();
+    for (int run = 0; run < runs; run++)
+    {
+      context.draw();
+      glFinish();
+    }
+    double gpuTime = (now() - start) / runs;
+
+    start = now();
+    variant.cpu(rgba.data(), width, height, cpuLevels.data());
+    double cpuTime = now() - start;
+
+    int off = 0, maxDifference = 0;
+    for (size_t i = 0; i < cpuLevels.size(); i++)
+    {
+      int difference = abs(gpuLevels[i] - cpuLevels[i]);
+      off += difference > 0;
+      maxDifference = difference > maxDifference ? difference : maxDifference;
+    }
+    bool passed = maxDifference <= 1;
+    failed += !passed;
+    printf("[BENCH] %-28s GPU %7.2f ms  CPU %8.2f ms  %6.3f%% off by %d  %s\n", variant.name, gpuTime, cpuTime,
+           100.0 * off / cpuLevels.size(), maxDifference, passed ? "ok" : "FAILED");
+  }
+  return failed ? 1 : 0;
+}
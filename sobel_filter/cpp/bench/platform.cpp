@@ -0,0 +1,103 @@
+// emscripten/html5.h on surfaceless EGL for the native checks. Each context gets a pbuffer the size
+// the canvas was last set to, standing in for the canvas' default framebuffer.
+#include <string.h>
+#include <vector>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <emscripten/html5.h>
+
+struct platformContext
+{
+  EGLContext context;
+  EGLSurface surface;
+};
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLConfig config;
+static std::vector<platformContext> contexts(1, {EGL_NO_CONTEXT, EGL_NO_SURFACE});
+static int canvasWidth = 1;
+static int canvasHeight = 1;
+
+extern "C"
+{
+  void emscripten_webgl_init_context_attributes(EmscriptenWebGLContextAttributes *attributes)
+  {
+    memset(attributes, 0, sizeof(*attributes));
+    attributes->majorVersion = 1;
+  }
+
+  EMSCRIPTEN_WEBGL_CONTEXT_HANDLE emscripten_webgl_create_context(const char *target, const EmscriptenWebGLContextAttributes *attributes)
+  {
+    if (display == EGL_NO_DISPLAY)
+    {
+      auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+      if (!eglInitialize(display, NULL, NULL))
+        return 0;
+      eglBindAPI(EGL_OPENGL_ES_API);
+
+      const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+                                         EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_NONE};
+      EGLint configCount;
+      if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || !configCount)
+        return 0;
+    }
+
+    // WebGL 2 is GLES 3.0
+    const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, canvasWidth, EGL_HEIGHT, canvasHeight, EGL_NONE};
+    platformContext context;
+    context.context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    context.surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (context.context == EGL_NO_CONTEXT || context.surface == EGL_NO_SURFACE)
+      return 0;
+    contexts.push_back(context);
+    return (EMSCRIPTEN_WEBGL_CONTEXT_HANDLE)contexts.size() - 1;
+  }
+
+  EMSCRIPTEN_RESULT emscripten_webgl_make_context_current(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context)
+  {
+    return eglMakeCurrent(display, contexts[context].surface, contexts[context].surface, contexts[context].context) ? 0 : -1;
+  }
+
+  EMSCRIPTEN_RESULT emscripten_webgl_destroy_context(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context)
+  {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(display, contexts[context].surface);
+    eglDestroyContext(display, contexts[context].context);
+    contexts[context] = {EGL_NO_CONTEXT, EGL_NO_SURFACE};
+    return 0;
+  }
+
+  EM_BOOL emscripten_webgl_enable_extension(EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context, const char *extension)
+  {
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    return extensions && strstr(extensions, extension);
+  }
+
+  EMSCRIPTEN_RESULT emscripten_set_element_css_size(const char *target, double width, double height)
+  {
+    return 0;
+  }
+
+  EMSCRIPTEN_RESULT emscripten_set_canvas_element_size(const char *target, int width, int height)
+  {
+    canvasWidth = width;
+    canvasHeight = height;
+    return 0;
+  }
+
+  double emscripten_get_device_pixel_ratio(void)
+  {
+    return 1.0;
+  }
+
+  // GLES reads buffers by mapping them
+  void glGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void *data)
+  {
+    void *mapped = glMapBufferRange(target, offset, size, GL_MAP_READ_BIT);
+    memcpy(data, mapped, size);
+    glUnmapBuffer(target);
+  }
+}
@@ -0,0 +1,175 @@
+// Native parity check and benchmark of the edge statistics. Runs Context on a surfaceless EGL
+// context (Mesa's llvmpipe does without a GPU) and checks, per image,
+//  - the filter output against sobel_levels_cpu,
+//  - the GPU reduction against edge_stats_cpu on the full-frame readback, which has to be exact,
+// then times both ways of getting the statistics.
+//
+//   g++ -O2 -std=c++1z -Icpp/bench cpp/bench/statistics.cpp -lEGL -lGLESv2 -lpng -ljpeg -lz -o statistics_bench
+//   ./statistics_bench image.png
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <GLES3/gl3.h>
+#include <emscripten.h>
+#include "platform.cpp"
+#include "../Context.cpp"
+#include "../EdgeStatistics.cpp"
+#include "../EdgePyramid.cpp"
+#include "../EdgeBatch.cpp"
+#include "../EdgeKernels.cpp"
+#include "../../../common/cpp/memory_accounting.cpp"
+#include "../ImageDecoder.cpp"
+
+// ------ Test images
+
+static double now()
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct image
+{
+  std::string name;
+  int width;
+  int height;
+  std::vector<uint8_t> rgba;
+};
+
+static bool load_image(const char *path, image &result)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  result.name = path;
+  ImageDecoder decoder(
+      [&](int width, int height) {
+        result.width = width;
+        result.height = height;
+        result.rgba.resize((size_t)width * height * 4);
+      },
+      [&](int y, int count, const uint8_t *rgba) {
+        memcpy(&result.rgba[(size_t)y * result.width * 4], rgba, (size_t)count * result.width * 4);
+      });
+  uint8_t chunk[64 * 1024];
+  size_t size;
+  int status = IMAGE_NEED_DATA;
+  while (status == IMAGE_NEED_DATA && (size = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    status = decoder.push(chunk, size);
+  fclose(file);
+  return status == IMAGE_DONE;
+}
+
+// Shapes over noise, sized to hit uneven regions
+static image synthetic_image(int width, int height, int seed)
+{
+  image result = {"synthetic " + std::to_string(width) + "x" + std::to_string(height), width, height};
+  result.rgba.resize((size_t)width * height * 4);
+  srand(seed);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      uint8_t *pixel = &result.rgba[((size_t)y * width + x) * 4];
+      bool inside = (x - width / 3) * (x - width / 3) + (y - height / 2) * (y - height / 2) < width * height / 16;
+      bool stripe = (x / 7 + y / 11) % 5 == 0;
+      for (int c = 0; c < 3; c++)
+        pixel[c] = (inside ? 200 : 30) + (stripe ? 40 : 0) + rand() % 12;
+      pixel[3] = 255;
+    }
+  }
+  return result;
+}
+
+// Blocks until the pending statistics are in, the browser would poll once per frame instead
+static int wait_statistics(Context &context)
+{
+  int status;
+  while ((status = context.pollStatistics()) == STATS_PENDING)
+    glFinish();
+  return status;
+}
+
+static bool check_image(image &img)
+{
+  Context context(img.width, img.height, (char *)"#canvas");
+  context.run(img.rgba.data());
+
+  bool passed = true;
+  edgeStats gpu, full, reference;
+  const int thresholds[][2] = {{STATS_EDGE_THRESHOLD, STATS_STRONG_THRESHOLD}, {1, 20}, {250, 255}};
+  for (auto &threshold : thresholds)
+  {
+    context.setStatisticsThresholds(threshold[0], threshold[1]);
+    int status = context.requestStatistics(&gpu, STATS_GPU);
+    if (status == STATS_PENDING)
+      status = wait_statistics(context);
+    context.requestStatistics(&full, STATS_FULL_READBACK);
+    if (status != STATS_READY || !edge_stats_compare(full, gpu))
+    {
+      printf("[BENCH] %s: GPU statistics differ from the full readback (thresholds %d/%d)\n", img.name.c_str(), threshold[0], threshold[1]);
+      passed = false;
+    }
+  }
+
+  // The filter itself, GPU float math may round differently by one level
+  std::vector<uint8_t> gpuLevels, cpuLevels((size_t)img.width * img.height);
+  context.readLevels(gpuLevels);
+  sobel_levels_cpu(img.rgba.data(), img.width, img.height, cpuLevels.data());
+  int off = 0, maxDifference = 0;
+  for (size_t i = 0; i < cpuLevels.size(); i++)
+  {
+    int difference = abs(gpuLevels[i] - cpuLevels[i]);
+    off += difference > 0;
+    maxDifference = difference > maxDifference ? difference : maxDifference;
+  }
+  if (maxDifference > 1)
+    passed = false;
+
+  context.setStatisticsThresholds(STATS_EDGE_THRESHOLD, STATS_STRONG_THRESHOLD);
+  edge_stats_cpu(cpuLevels.data(), img.width, img.height, STATS_EDGE_THRESHOLD, STATS_STRONG_THRESHOLD, reference);
+
+  const int runs = 10;
+  double start = now();
+  for (int run = 0; run < runs; run++)
+  {
+    context.requestStatistics(&gpu, STATS_GPU);
+    wait_statistics(context);
+  }
+  double gpuTime = (now() - start) / runs;
+  start = now();
+  for (int run = 0; run < runs; run++)
+    context.requestStatistics(&full, STATS_FULL_READBACK);
+  double fullTime = (now() - start) / runs;
+
+  printf("[BENCH] %s: %s, %d/%zu levels off by at most %d, %u/%u edge pixels GPU/CPU filter\n", img.name.c_str(), passed ? "ok" : "FAILED",
+         off, cpuLevels.size(), maxDifference, gpu.edgePixels, reference.edgePixels);
+  printf("[BENCH]   GPU reduction %7.3f ms, full readback %7.3f ms, strong edges in [%d,%d)-[%d,%d)\n", gpuTime, fullTime,
+         gpu.strongX1, gpu.strongY1, gpu.strongX2, gpu.strongY2);
+  return passed;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<image> images;
+  for (int i = 1; i < argc; i++)
+  {
+    image img;
+    if (load_image(argv[i], img))
+      images.push_back(img);
+    else
+      fprintf(stderr, "can't decode %s\n", argv[i]);
+  }
+  images.push_back(synthetic_image(1920, 1080, 1));
+  images.push_back(synthetic_image(333, 201, 2));
+  images.push_back(synthetic_image(17, 900, 3));
+  images.push_back(synthetic_image(5, 3, 4));
+
+  int failed = 0;
+  for (image &img : images)
+    failed += !check_image(img);
+  printf("[BENCH] %d of %zu images failed\n", failed, images.size());
+  return failed ? 1 : 0;
+}
@@ -3,15 +3,28 @@
 #include <memory.h>
 #include <emscripten.h>
 #include <emscripten/html5.h>
+#include <string>
 #include "Context.cpp"
+#include "EdgeStatistics.cpp"
+#include "EdgePyramid.cpp"
+#include "EdgeBatch.cpp"
+#include "EdgeKernels.cpp"
+#include "ImageDecoder.cpp"
+#include "../../common/cpp/memory_accounting.cpp"
+#include "../../common/cpp/tracking_allocator.cpp"
 
 Context *glContext;
+ImageDecoder *imageDecoder;
+std::string imageCanvasId;
 
 int main()
 {
   // emscripten_request_animation_frame_loop(&draw_frame, 0);
   printf("[WASM] Loaded\n");
 
+  // Decoding and uploading images, the filter tags its own allocations
+  memory_set_default_subsystem(MEMORY_TEXTURES);
+
   EM_ASM(
       if (typeof window != "undefined") {
         window.dispatchEvent(new CustomEvent("wasmLoaded"))
@@ -27,13 +40,14 @@ extern "C"
   EMSCRIPTEN_KEEPALIVE
   void clearContext(void)
   {
-    if (glContext)
-      delete glContext;
+    delete glContext;
+    glContext = nullptr;
   }
 
   EMSCRIPTEN_KEEPALIVE
   void createContext(int width, int height, char *id)
   {
+    delete glContext;
     glContext = new Context(width, height, id);
     free(id);
   }
@@ -43,7 +57,147 @@ extern "C"
   {
     printf("[WASM] Loading Texture \n");
 
-    glContext->run(buf);
+    if (glContext)
+      glContext->run(buf);
+    free(buf);
+    memory_enforce_budgets();
+  }
+
+  // Streams a compressed PNG or JPEG into a new context on canvas id. Rows are uploaded as they
+  // are decoded, the filter runs once the last one is in.
+  EMSCRIPTEN_KEEPALIVE
+  void beginImage(char *id)
+  {
+    imageCanvasId = id;
+    free(id);
+
+    delete imageDecoder;
+    imageDecoder = new ImageDecoder(
+        [](int width, int height) {
+          printf("[WASM] Decoding %dx%d image\n", width, height);
+          delete glContext;
+          glContext = new Context(width, height, (char *)imageCanvasId.c_str());
+          glContext->beginTexture();
+        },
+        [](int y, int count, const uint8_t *rgba) {
+          glContext->uploadRows(y, count, rgba);
+        });
+  }
+
+  // Decodes the next chunk of compressed bytes, returns an imageStatus
+  EMSCRIPTEN_KEEPALIVE
+  int pushImage(uint8_t *buf, int bufSize)
+  {
+    int status = imageDecoder ? imageDecoder->push(buf, bufSize) : IMAGE_ERROR;
     free(buf);
+    if (status != IMAGE_NEED_DATA)
+    {
+      if (status == IMAGE_DONE)
+        glContext->draw();
+      delete imageDecoder;
+      imageDecoder = nullptr;
+      memory_enforce_budgets();
+    }
+    return status;
+  }
+
+  // Bytes to allocate for the statistics, see edgeStats for the layout
+  EMSCRIPTEN_KEEPALIVE
+  int statisticsSize(void)
+  {
+    return sizeof(edgeStats);
+  }
+
+  // Starts computing edge statistics of the current image into out, a statisticsSize() heap buffer
+  // owned by the caller. mode is a statsMode. Returns a statsStatus, poll while it is STATS_PENDING.
+  EMSCRIPTEN_KEEPALIVE
+  int requestStatistics(edgeStats *out, int mode)
+  {
+    return glContext ? glContext->requestStatistics(out, mode) : STATS_ERROR;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  int pollStatistics(void)
+  {
+    return glContext ? glContext->pollStatistics() : STATS_ERROR;
+  }
+
+  // Thresholds in output levels, 0-255
+  EMSCRIPTEN_KEEPALIVE
+  void setStatisticsThresholds(int edge, int strong)
+  {
+    if (glContext)
+      glContext->setStatisticsThresholds(edge, strong);
+  }
+
+  // Multi-scale edges, mask has bit n set for each pyramid level n to combine, 0 is the plain filter
+  EMSCRIPTEN_KEEPALIVE
+  void setEdgeScales(int mask)
+  {
+    if (!glContext)
+      return;
+    glContext->setEdgeScales(mask);
+    glContext->draw();
+    memory_enforce_budgets();
+  }
+
+  // Compiled in filter kernels, by index into edgeKernelVariants
+  EMSCRIPTEN_KEEPALIVE
+  int edgeKernelCount(void)
+  {
+    return edgeKernelVariantCount;
+  }
+
+  EMSCRIPTEN_KEEPALIVE
+  const char *edgeKernelName(int variant)
+  {
+    return variant >= 0 && variant < edgeKernelVariantCount ? edgeKernelVariants[variant].name : "";
+  }
+
+  // Switches the plain filter to another kernel and redraws
+  EMSCRIPTEN_KEEPALIVE
+  void setEdgeKernel(int variant)
+  {
+    if (!glContext)
+      return;
+    glContext->setEdgeKernel(variant);
+    glContext->draw();
+    memory_enforce_budgets();
+  }
+
+  // Filters count RGBA images in one go instead of a context each. pixels holds them back to back,
+  // sizes their width and height pairs, output receives the results in the same layout and regions,
+  // count atlasRegions or null, where each was packed. Any context will do, even a 1x1 one. Returns
+  // the number of atlas layers used or -1, the buffers stay the caller's.
+  EMSCRIPTEN_KEEPALIVE
+  int processBatch(uint8_t *pixels, int32_t *sizes, int count, uint8_t *output, atlasRegion *regions)
+  {
+    int layers = glContext ? glContext->processBatch(pixels, sizes, count, output, regions) : -1;
+    memory_enforce_budgets();
+    return layers;
+  }
+
+  // Bytes to allocate for the memory statistics, see memoryStats for the layout
+  EMSCRIPTEN_KEEPALIVE
+  int memoryStatisticsSize(void)
+  {
+    return sizeof(memoryStats);
+  }
+
+  // Current, peak and churn of heap and GPU memory per memorySubsystem into out, a
+  // memoryStatisticsSize() heap buffer owned by the caller
+  EMSCRIPTEN_KEEPALIVE
+  void memoryStatistics(memoryStats *out)
+  {
+    memory_stats(*out);
+  }
+
+  // Soft budget in bytes for a memorySubsystem, 0 for none. Going over frees the filter's caches once
+  // the current operation is done.
+  EMSCRIPTEN_KEEPALIVE
+  void setMemoryBudget(int subsystem, double bytes)
+  {
+    memory_set_budget(subsystem, (int64_t)bytes);
+    memory_enforce_budgets();
   }
-}
\ No newline at end of file
+}